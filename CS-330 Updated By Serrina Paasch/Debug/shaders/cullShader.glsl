@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// cullShader.glsl
+// ===============
+// Test every scene object against the view frustum and write the draw
+// commands and instance records of the visible ones
+//
+// One invocation handles one object.  A visible object takes the next
+// slot of its draw group with an atomic counter; the final counter of
+// each group is the draw count read by glMultiDrawElementsIndirectCount.
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+#version 430 core
+
+layout (local_size_x = 64) in;
+
+struct CullObject
+{
+    mat4 model;
+    vec4 params;        // xy: UV scale, z: material index, w: texture layer
+    vec4 color;
+    vec4 bounds;        // xyz: local bounding sphere center, w: radius
+    uvec4 draw;         // x: index count, y: first index, z: base vertex, w: group
+};
+
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+struct InstanceData
+{
+    mat4 model;
+    vec4 params;
+    vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer ObjectBuffer
+{
+    CullObject objects[];
+};
+
+layout (std430, binding = 1) readonly buffer GroupBuffer
+{
+    uint groupFirst[];
+};
+
+layout (std430, binding = 2) buffer CountBuffer
+{
+    uint groupCount[];
+};
+
+layout (std430, binding = 3) writeonly buffer CommandBuffer
+{
+    DrawCommand commands[];
+};
+
+layout (std430, binding = 4) writeonly buffer InstanceBuffer
+{
+    InstanceData instances[];
+};
+
+uniform vec4 frustumPlanes[6];
+uniform uint objectCount;
+
+void main()
+{
+    uint objectIndex = gl_GlobalInvocationID.x;
+    if (objectIndex >= objectCount)
+        return;
+
+    CullObject object = objects[objectIndex];
+
+    // Move the bounding sphere to world space; the radius grows with the
+    // largest axis scale of the model matrix
+    vec3 center = (object.model * vec4(object.bounds.xyz, 1.0)).xyz;
+    float scale = max(length(object.model[0].xyz), max(length(object.model[1].xyz), length(object.model[2].xyz)));
+    float radius = object.bounds.w * scale;
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius)
+            return;
+    }
+
+    uint group = object.draw.w;
+    uint slot = groupFirst[group] + atomicAdd(groupCount[group], 1u);
+
+    commands[slot].count = object.draw.x;
+    commands[slot].instanceCount = 1u;
+    commands[slot].firstIndex = object.draw.y;
+    commands[slot].baseVertex = int(object.draw.z);
+    commands[slot].baseInstance = slot;
+
+    instances[slot].model = object.model;
+    instances[slot].params = object.params;
+    instances[slot].color = object.color;
+}
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+// fragmentShader.glsl
+// ===================
+// Shade scene fragments with a texture or solid color and Phong
+// lighting.  Lights and materials are read from std140 uniform blocks
+// that SceneManager uploads once, and every texture is a layer of one
+// texture array bound once; each draw only selects a material index
+// and a texture layer.
+//
+// ShaderManager compiles permutations of this file by inserting
+// PERMUTATION, USE_TEXTURE, USE_LIGHTING, USE_INSTANCING and NUM_LIGHTS
+// defines after the #version line.  Without them the shader falls back to selecting
+// features at runtime through bUseTexture / bUseLighting.
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+#version 330 core
+
+// Must match SceneManager::MAX_LIGHTS and SceneManager::MAX_MATERIALS
+#define MAX_LIGHTS 16
+#define MAX_MATERIALS 256
+
+#ifdef PERMUTATION
+#define TEXTURE_ENABLED (USE_TEXTURE != 0)
+#define LIGHTING_ENABLED (USE_LIGHTING != 0)
+#define ACTIVE_LIGHT_COUNT min(NUM_LIGHTS, MAX_LIGHTS)
+#else
+#define TEXTURE_ENABLED bUseTexture
+#define LIGHTING_ENABLED bUseLighting
+#define ACTIVE_LIGHT_COUNT min(lightCount.x, MAX_LIGHTS)
+#endif
+
+#ifndef USE_INSTANCING
+#define USE_INSTANCING 0
+#endif
+
+struct LightSource
+{
+    vec4 position;          // xyz: world position
+    vec4 ambientColor;      // rgb
+    vec4 diffuseColor;      // rgb
+    vec4 specularColor;     // rgb
+    vec4 params;            // x: focal strength, y: specular intensity
+};
+
+struct Material
+{
+    vec4 ambientColor;      // rgb: color, a: ambient strength
+    vec4 diffuseColor;      // rgb
+    vec4 specularColor;     // rgb: color, a: shininess
+};
+
+layout (std140) uniform LightBlock
+{
+    ivec4 lightCount;       // x: number of active lights
+    LightSource lightSources[MAX_LIGHTS];
+};
+
+layout (std140) uniform MaterialBlock
+{
+    Material materials[MAX_MATERIALS];
+};
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+
+out vec4 outFragmentColor;
+
+#ifndef PERMUTATION
+uniform bool bUseTexture;
+uniform bool bUseLighting;
+#endif
+#if USE_INSTANCING
+flat in int fragmentMaterialIndex;
+flat in int fragmentTextureLayer;
+in vec2 fragmentUVScale;
+in vec4 fragmentColor;
+#define OBJECT_COLOR fragmentColor
+#define UV_SCALE fragmentUVScale
+#define MATERIAL_INDEX fragmentMaterialIndex
+#define TEXTURE_LAYER fragmentTextureLayer
+#else
+uniform vec4 objectColor;
+uniform vec2 UVscale;
+uniform int materialIndex;
+uniform int textureLayer;
+#define OBJECT_COLOR objectColor
+#define UV_SCALE UVscale
+#define MATERIAL_INDEX materialIndex
+#define TEXTURE_LAYER textureLayer
+#endif
+
+// Left at texture unit 0, where SceneManager binds the array
+uniform sampler2DArray objectTextures;
+uniform vec3 viewPosition;
+
+vec3 CalcLightSource(LightSource light, Material material, vec3 normal, vec3 viewDirection)
+{
+    vec3 lightDirection = normalize(light.position.xyz - fragmentPosition);
+
+    vec3 ambient = light.ambientColor.rgb * material.ambientColor.rgb * material.ambientColor.a;
+
+    float diffuseImpact = max(dot(normal, lightDirection), 0.0);
+    vec3 diffuse = diffuseImpact * light.diffuseColor.rgb * material.diffuseColor.rgb;
+
+    vec3 reflectDirection = reflect(-lightDirection, normal);
+    float specularComponent = pow(max(dot(viewDirection, reflectDirection), 0.0), light.params.x);
+    vec3 specular = light.params.y * specularComponent * light.specularColor.rgb * material.specularColor.rgb;
+
+    return ambient + diffuse + specular;
+}
+
+void main()
+{
+    vec4 baseColor = OBJECT_COLOR;
+    if (TEXTURE_ENABLED)
+    {
+        baseColor = texture(objectTextures, vec3(fragmentTextureCoordinate * UV_SCALE, float(TEXTURE_LAYER)));
+    }
+
+    if (!LIGHTING_ENABLED)
+    {
+        outFragmentColor = baseColor;
+        return;
+    }
+
+    Material material = materials[clamp(MATERIAL_INDEX, 0, MAX_MATERIALS - 1)];
+    vec3 normal = normalize(fragmentVertexNormal);
+    vec3 viewDirection = normalize(viewPosition - fragmentPosition);
+
+    vec3 phongResult = vec3(0.0);
+    for (int i = 0; i < ACTIVE_LIGHT_COUNT; i++)
+    {
+        phongResult += CalcLightSource(lightSources[i], material, normal, viewDirection);
+    }
+
+    outFragmentColor = vec4(phongResult * baseColor.rgb, baseColor.a);
+}
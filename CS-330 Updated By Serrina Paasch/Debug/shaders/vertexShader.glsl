@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// vertexShader.glsl
+// =================
+// Transform scene vertices into clip space and pass the world-space
+// position, normal and texture coordinate on to the fragment shader
+//
+// The USE_INSTANCING permutation reads the model matrix, UV scale,
+// material index, texture layer and color from per-instance attributes
+// instead of uniforms, so one draw call renders every instance of a
+// mesh whatever its texture.
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+#version 330 core
+
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+#ifndef USE_INSTANCING
+#define USE_INSTANCING 0
+#endif
+
+#if USE_INSTANCING
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec4 inInstanceParams;     // xy: UV scale, z: material index, w: texture layer
+layout (location = 8) in vec4 inInstanceColor;
+
+flat out int fragmentMaterialIndex;
+flat out int fragmentTextureLayer;
+out vec2 fragmentUVScale;
+out vec4 fragmentColor;
+#else
+uniform mat4 model;
+#endif
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+#if USE_INSTANCING
+    mat4 modelMatrix = inInstanceModel;
+    fragmentMaterialIndex = int(inInstanceParams.z);
+    fragmentTextureLayer = int(inInstanceParams.w);
+    fragmentUVScale = inInstanceParams.xy;
+    fragmentColor = inInstanceColor;
+#else
+    mat4 modelMatrix = model;
+#endif
+
+    vec4 worldPosition = modelMatrix * vec4(inVertexPosition, 1.0);
+
+    fragmentPosition = vec3(worldPosition);
+    fragmentVertexNormal = mat3(transpose(inverse(modelMatrix))) * inVertexNormal;
+    fragmentTextureCoordinate = inTextureCoordinate;
+
+    gl_Position = projection * view * worldPosition;
+}
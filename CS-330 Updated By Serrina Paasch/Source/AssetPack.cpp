@@ -0,0 +1,407 @@
+///////////////////////////////////////////////////////////////////////////////
+// AssetPack.cpp
+// =============
+// Read assets out of one memory-mapped archive
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Header of an archive: magic, version, entry count, index offset,
+    // string table offset and size, then reserved bytes up to the size
+    const char PACK_MAGIC[8] = { 'A', 'S', 'S', 'E', 'T', 'P', 'K', '\0' };
+    const unsigned int PACK_VERSION = 1;
+    const size_t PACK_HEADER_SIZE = 64;
+
+    // Bytes of one index entry as stored in the archive
+    const size_t PACK_ENTRY_SIZE = 40;
+
+    // FNV-1a 64-bit hashing of the paths and payloads
+    const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+    unsigned long long HashBytes(unsigned long long hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    void WriteU32(unsigned char* p, unsigned int value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            p[i] = (unsigned char)(value >> (8 * i));
+        }
+    }
+
+    void WriteU64(unsigned char* p, unsigned long long value)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            p[i] = (unsigned char)(value >> (8 * i));
+        }
+    }
+
+    unsigned int ReadU32(const unsigned char* p)
+    {
+        return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+    }
+
+    unsigned long long ReadU64(const unsigned char* p)
+    {
+        return (unsigned long long)ReadU32(p) | ((unsigned long long)ReadU32(p + 4) << 32);
+    }
+
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return ((value + alignment - 1) / alignment) * alignment;
+    }
+
+    // Structure to hold one file while an archive is built
+    struct BUILD_ENTRY
+    {
+        std::string path;
+        unsigned long long pathHash;
+        unsigned long long contentHash;
+        unsigned long long offset;
+        unsigned long long size;
+        unsigned int pathOffset;
+    };
+}
+
+/***********************************************************
+ *  AssetPack()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetPack::AssetPack()
+{
+    m_pEntries = NULL;
+    m_entryCount = 0;
+    m_pStrings = NULL;
+    m_stringsSize = 0;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method maps an archive and checks its header, that
+ *  the index is sorted and that every payload and path lies
+ *  inside the file, so lookups need no further checks.  The
+ *  index is read in place from the mapping.
+ ***********************************************************/
+bool AssetPack::Open(const std::string& path)
+{
+    static_assert(sizeof(PACK_ENTRY) == PACK_ENTRY_SIZE, "PACK_ENTRY must match the archive layout");
+
+    Close();
+    if (!m_file.Open(path))
+        return false;
+
+    const unsigned char* pData = m_file.GetData();
+    size_t fileSize = m_file.GetSize();
+    bool bValid = fileSize >= PACK_HEADER_SIZE &&
+        memcmp(pData, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0 &&
+        ReadU32(pData + 8) == PACK_VERSION;
+
+    unsigned long long entryCount = bValid ? ReadU32(pData + 12) : 0;
+    unsigned long long indexOffset = bValid ? ReadU64(pData + 16) : 0;
+    unsigned long long stringsOffset = bValid ? ReadU64(pData + 24) : 0;
+    unsigned long long stringsSize = bValid ? ReadU64(pData + 32) : 0;
+
+    bValid = bValid && indexOffset % 8 == 0 &&
+        indexOffset <= fileSize && entryCount <= (fileSize - indexOffset) / PACK_ENTRY_SIZE &&
+        stringsOffset <= fileSize && stringsSize <= fileSize - stringsOffset;
+
+    if (bValid)
+    {
+        m_pEntries = (const PACK_ENTRY*)(pData + indexOffset);
+        m_entryCount = (size_t)entryCount;
+        m_pStrings = (const char*)(pData + stringsOffset);
+        m_stringsSize = (size_t)stringsSize;
+    }
+
+    for (size_t i = 0; bValid && i < m_entryCount; i++)
+    {
+        const PACK_ENTRY& entry = m_pEntries[i];
+        bValid = entry.offset <= fileSize && entry.size <= fileSize - entry.offset &&
+            entry.pathOffset <= m_stringsSize && entry.pathLength <= m_stringsSize - entry.pathOffset &&
+            (i == 0 || m_pEntries[i - 1].pathHash <= entry.pathHash);
+    }
+
+    if (!bValid)
+    {
+        std::cerr << "ERROR::ASSET_PACK::INVALID: " << path << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method unmaps the archive.  Pointers handed out by
+ *  Find() are invalid afterwards.
+ ***********************************************************/
+void AssetPack::Close()
+{
+    m_file.Close();
+    m_pEntries = NULL;
+    m_entryCount = 0;
+    m_pStrings = NULL;
+    m_stringsSize = 0;
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method looks an asset up and points at its bytes in
+ *  the mapping.
+ ***********************************************************/
+bool AssetPack::Find(const std::string& path, const unsigned char*& pData, size_t& size) const
+{
+    unsigned long long contentHash = 0;
+    return Find(path, pData, size, contentHash);
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method looks an asset up, points at its bytes in the
+ *  mapping and gets the hash of its bytes stored in the
+ *  index, so callers keying caches by content need not hash
+ *  the payload again.
+ ***********************************************************/
+bool AssetPack::Find(const std::string& path, const unsigned char*& pData, size_t& size, unsigned long long& contentHash) const
+{
+    const PACK_ENTRY* pEntry = FindEntry(path);
+    if (NULL == pEntry)
+        return false;
+
+    pData = m_file.GetData() + pEntry->offset;
+    size = (size_t)pEntry->size;
+    contentHash = pEntry->contentHash;
+    return true;
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method binary searches the index for the hash of a
+ *  path, then compares the paths of the entries with that
+ *  hash, so colliding hashes still find the right asset.
+ *
+ * Time Complexity: O(log n) for n entries.
+ ***********************************************************/
+const AssetPack::PACK_ENTRY* AssetPack::FindEntry(const std::string& path) const
+{
+    if (!IsOpen())
+        return NULL;
+
+    std::string normalized = NormalizePath(path);
+    unsigned long long pathHash = HashContent(normalized.data(), normalized.size());
+
+    const PACK_ENTRY* pEnd = m_pEntries + m_entryCount;
+    const PACK_ENTRY* pEntry = std::lower_bound(m_pEntries, pEnd, pathHash,
+        [](const PACK_ENTRY& entry, unsigned long long hash) { return entry.pathHash < hash; });
+
+    for (; pEntry != pEnd && pEntry->pathHash == pathHash; ++pEntry)
+    {
+        if (pEntry->pathLength == normalized.size() &&
+            memcmp(m_pStrings + pEntry->pathOffset, normalized.data(), normalized.size()) == 0)
+            return pEntry;
+    }
+    return NULL;
+}
+
+/***********************************************************
+ *  Verify()
+ *
+ *  This method rehashes every payload and reports those that
+ *  do not match the index.  It reads the whole archive, so
+ *  it suits packing tools rather than startup.
+ ***********************************************************/
+bool AssetPack::Verify() const
+{
+    if (!IsOpen())
+        return false;
+
+    bool bValid = true;
+    for (size_t i = 0; i < m_entryCount; i++)
+    {
+        const PACK_ENTRY& entry = m_pEntries[i];
+        if (HashContent(m_file.GetData() + entry.offset, (size_t)entry.size) != entry.contentHash)
+        {
+            std::cerr << "ERROR::ASSET_PACK::HASH_MISMATCH: "
+                << std::string(m_pStrings + entry.pathOffset, entry.pathLength) << std::endl;
+            bValid = false;
+        }
+    }
+    return bValid;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method packs files into a new archive.  Each file is
+ *  mapped and written once, hashed on the way; the index and
+ *  path strings follow the payloads and the header is filled
+ *  in last.  The archive is written to a temporary file and
+ *  renamed, so a failed build leaves an older archive alone.
+ ***********************************************************/
+bool AssetPack::Build(const std::string& outputPath, const std::vector<std::string>& paths)
+{
+    std::vector<BUILD_ENTRY> entries;
+    entries.reserve(paths.size());
+
+    std::string tempPath = outputPath + ".tmp";
+    std::ofstream packFile(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!packFile)
+    {
+        std::cerr << "ERROR::ASSET_PACK::WRITE_FAILED: " << outputPath << std::endl;
+        return false;
+    }
+
+    // Payloads, each aligned, after room for the header
+    static const unsigned char padding[PAYLOAD_ALIGNMENT] = {};
+    unsigned char header[PACK_HEADER_SIZE] = {};
+    size_t offset = PACK_HEADER_SIZE;
+    packFile.write((const char*)header, (std::streamsize)sizeof(header));
+
+    bool bSucceeded = true;
+    std::string strings;
+    for (const std::string& path : paths)
+    {
+        BUILD_ENTRY entry;
+        entry.path = NormalizePath(path);
+        entry.pathHash = HashContent(entry.path.data(), entry.path.size());
+
+        MappedFile source;
+        if (!source.Open(path))
+        {
+            std::cerr << "ERROR::ASSET_PACK::FILE_NOT_READ: " << path << std::endl;
+            bSucceeded = false;
+            break;
+        }
+
+        size_t aligned = AlignUp(offset, PAYLOAD_ALIGNMENT);
+        packFile.write((const char*)padding, (std::streamsize)(aligned - offset));
+        packFile.write((const char*)source.GetData(), (std::streamsize)source.GetSize());
+
+        entry.offset = aligned;
+        entry.size = source.GetSize();
+        entry.contentHash = HashContent(source.GetData(), source.GetSize());
+        entry.pathOffset = (unsigned int)strings.size();
+        strings += entry.path;
+        entries.push_back(entry);
+        offset = aligned + source.GetSize();
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const BUILD_ENTRY& a, const BUILD_ENTRY& b)
+    {
+        return (a.pathHash != b.pathHash) ? a.pathHash < b.pathHash : a.path < b.path;
+    });
+    for (size_t i = 1; bSucceeded && i < entries.size(); i++)
+    {
+        if (entries[i].path == entries[i - 1].path)
+        {
+            std::cerr << "ERROR::ASSET_PACK::DUPLICATE_PATH: " << entries[i].path << std::endl;
+            bSucceeded = false;
+        }
+    }
+
+    // Index, then the path strings
+    size_t indexOffset = AlignUp(offset, PAYLOAD_ALIGNMENT);
+    packFile.write((const char*)padding, (std::streamsize)(indexOffset - offset));
+    for (const BUILD_ENTRY& entry : entries)
+    {
+        unsigned char record[PACK_ENTRY_SIZE];
+        WriteU64(record, entry.pathHash);
+        WriteU64(record + 8, entry.contentHash);
+        WriteU64(record + 16, entry.offset);
+        WriteU64(record + 24, entry.size);
+        WriteU32(record + 32, entry.pathOffset);
+        WriteU32(record + 36, (unsigned int)entry.path.size());
+        packFile.write((const char*)record, (std::streamsize)sizeof(record));
+    }
+    size_t stringsOffset = indexOffset + entries.size() * PACK_ENTRY_SIZE;
+    packFile.write(strings.data(), (std::streamsize)strings.size());
+
+    memcpy(header, PACK_MAGIC, sizeof(PACK_MAGIC));
+    WriteU32(header + 8, PACK_VERSION);
+    WriteU32(header + 12, (unsigned int)entries.size());
+    WriteU64(header + 16, indexOffset);
+    WriteU64(header + 24, stringsOffset);
+    WriteU64(header + 32, strings.size());
+    packFile.seekp(0);
+    packFile.write((const char*)header, (std::streamsize)sizeof(header));
+    packFile.close();
+
+    // A failed build leaves the previous archive in place
+    if (!bSucceeded || !packFile)
+    {
+        if (bSucceeded)
+        {
+            std::cerr << "ERROR::ASSET_PACK::WRITE_FAILED: " << outputPath << std::endl;
+        }
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    // rename() does not replace an existing file on every platform
+    std::remove(outputPath.c_str());
+    if (std::rename(tempPath.c_str(), outputPath.c_str()) != 0)
+    {
+        std::cerr << "ERROR::ASSET_PACK::WRITE_FAILED: " << outputPath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::cout << "Asset pack: " << outputPath << ", " << entries.size() << " files, "
+        << stringsOffset + strings.size() << " bytes" << std::endl;
+    return true;
+}
+
+/***********************************************************
+ *  HashContent()
+ *
+ *  This method hashes a block of bytes with 64-bit FNV-1a.
+ ***********************************************************/
+unsigned long long AssetPack::HashContent(const void* pData, size_t size)
+{
+    return HashBytes(FNV_OFFSET_BASIS, pData, size);
+}
+
+/***********************************************************
+ *  NormalizePath()
+ *
+ *  This method turns backslashes into forward slashes and
+ *  drops leading "./", so "./textures\\floor.jpg" and
+ *  "textures/floor.jpg" name the same asset.
+ ***********************************************************/
+std::string AssetPack::NormalizePath(const std::string& path)
+{
+    std::string normalized = path;
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+    while (normalized.compare(0, 2, "./") == 0)
+    {
+        normalized.erase(0, 2);
+    }
+    return normalized;
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// AssetPack.h
+// ===========
+// Read assets out of one memory-mapped archive
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/***********************************************************
+ *  AssetPack
+ *
+ *  This class reads asset files (textures, shaders, ...) out
+ *  of a single archive that is mapped once, so a lookup costs
+ *  a binary search and hands out a pointer into the mapping:
+ *  no file is opened, seeked or read per asset.
+ *
+ *  Layout, little-endian:
+ *  - Header (64 bytes): magic, version, entry count and the
+ *    offsets of the index and the path strings.
+ *  - Payloads, each starting on a PAYLOAD_ALIGNMENT boundary,
+ *    so they can be handed to SIMD decoders and copies as
+ *    they are.
+ *  - Index: one entry per asset with the hash of its path,
+ *    the FNV-1a hash of its bytes, its offset and size, and
+ *    where its path is in the string table.  Entries are
+ *    sorted by path hash.
+ *  - Path strings, without terminators.
+ *
+ *  Paths are relative to the working directory, with forward
+ *  slashes, as the application names its files, for example
+ *  "textures/silver.jpg".  Open() checks the header and that
+ *  every entry lies inside the file; Verify() also rehashes
+ *  every payload.  Lookups only read, so worker threads may
+ *  call Find() at the same time.
+ ***********************************************************/
+class AssetPack
+{
+public:
+    // Payloads start at multiples of this many bytes
+    static const size_t PAYLOAD_ALIGNMENT = 64;
+
+    // Constructor: Initialize member variables
+    AssetPack();
+
+    // Map an archive; false when it is missing or malformed
+    bool Open(const std::string& path);
+
+    // Unmap the archive
+    void Close();
+
+    // Check whether an archive is open
+    bool IsOpen() const { return m_file.IsOpen(); }
+
+    // Get the number of assets in the archive
+    size_t GetEntryCount() const { return m_entryCount; }
+
+    // Find an asset; pData points into the mapping and stays valid until Close()
+    bool Find(const std::string& path, const unsigned char*& pData, size_t& size) const;
+
+    // Find an asset together with the FNV-1a hash of its bytes
+    bool Find(const std::string& path, const unsigned char*& pData, size_t& size, unsigned long long& contentHash) const;
+
+    // Rehash every payload and compare it with the index
+    bool Verify() const;
+
+    // Pack files into a new archive at outputPath; false when any cannot be read or written
+    static bool Build(const std::string& outputPath, const std::vector<std::string>& paths);
+
+    // Get the 64-bit FNV-1a hash of a block of bytes
+    static unsigned long long HashContent(const void* pData, size_t size);
+
+private:
+    // Structure to hold one index entry as stored in the archive
+    struct PACK_ENTRY
+    {
+        unsigned long long pathHash;     // FNV-1a hash of the normalized path
+        unsigned long long contentHash;  // FNV-1a hash of the payload
+        unsigned long long offset;       // Start of the payload in the archive
+        unsigned long long size;         // Bytes of the payload
+        unsigned int pathOffset;         // Start of the path in the string table
+        unsigned int pathLength;         // Bytes of the path
+    };
+
+    MappedFile m_file;                   // Mapping of the archive
+    const PACK_ENTRY* m_pEntries;        // Index, in the mapping
+    size_t m_entryCount;                 // Entries in the index
+    const char* m_pStrings;              // Path string table, in the mapping
+    size_t m_stringsSize;                // Bytes of the string table
+
+    // Get the entry of an asset (NULL when it is not in the archive)
+    const PACK_ENTRY* FindEntry(const std::string& path) const;
+
+    // Use forward slashes and drop a leading "./"
+    static std::string NormalizePath(const std::string& path);
+
+    // Archives are owned by one object
+    AssetPack(const AssetPack&);
+    AssetPack& operator=(const AssetPack&);
+};
@@ -0,0 +1,328 @@
+///////////////////////////////////////////////////////////////////////////////
+// BlockCompressor.cpp
+// ===================
+// Encode RGBA8 images into BC1 / BC3 (S3TC) blocks
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BlockCompressor.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Texels along each side of a block
+    const int BLOCK_SIZE = 4;
+
+    // Bytes of one BC1 color block and of one BC3 (alpha + color) block
+    const size_t BC1_BLOCK_BYTES = 8;
+    const size_t BC3_BLOCK_BYTES = 16;
+
+    // Power iterations that find the principal axis of a block
+    const int AXIS_ITERATIONS = 8;
+
+    // Quantize an RGB color to 5:6:5 bits
+    uint16_t PackRGB565(const unsigned char rgb[3])
+    {
+        unsigned int r = (rgb[0] * 31u + 127u) / 255u;
+        unsigned int g = (rgb[1] * 63u + 127u) / 255u;
+        unsigned int b = (rgb[2] * 31u + 127u) / 255u;
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    // Expand a 5:6:5 color back to 8 bits a channel, as the GPU decodes it
+    void UnpackRGB565(uint16_t color, int rgb[3])
+    {
+        int r = (color >> 11) & 31;
+        int g = (color >> 5) & 63;
+        int b = color & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    void WriteU16(unsigned char* pTarget, uint16_t value)
+    {
+        pTarget[0] = (unsigned char)(value & 0xFF);
+        pTarget[1] = (unsigned char)(value >> 8);
+    }
+}
+
+/***********************************************************
+ *  IsSupportedFormat()
+ *
+ *  This method checks whether an internal format is BC1 or
+ *  BC3, the formats Compress() produces.
+ ***********************************************************/
+bool BlockCompressor::IsSupportedFormat(GLenum internalFormat)
+{
+    return internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+/***********************************************************
+ *  GetCompressedSize()
+ *
+ *  This method gets the bytes of a width x height image in a
+ *  block format.  Partial blocks at the edges count whole.
+ ***********************************************************/
+size_t BlockCompressor::GetCompressedSize(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+    if (!IsSupportedFormat(internalFormat) || width <= 0 || height <= 0)
+        return 0;
+
+    size_t blocksX = (size_t)(width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t blocksY = (size_t)(height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t blockBytes = (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? BC1_BLOCK_BYTES : BC3_BLOCK_BYTES;
+    return blocksX * blocksY * blockBytes;
+}
+
+/***********************************************************
+ *  Compress()
+ *
+ *  This method compresses a width x height RGBA8 image block
+ *  by block and appends the blocks to the vector.  Blocks
+ *  that overhang the right or bottom edge repeat the edge
+ *  texels, which the GPU never samples.
+ * Time Complexity: O(w * h) - Where w x h is the image size
+ ***********************************************************/
+bool BlockCompressor::Compress(GLenum internalFormat, const unsigned char* pPixels, GLsizei width, GLsizei height,
+    std::vector<unsigned char>& blocks)
+{
+    if (NULL == pPixels || !IsSupportedFormat(internalFormat) || width <= 0 || height <= 0)
+        return false;
+
+    bool bAlpha = (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+    size_t blockBytes = bAlpha ? BC3_BLOCK_BYTES : BC1_BLOCK_BYTES;
+    size_t start = blocks.size();
+    blocks.resize(start + GetCompressedSize(internalFormat, width, height));
+    unsigned char* pBlock = &blocks[start];
+
+    for (int blockY = 0; blockY < (int)height; blockY += BLOCK_SIZE)
+    {
+        for (int blockX = 0; blockX < (int)width; blockX += BLOCK_SIZE)
+        {
+            unsigned char texels[16][4];
+            for (int y = 0; y < BLOCK_SIZE; y++)
+            {
+                int sourceY = (blockY + y < (int)height) ? blockY + y : (int)height - 1;
+                for (int x = 0; x < BLOCK_SIZE; x++)
+                {
+                    int sourceX = (blockX + x < (int)width) ? blockX + x : (int)width - 1;
+                    const unsigned char* pTexel = pPixels + ((size_t)sourceY * width + sourceX) * 4;
+                    for (int c = 0; c < 4; c++)
+                    {
+                        texels[y * BLOCK_SIZE + x][c] = pTexel[c];
+                    }
+                }
+            }
+
+            if (bAlpha)
+            {
+                EncodeAlphaBlock(texels, pBlock);
+                EncodeColorBlock(texels, pBlock + 8);
+            }
+            else
+            {
+                EncodeColorBlock(texels, pBlock);
+            }
+            pBlock += blockBytes;
+        }
+    }
+
+    return true;
+}
+
+/***********************************************************
+ *  EncodeColorBlock()
+ *
+ *  This method encodes the colors of one block.  The
+ *  endpoints are the two texels furthest apart along the
+ *  principal axis of the block colors; color0 > color1 picks
+ *  the four-color mode, and each texel takes the index of the
+ *  nearest of the four decoded colors.
+ ***********************************************************/
+void BlockCompressor::EncodeColorBlock(const unsigned char texels[16][4], unsigned char* pBlock)
+{
+    // Mean and covariance of the block colors
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            mean[c] += texels[i][c];
+        }
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[3][3] = { { 0.0f } };
+    for (int i = 0; i < 16; i++)
+    {
+        float delta[3];
+        for (int c = 0; c < 3; c++)
+        {
+            delta[c] = texels[i][c] - mean[c];
+        }
+        for (int row = 0; row < 3; row++)
+        {
+            for (int column = 0; column < 3; column++)
+            {
+                covariance[row][column] += delta[row] * delta[column];
+            }
+        }
+    }
+
+    // Principal axis by power iteration, starting from the grey axis
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < AXIS_ITERATIONS; iteration++)
+    {
+        float next[3];
+        for (int row = 0; row < 3; row++)
+        {
+            next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+        }
+
+        float length = std::fabs(next[0]);
+        length = (std::fabs(next[1]) > length) ? std::fabs(next[1]) : length;
+        length = (std::fabs(next[2]) > length) ? std::fabs(next[2]) : length;
+        if (length < 1e-6f)
+            break;
+
+        for (int c = 0; c < 3; c++)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    // Extreme texels along the axis
+    int minIndex = 0;
+    int maxIndex = 0;
+    float minProjection = 0.0f;
+    float maxProjection = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = texels[i][0] * axis[0] + texels[i][1] * axis[1] + texels[i][2] * axis[2];
+        if (i == 0 || projection < minProjection)
+        {
+            minProjection = projection;
+            minIndex = i;
+        }
+        if (i == 0 || projection > maxProjection)
+        {
+            maxProjection = projection;
+            maxIndex = i;
+        }
+    }
+
+    uint16_t color0 = PackRGB565(texels[maxIndex]);
+    uint16_t color1 = PackRGB565(texels[minIndex]);
+    if (color0 < color1)
+    {
+        uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    WriteU16(pBlock, color0);
+    WriteU16(pBlock + 2, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int bestIndex = 0;
+            int bestDistance = -1;
+            for (int p = 0; p < 4; p++)
+            {
+                int distance = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int delta = (int)texels[i][c] - palette[p][c];
+                    distance += delta * delta;
+                }
+                if (bestDistance < 0 || distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = p;
+                }
+            }
+            indices |= (uint32_t)bestIndex << (2 * i);
+        }
+    }
+
+    for (int b = 0; b < 4; b++)
+    {
+        pBlock[4 + b] = (unsigned char)((indices >> (8 * b)) & 0xFF);
+    }
+}
+
+/***********************************************************
+ *  EncodeAlphaBlock()
+ *
+ *  This method encodes the alpha of one block.  The endpoints
+ *  are the block's alpha range; alpha0 > alpha1 picks the
+ *  eight-value mode, and each texel takes the 3-bit index of
+ *  the nearest value.
+ ***********************************************************/
+void BlockCompressor::EncodeAlphaBlock(const unsigned char texels[16][4], unsigned char* pBlock)
+{
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        minAlpha = (texels[i][3] < minAlpha) ? texels[i][3] : minAlpha;
+        maxAlpha = (texels[i][3] > maxAlpha) ? texels[i][3] : maxAlpha;
+    }
+
+    pBlock[0] = (unsigned char)maxAlpha;
+    pBlock[1] = (unsigned char)minAlpha;
+
+    uint64_t indices = 0;
+    if (maxAlpha != minAlpha)
+    {
+        int palette[8];
+        palette[0] = maxAlpha;
+        palette[1] = minAlpha;
+        for (int i = 1; i < 7; i++)
+        {
+            palette[i + 1] = ((7 - i) * maxAlpha + i * minAlpha) / 7;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int bestIndex = 0;
+            int bestDistance = 256;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = std::abs((int)texels[i][3] - palette[p]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = p;
+                }
+            }
+            indices |= (uint64_t)bestIndex << (3 * i);
+        }
+    }
+
+    for (int b = 0; b < 6; b++)
+    {
+        pBlock[2 + b] = (unsigned char)((indices >> (8 * b)) & 0xFF);
+    }
+}
@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////////
+// BlockCompressor.h
+// =================
+// Encode RGBA8 images into BC1 / BC3 (S3TC) blocks
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+
+#include <vector>
+#include <cstddef>
+
+/***********************************************************
+ *  BlockCompressor
+ *
+ *  This class encodes RGBA8 pixels into the 4x4 blocks of the
+ *  S3TC formats the GPU samples directly:
+ *
+ *  - BC1 (GL_COMPRESSED_RGB_S3TC_DXT1_EXT), 8 bytes a block:
+ *    two RGB565 endpoints and a 2-bit index per texel into
+ *    the four colors between them.  Alpha is dropped.
+ *  - BC3 (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT), 16 bytes a block:
+ *    an alpha block (two 8-bit endpoints, 3-bit indices)
+ *    followed by a BC1 color block.
+ *
+ *  The color endpoints are the extreme texels along the
+ *  principal axis of the block, which is quick and close to
+ *  what offline tools produce for photographic textures.  No
+ *  GL state is touched, so worker threads may compress.
+ ***********************************************************/
+class BlockCompressor
+{
+public:
+    // Check whether an internal format is one this class encodes
+    static bool IsSupportedFormat(GLenum internalFormat);
+
+    // Get the compressed size of a width x height image
+    static size_t GetCompressedSize(GLenum internalFormat, GLsizei width, GLsizei height);
+
+    // Compress a width x height RGBA8 image and append its blocks, row of blocks by row
+    static bool Compress(GLenum internalFormat, const unsigned char* pPixels, GLsizei width, GLsizei height,
+        std::vector<unsigned char>& blocks);
+
+private:
+    // Encode the 16 RGBA texels of one block
+    static void EncodeColorBlock(const unsigned char texels[16][4], unsigned char* pBlock);
+    static void EncodeAlphaBlock(const unsigned char texels[16][4], unsigned char* pBlock);
+};
@@ -0,0 +1,468 @@
+///////////////////////////////////////////////////////////////////////////////
+// GLResources.cpp
+// ===============
+// Create and update OpenGL buffers, vertex arrays and textures
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLResources.h"
+
+#include <cstddef>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Pixel format that matches an internal format for storage without data
+    GLenum BaseFormat(GLenum internalFormat)
+    {
+        return (internalFormat == GL_RGB8) ? GL_RGB : GL_RGBA;
+    }
+
+    // Target to bind a buffer to for editing.  The element array binding
+    // belongs to the bound vertex array, so index buffers are edited
+    // through the copy target instead.
+    GLenum EditTarget(GLenum target)
+    {
+        return (target == GL_ELEMENT_ARRAY_BUFFER) ? GL_COPY_WRITE_BUFFER : target;
+    }
+}
+
+/***********************************************************
+ *  IsDirectStateAccessSupported()
+ *
+ *  This method checks for direct state access (GL 4.5 or
+ *  ARB_direct_state_access).
+ ***********************************************************/
+bool GLResources::IsDirectStateAccessSupported()
+{
+    return GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+}
+
+/***********************************************************
+ *  IsImmutableBufferSupported()
+ *
+ *  This method checks for immutable buffer storage (GL 4.4 or
+ *  ARB_buffer_storage).
+ ***********************************************************/
+bool GLResources::IsImmutableBufferSupported()
+{
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+/***********************************************************
+ *  IsImmutableTextureSupported()
+ *
+ *  This method checks for immutable texture storage (GL 4.2
+ *  or ARB_texture_storage).
+ ***********************************************************/
+bool GLResources::IsImmutableTextureSupported()
+{
+    return GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+}
+
+/***********************************************************
+ *  CreateBuffer()
+ *
+ *  This method creates a buffer of size bytes, filled from
+ *  pData when it is not NULL.  Without immutable storage the
+ *  flags pick the usage hint of a mutable buffer.
+ ***********************************************************/
+GLuint GLResources::CreateBuffer(GLStateCache& stateCache, GLenum target, GLsizeiptr size, const void* pData, GLbitfield storageFlags)
+{
+    GLuint buffer = 0;
+
+    if (IsDirectStateAccessSupported())
+    {
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, size, pData, storageFlags);
+        return buffer;
+    }
+
+    target = EditTarget(target);
+    glGenBuffers(1, &buffer);
+    stateCache.BindBuffer(target, buffer);
+    if (IsImmutableBufferSupported())
+    {
+        glBufferStorage(target, size, pData, storageFlags);
+    }
+    else
+    {
+        GLenum usage = (storageFlags & GL_DYNAMIC_STORAGE_BIT) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+        glBufferData(target, size, pData, usage);
+    }
+    return buffer;
+}
+
+/***********************************************************
+ *  UpdateBuffer()
+ *
+ *  This method writes size bytes at offset into a buffer
+ *  created with GL_DYNAMIC_STORAGE_BIT.
+ ***********************************************************/
+void GLResources::UpdateBuffer(GLStateCache& stateCache, GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* pData)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glNamedBufferSubData(buffer, offset, size, pData);
+        return;
+    }
+
+    target = EditTarget(target);
+    stateCache.BindBuffer(target, buffer);
+    glBufferSubData(target, offset, size, pData);
+}
+
+/***********************************************************
+ *  InvalidateBuffer()
+ *
+ *  This method tells the driver the old contents of a buffer
+ *  are no longer needed, so an update that follows does not
+ *  wait for draws still reading them.  Immutable buffers
+ *  cannot be orphaned with glBufferData.
+ ***********************************************************/
+void GLResources::InvalidateBuffer(GLuint buffer)
+{
+    if (GLEW_VERSION_4_3 || GLEW_ARB_invalidate_subdata)
+    {
+        glInvalidateBufferData(buffer);
+    }
+}
+
+/***********************************************************
+ *  MapBuffer()
+ *
+ *  This method maps a range of a buffer into client memory.
+ ***********************************************************/
+void* GLResources::MapBuffer(GLStateCache& stateCache, GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+    if (IsDirectStateAccessSupported())
+        return glMapNamedBufferRange(buffer, offset, length, access);
+
+    target = EditTarget(target);
+    stateCache.BindBuffer(target, buffer);
+    return glMapBufferRange(target, offset, length, access);
+}
+
+/***********************************************************
+ *  UnmapBuffer()
+ *
+ *  This method releases the mapping of a buffer.
+ ***********************************************************/
+void GLResources::UnmapBuffer(GLStateCache& stateCache, GLenum target, GLuint buffer)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glUnmapNamedBuffer(buffer);
+        return;
+    }
+
+    target = EditTarget(target);
+    stateCache.BindBuffer(target, buffer);
+    glUnmapBuffer(target);
+}
+
+/***********************************************************
+ *  DeleteBuffer()
+ *
+ *  This method frees a buffer and clears its name.
+ ***********************************************************/
+void GLResources::DeleteBuffer(GLStateCache& stateCache, GLuint& buffer)
+{
+    if (buffer == 0)
+        return;
+
+    glDeleteBuffers(1, &buffer);
+    stateCache.OnBufferDeleted(buffer);
+    buffer = 0;
+}
+
+/***********************************************************
+ *  CreateVertexArray()
+ *
+ *  This method creates an empty vertex array.
+ ***********************************************************/
+GLuint GLResources::CreateVertexArray(GLStateCache& stateCache)
+{
+    GLuint vertexArray = 0;
+
+    if (IsDirectStateAccessSupported())
+    {
+        glCreateVertexArrays(1, &vertexArray);
+        return vertexArray;
+    }
+
+    glGenVertexArrays(1, &vertexArray);
+    stateCache.BindVertexArray(vertexArray);
+    return vertexArray;
+}
+
+/***********************************************************
+ *  SetElementBuffer()
+ *
+ *  This method attaches the index buffer of a vertex array.
+ ***********************************************************/
+void GLResources::SetElementBuffer(GLStateCache& stateCache, GLuint vertexArray, GLuint buffer)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glVertexArrayElementBuffer(vertexArray, buffer);
+        return;
+    }
+
+    stateCache.BindVertexArray(vertexArray);
+    stateCache.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+}
+
+/***********************************************************
+ *  SetVertexBuffer()
+ *
+ *  This method makes a set of float attributes of a vertex
+ *  array read from buffer through one binding index, advanced
+ *  per vertex (divisor 0) or per divisor instances.  With
+ *  direct state access the binding index is shared by the
+ *  attributes, so pointing them at another buffer is one call;
+ *  older contexts respecify every attribute pointer.
+ ***********************************************************/
+void GLResources::SetVertexBuffer(GLStateCache& stateCache, GLuint vertexArray, GLuint bindingIndex, GLuint buffer,
+    GLsizei stride, GLuint divisor, const VERTEX_ATTRIBUTE* attributes, int attributeCount)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glVertexArrayVertexBuffer(vertexArray, bindingIndex, buffer, 0, stride);
+        glVertexArrayBindingDivisor(vertexArray, bindingIndex, divisor);
+        for (int i = 0; i < attributeCount; i++)
+        {
+            const VERTEX_ATTRIBUTE& attribute = attributes[i];
+            glVertexArrayAttribFormat(vertexArray, attribute.location, attribute.size, GL_FLOAT, GL_FALSE, attribute.offset);
+            glVertexArrayAttribBinding(vertexArray, attribute.location, bindingIndex);
+            glEnableVertexArrayAttrib(vertexArray, attribute.location);
+        }
+        return;
+    }
+
+    stateCache.BindVertexArray(vertexArray);
+    stateCache.BindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (int i = 0; i < attributeCount; i++)
+    {
+        const VERTEX_ATTRIBUTE& attribute = attributes[i];
+        glVertexAttribPointer(attribute.location, attribute.size, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)attribute.offset);
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribDivisor(attribute.location, divisor);
+    }
+}
+
+/***********************************************************
+ *  DeleteVertexArray()
+ *
+ *  This method frees a vertex array and clears its name.
+ ***********************************************************/
+void GLResources::DeleteVertexArray(GLStateCache& stateCache, GLuint& vertexArray)
+{
+    if (vertexArray == 0)
+        return;
+
+    glDeleteVertexArrays(1, &vertexArray);
+    stateCache.OnVertexArrayDeleted(vertexArray);
+    vertexArray = 0;
+}
+
+/***********************************************************
+ *  CreateTexture2D()
+ *
+ *  This method creates a 2D texture with storage for levels
+ *  mip levels.  Without immutable storage every level is
+ *  allocated with glTexImage2D.
+ ***********************************************************/
+GLuint GLResources::CreateTexture2D(GLStateCache& stateCache, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+    GLuint texture = 0;
+
+    if (IsDirectStateAccessSupported())
+    {
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, levels, internalFormat, width, height);
+        return texture;
+    }
+
+    glGenTextures(1, &texture);
+    stateCache.BindTexture(GL_TEXTURE_2D, texture);
+    if (IsImmutableTextureSupported())
+    {
+        glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+        return texture;
+    }
+
+    for (GLsizei level = 0; level < levels; level++)
+    {
+        GLsizei levelWidth = (width >> level) > 0 ? (width >> level) : 1;
+        GLsizei levelHeight = (height >> level) > 0 ? (height >> level) : 1;
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, levelWidth, levelHeight, 0,
+            BaseFormat(internalFormat), GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    return texture;
+}
+
+/***********************************************************
+ *  CreateTexture2DArray()
+ *
+ *  This method creates a 2D texture array of layers layers
+ *  with storage for levels mip levels.  Without immutable
+ *  storage every level is allocated with glTexImage3D.
+ ***********************************************************/
+GLuint GLResources::CreateTexture2DArray(GLStateCache& stateCache, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei layers)
+{
+    GLuint texture = 0;
+
+    if (IsDirectStateAccessSupported())
+    {
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+        glTextureStorage3D(texture, levels, internalFormat, width, height, layers);
+        return texture;
+    }
+
+    glGenTextures(1, &texture);
+    stateCache.BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    if (IsImmutableTextureSupported())
+    {
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers);
+        return texture;
+    }
+
+    for (GLsizei level = 0; level < levels; level++)
+    {
+        GLsizei levelWidth = (width >> level) > 0 ? (width >> level) : 1;
+        GLsizei levelHeight = (height >> level) > 0 ? (height >> level) : 1;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, levelWidth, levelHeight, layers, 0,
+            BaseFormat(internalFormat), GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    return texture;
+}
+
+/***********************************************************
+ *  UploadTexture2D()
+ *
+ *  This method writes the pixels of one whole mip level.
+ ***********************************************************/
+void GLResources::UploadTexture2D(GLStateCache& stateCache, GLuint texture, GLint level, GLsizei width, GLsizei height,
+    GLenum format, GLenum type, const void* pPixels)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glTextureSubImage2D(texture, level, 0, 0, width, height, format, type, pPixels);
+        return;
+    }
+
+    stateCache.BindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, format, type, pPixels);
+}
+
+/***********************************************************
+ *  UploadTextureLayer()
+ *
+ *  This method writes the pixels of one whole mip level of
+ *  one layer of a 2D texture array.
+ ***********************************************************/
+void GLResources::UploadTextureLayer(GLStateCache& stateCache, GLuint texture, GLint level, GLint layer, GLsizei width, GLsizei height,
+    GLenum format, GLenum type, const void* pPixels)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glTextureSubImage3D(texture, level, 0, 0, layer, width, height, 1, format, type, pPixels);
+        return;
+    }
+
+    stateCache.BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, format, type, pPixels);
+}
+
+/***********************************************************
+ *  UploadCompressedTextureLayer()
+ *
+ *  This method writes one whole mip level of one layer of a
+ *  block-compressed 2D texture array.  imageSize is the byte
+ *  size of the compressed level.
+ ***********************************************************/
+void GLResources::UploadCompressedTextureLayer(GLStateCache& stateCache, GLuint texture, GLint level, GLint layer, GLsizei width, GLsizei height,
+    GLenum internalFormat, GLsizei imageSize, const void* pData)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glCompressedTextureSubImage3D(texture, level, 0, 0, layer, width, height, 1, internalFormat, imageSize, pData);
+        return;
+    }
+
+    stateCache.BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, internalFormat, imageSize, pData);
+}
+
+/***********************************************************
+ *  SetTextureParameter()
+ *
+ *  This method sets one integer sampling parameter.  target
+ *  is only used to bind the texture on older contexts.
+ ***********************************************************/
+void GLResources::SetTextureParameter(GLStateCache& stateCache, GLenum target, GLuint texture, GLenum name, GLint value)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glTextureParameteri(texture, name, value);
+        return;
+    }
+
+    stateCache.BindTexture(target, texture);
+    glTexParameteri(target, name, value);
+}
+
+/***********************************************************
+ *  GenerateMipmaps()
+ *
+ *  This method fills the lower mip levels from level 0 (of
+ *  every layer for a texture array).
+ ***********************************************************/
+void GLResources::GenerateMipmaps(GLStateCache& stateCache, GLenum target, GLuint texture)
+{
+    if (IsDirectStateAccessSupported())
+    {
+        glGenerateTextureMipmap(texture);
+        return;
+    }
+
+    stateCache.BindTexture(target, texture);
+    glGenerateMipmap(target);
+}
+
+/***********************************************************
+ *  DeleteTexture()
+ *
+ *  This method frees a texture and clears its name.
+ ***********************************************************/
+void GLResources::DeleteTexture(GLStateCache& stateCache, GLuint& texture)
+{
+    if (texture == 0)
+        return;
+
+    glDeleteTextures(1, &texture);
+    stateCache.OnTextureDeleted(texture);
+    texture = 0;
+}
+
+/***********************************************************
+ *  GetMipLevelCount()
+ *
+ *  This method gets the number of levels of a full mip chain
+ *  for a width x height image.
+ ***********************************************************/
+GLsizei GLResources::GetMipLevelCount(GLsizei width, GLsizei height)
+{
+    GLsizei size = (width > height) ? width : height;
+    GLsizei levels = 1;
+    while (size > 1)
+    {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+// GLResources.h
+// =============
+// Create and update OpenGL buffers, vertex arrays and textures
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GLStateCache.h"
+
+/***********************************************************
+ *  GLResources
+ *
+ *  This class creates and edits GL objects.  With direct
+ *  state access (GL 4.5 or ARB_direct_state_access) objects
+ *  are edited by name and nothing is bound; older contexts
+ *  (the 3.3 core context on macOS) fall back to binding
+ *  through the state cache.
+ *
+ *  Buffers and textures get immutable storage where the
+ *  driver supports it, so their size and format are fixed
+ *  at creation.  A buffer that has to grow is replaced by a
+ *  new one, and a buffer that is updated after creation must
+ *  be created with GL_DYNAMIC_STORAGE_BIT.
+ ***********************************************************/
+class GLResources
+{
+public:
+    // Structure to describe one float vertex attribute of a vertex buffer
+    struct VERTEX_ATTRIBUTE
+    {
+        GLuint location;                 // Attribute location in the shaders
+        GLint size;                      // Number of floats
+        GLuint offset;                   // Byte offset inside a vertex
+    };
+
+    // True when objects can be edited without binding them
+    static bool IsDirectStateAccessSupported();
+
+    // True when buffers / textures can get immutable storage
+    static bool IsImmutableBufferSupported();
+    static bool IsImmutableTextureSupported();
+
+    // Buffers
+    static GLuint CreateBuffer(GLStateCache& stateCache, GLenum target, GLsizeiptr size, const void* pData, GLbitfield storageFlags);
+    static void UpdateBuffer(GLStateCache& stateCache, GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* pData);
+    static void InvalidateBuffer(GLuint buffer);
+    static void* MapBuffer(GLStateCache& stateCache, GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    static void UnmapBuffer(GLStateCache& stateCache, GLenum target, GLuint buffer);
+    static void DeleteBuffer(GLStateCache& stateCache, GLuint& buffer);
+
+    // Vertex arrays
+    static GLuint CreateVertexArray(GLStateCache& stateCache);
+    static void SetElementBuffer(GLStateCache& stateCache, GLuint vertexArray, GLuint buffer);
+    static void SetVertexBuffer(GLStateCache& stateCache, GLuint vertexArray, GLuint bindingIndex, GLuint buffer,
+        GLsizei stride, GLuint divisor, const VERTEX_ATTRIBUTE* attributes, int attributeCount);
+    static void DeleteVertexArray(GLStateCache& stateCache, GLuint& vertexArray);
+
+    // 2D textures and 2D texture arrays
+    static GLuint CreateTexture2D(GLStateCache& stateCache, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+    static GLuint CreateTexture2DArray(GLStateCache& stateCache, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei layers);
+    static void UploadTexture2D(GLStateCache& stateCache, GLuint texture, GLint level, GLsizei width, GLsizei height,
+        GLenum format, GLenum type, const void* pPixels);
+    static void UploadTextureLayer(GLStateCache& stateCache, GLuint texture, GLint level, GLint layer, GLsizei width, GLsizei height,
+        GLenum format, GLenum type, const void* pPixels);
+    static void UploadCompressedTextureLayer(GLStateCache& stateCache, GLuint texture, GLint level, GLint layer, GLsizei width, GLsizei height,
+        GLenum internalFormat, GLsizei imageSize, const void* pData);
+    static void SetTextureParameter(GLStateCache& stateCache, GLenum target, GLuint texture, GLenum name, GLint value);
+    static void GenerateMipmaps(GLStateCache& stateCache, GLenum target, GLuint texture);
+    static void DeleteTexture(GLStateCache& stateCache, GLuint& texture);
+
+    // Get the number of mip levels of a full chain down to 1x1
+    static GLsizei GetMipLevelCount(GLsizei width, GLsizei height);
+};
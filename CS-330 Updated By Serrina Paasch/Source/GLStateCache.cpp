@@ -0,0 +1,359 @@
+///////////////////////////////////////////////////////////////////////////////
+// GLStateCache.cpp
+// ================
+// Track bound OpenGL objects and fixed-function state to drop redundant calls
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+// Declaration of global variables and defines
+namespace
+{
+    // Combine a target or unit with an index into one map key
+    unsigned long long MakeKey(GLuint high, GLuint low)
+    {
+        return ((unsigned long long)high << 32) | low;
+    }
+}
+
+/***********************************************************
+ *  GLStateCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GLStateCache::GLStateCache()
+{
+    Invalidate();
+}
+
+/***********************************************************
+ *  Count()
+ *
+ *  This method counts one call as issued or filtered and
+ *  returns whether it has to reach GL.
+ ***********************************************************/
+bool GLStateCache::Count(bool bIssue)
+{
+    if (bIssue)
+        m_stats.issued++;
+    else
+        m_stats.filtered++;
+    return bIssue;
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method makes a program current unless it already is.
+ ***********************************************************/
+void GLStateCache::UseProgram(GLuint program)
+{
+    if (Count(m_program != program))
+    {
+        glUseProgram(program);
+        m_program = program;
+    }
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method binds a vertex array unless it already is.
+ ***********************************************************/
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+    if (Count(m_vertexArray != vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        m_vertexArray = vertexArray;
+    }
+}
+
+/***********************************************************
+ *  BindBuffer()
+ *
+ *  This method binds a buffer to a target unless it already
+ *  is.  Element array bindings are vertex array state and are
+ *  always issued.
+ ***********************************************************/
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+    if (target == GL_ELEMENT_ARRAY_BUFFER)
+    {
+        Count(true);
+        glBindBuffer(target, buffer);
+        return;
+    }
+
+    auto found = m_buffers.find(target);
+    if (Count(found == m_buffers.end() || found->second != buffer))
+    {
+        glBindBuffer(target, buffer);
+        m_buffers[target] = buffer;
+    }
+}
+
+/***********************************************************
+ *  BindBufferBase()
+ *
+ *  This method binds a buffer to an indexed binding point
+ *  unless it already is.  GL also binds it to the generic
+ *  target, which the cache records.
+ ***********************************************************/
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    unsigned long long key = MakeKey(target, index);
+    auto found = m_bufferBases.find(key);
+    if (Count(found == m_bufferBases.end() || found->second != buffer))
+    {
+        glBindBufferBase(target, index, buffer);
+        m_bufferBases[key] = buffer;
+        m_buffers[target] = buffer;
+    }
+}
+
+/***********************************************************
+ *  ActiveTexture()
+ *
+ *  This method selects a texture unit (0-based index) unless
+ *  it already is selected.
+ ***********************************************************/
+void GLStateCache::ActiveTexture(GLuint unit)
+{
+    if (Count(m_activeTexture != unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeTexture = unit;
+    }
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method binds a texture to the active unit unless it
+ *  already is.
+ ***********************************************************/
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+    if (m_activeTexture == UNKNOWN)
+    {
+        ActiveTexture(0);
+    }
+
+    unsigned long long key = MakeKey(m_activeTexture, target);
+    auto found = m_textures.find(key);
+    if (Count(found == m_textures.end() || found->second != texture))
+    {
+        glBindTexture(target, texture);
+        m_textures[key] = texture;
+    }
+}
+
+/***********************************************************
+ *  BindTextureUnit()
+ *
+ *  This method binds a texture to a unit.  The unit is only
+ *  selected when the binding actually changes.
+ ***********************************************************/
+void GLStateCache::BindTextureUnit(GLuint unit, GLenum target, GLuint texture)
+{
+    auto found = m_textures.find(MakeKey(unit, target));
+    if (found != m_textures.end() && found->second == texture)
+    {
+        Count(false);
+        return;
+    }
+
+    ActiveTexture(unit);
+    BindTexture(target, texture);
+}
+
+/***********************************************************
+ *  Enable() / Disable()
+ *
+ *  These methods switch a capability unless it already has
+ *  the requested state.
+ ***********************************************************/
+void GLStateCache::Enable(GLenum capability)
+{
+    SetCapability(capability, true);
+}
+
+void GLStateCache::Disable(GLenum capability)
+{
+    SetCapability(capability, false);
+}
+
+void GLStateCache::SetCapability(GLenum capability, bool bEnabled)
+{
+    auto found = m_capabilities.find(capability);
+    if (Count(found == m_capabilities.end() || found->second != bEnabled))
+    {
+        if (bEnabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        m_capabilities[capability] = bEnabled;
+    }
+}
+
+/***********************************************************
+ *  BlendFunc()
+ *
+ *  This method sets the blend factors unless they are set.
+ ***********************************************************/
+void GLStateCache::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+    if (Count(m_blendSource != sourceFactor || m_blendDestination != destinationFactor))
+    {
+        glBlendFunc(sourceFactor, destinationFactor);
+        m_blendSource = sourceFactor;
+        m_blendDestination = destinationFactor;
+    }
+}
+
+/***********************************************************
+ *  DepthFunc()
+ *
+ *  This method sets the depth comparison unless it is set.
+ ***********************************************************/
+void GLStateCache::DepthFunc(GLenum function)
+{
+    if (Count(m_depthFunction != function))
+    {
+        glDepthFunc(function);
+        m_depthFunction = function;
+    }
+}
+
+/***********************************************************
+ *  CullFace()
+ *
+ *  This method sets the culled faces unless they are set.
+ ***********************************************************/
+void GLStateCache::CullFace(GLenum mode)
+{
+    if (Count(m_cullMode != mode))
+    {
+        glCullFace(mode);
+        m_cullMode = mode;
+    }
+}
+
+/***********************************************************
+ *  ClearColor()
+ *
+ *  This method sets the clear color unless it is set.
+ ***********************************************************/
+void GLStateCache::ClearColor(float red, float green, float blue, float alpha)
+{
+    bool bChanged = !m_bClearColorKnown ||
+        m_clearColor[0] != red || m_clearColor[1] != green ||
+        m_clearColor[2] != blue || m_clearColor[3] != alpha;
+
+    if (Count(bChanged))
+    {
+        glClearColor(red, green, blue, alpha);
+        m_clearColor[0] = red;
+        m_clearColor[1] = green;
+        m_clearColor[2] = blue;
+        m_clearColor[3] = alpha;
+        m_bClearColorKnown = true;
+    }
+}
+
+/***********************************************************
+ *  OnProgramDeleted()
+ *
+ *  This method forgets a deleted program.
+ ***********************************************************/
+void GLStateCache::OnProgramDeleted(GLuint program)
+{
+    if (m_program == program)
+        m_program = UNKNOWN;
+}
+
+/***********************************************************
+ *  OnVertexArrayDeleted()
+ *
+ *  This method forgets a deleted vertex array; GL reverts the
+ *  binding to 0.
+ ***********************************************************/
+void GLStateCache::OnVertexArrayDeleted(GLuint vertexArray)
+{
+    if (m_vertexArray == vertexArray)
+        m_vertexArray = 0;
+}
+
+/***********************************************************
+ *  OnBufferDeleted()
+ *
+ *  This method forgets a deleted buffer on every target and
+ *  binding point; GL reverts those bindings to 0.
+ ***********************************************************/
+void GLStateCache::OnBufferDeleted(GLuint buffer)
+{
+    for (auto& binding : m_buffers)
+    {
+        if (binding.second == buffer)
+            binding.second = 0;
+    }
+    for (auto& binding : m_bufferBases)
+    {
+        if (binding.second == buffer)
+            binding.second = 0;
+    }
+}
+
+/***********************************************************
+ *  OnTextureDeleted()
+ *
+ *  This method forgets a deleted texture on every unit; GL
+ *  reverts those bindings to 0.
+ ***********************************************************/
+void GLStateCache::OnTextureDeleted(GLuint texture)
+{
+    for (auto& binding : m_textures)
+    {
+        if (binding.second == texture)
+            binding.second = 0;
+    }
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method forgets all tracked state, so the next call of
+ *  each kind reaches GL.
+ ***********************************************************/
+void GLStateCache::Invalidate()
+{
+    m_program = UNKNOWN;
+    m_vertexArray = UNKNOWN;
+    m_activeTexture = UNKNOWN;
+    m_blendSource = UNKNOWN;
+    m_blendDestination = UNKNOWN;
+    m_depthFunction = UNKNOWN;
+    m_cullMode = UNKNOWN;
+    m_bClearColorKnown = false;
+    for (int i = 0; i < 4; i++)
+    {
+        m_clearColor[i] = 0.0f;
+    }
+    m_buffers.clear();
+    m_bufferBases.clear();
+    m_textures.clear();
+    m_capabilities.clear();
+}
+
+/***********************************************************
+ *  ResetStats()
+ *
+ *  This method resets the issued / filtered counters.
+ ***********************************************************/
+void GLStateCache::ResetStats()
+{
+    m_stats = STATE_STATS();
+}
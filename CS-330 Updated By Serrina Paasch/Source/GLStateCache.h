@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// GLStateCache.h
+// ==============
+// Track bound OpenGL objects and fixed-function state to drop redundant calls
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+
+#include <unordered_map>
+
+/***********************************************************
+ *  GLStateCache
+ *
+ *  This class mirrors the OpenGL state that the renderer
+ *  changes most often: the bound program, vertex array,
+ *  buffers, texture units, capabilities (depth test, blend,
+ *  cull face), blend, depth and cull functions and the clear
+ *  color.  A call that would set the value already bound is
+ *  dropped.  State starts unknown, so the first call of each
+ *  kind always reaches GL.
+ *
+ *  Every change of tracked state must go through the cache.
+ *  Deleting a tracked object must be reported with the
+ *  matching On*Deleted() call, since GL unbinds it and may
+ *  reuse its name.
+ *
+ *  The element array binding belongs to the bound vertex
+ *  array, so it is always issued.
+ ***********************************************************/
+class GLStateCache
+{
+public:
+    // Constructor: Initialize member variables
+    GLStateCache();
+
+    // Structure to hold the counters of issued and filtered calls
+    struct STATE_STATS
+    {
+        unsigned long long issued = 0;    // Calls that reached GL
+        unsigned long long filtered = 0;  // Calls dropped as redundant
+    };
+
+    // Bind objects
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vertexArray);
+    void BindBuffer(GLenum target, GLuint buffer);
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void ActiveTexture(GLuint unit);
+    void BindTexture(GLenum target, GLuint texture);
+    void BindTextureUnit(GLuint unit, GLenum target, GLuint texture);
+
+    // Set fixed-function state
+    void Enable(GLenum capability);
+    void Disable(GLenum capability);
+    void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+    void DepthFunc(GLenum function);
+    void CullFace(GLenum mode);
+    void ClearColor(float red, float green, float blue, float alpha);
+
+    // Forget deleted objects
+    void OnProgramDeleted(GLuint program);
+    void OnVertexArrayDeleted(GLuint vertexArray);
+    void OnBufferDeleted(GLuint buffer);
+    void OnTextureDeleted(GLuint texture);
+
+    // Forget all tracked state (after state was changed outside the cache)
+    void Invalidate();
+
+    // Get and reset the issued / filtered counters
+    const STATE_STATS& GetStats() const { return m_stats; }
+    void ResetStats();
+
+private:
+    // Value that never matches a real binding
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+    GLuint m_program;                    // Bound program
+    GLuint m_vertexArray;                // Bound vertex array
+    GLuint m_activeTexture;              // Active texture unit (index, not GL_TEXTUREi)
+    GLenum m_blendSource;                // Blend source factor
+    GLenum m_blendDestination;           // Blend destination factor
+    GLenum m_depthFunction;              // Depth comparison
+    GLenum m_cullMode;                   // Culled faces
+    float m_clearColor[4];               // Clear color
+    bool m_bClearColorKnown;             // Clear color has been set through the cache
+    std::unordered_map<GLenum, GLuint> m_buffers;                 // Target -> buffer
+    std::unordered_map<unsigned long long, GLuint> m_bufferBases; // (target, index) -> buffer
+    std::unordered_map<unsigned long long, GLuint> m_textures;    // (unit, target) -> texture
+    std::unordered_map<GLenum, bool> m_capabilities;              // Capability -> enabled
+    STATE_STATS m_stats;                 // Issued / filtered counters
+
+    // Count a call that reached GL (true) or was dropped (false)
+    bool Count(bool bIssue);
+
+    // Set a capability through the cache
+    void SetCapability(GLenum capability, bool bEnabled);
+};
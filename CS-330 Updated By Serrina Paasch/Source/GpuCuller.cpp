@@ -0,0 +1,332 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuCuller.cpp
+// =============
+// Cull scene objects on the GPU and write their indirect draw commands
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuCuller.h"
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "GLResources.h"
+
+#include <cmath>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Must match local_size_x in cullShader.glsl
+    const GLuint CULL_GROUP_SIZE = 64;
+
+    // Storage buffer binding points used by cullShader.glsl
+    const GLuint OBJECT_BINDING = 0;
+    const GLuint GROUP_BINDING = 1;
+    const GLuint COUNT_BINDING = 2;
+    const GLuint COMMAND_BINDING = 3;
+    const GLuint INSTANCE_BINDING = 4;
+
+    // Extract the six frustum planes (left, right, bottom, top, near,
+    // far) of a view-projection matrix, normalized so that the plane
+    // distance of a point is in world units
+    void ExtractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6])
+    {
+        glm::vec4 rows[4];
+        for (int row = 0; row < 4; row++)
+        {
+            rows[row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+        }
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            planes[axis * 2] = rows[3] + rows[axis];
+            planes[axis * 2 + 1] = rows[3] - rows[axis];
+        }
+
+        for (int i = 0; i < 6; i++)
+        {
+            float length = std::sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+            if (length > 0.0f)
+            {
+                planes[i] = planes[i] / length;
+            }
+        }
+    }
+}
+
+/***********************************************************
+ *  GpuCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuCuller::GpuCuller()
+{
+    m_pShaderManager = NULL;
+    m_pResources = NULL;
+    m_frustumPlanesLocation = -1;
+    m_objectCountLocation = -1;
+    m_dirtyFirst = 0;
+    m_dirtyEnd = 0;
+}
+
+/***********************************************************
+ *  ~GpuCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuCuller::~GpuCuller()
+{
+    DestroyBuffers();
+    if (NULL != m_pResources)
+    {
+        m_pResources->Release(m_cullProgram);
+    }
+    m_pShaderManager = NULL;
+    m_pResources = NULL;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method checks for compute shaders and shader storage
+ *  buffers (GL 4.3).
+ ***********************************************************/
+bool GpuCuller::IsSupported()
+{
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object);
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method loads the culling compute program and looks up
+ *  its uniforms.
+ ***********************************************************/
+bool GpuCuller::Initialize(ShaderManager* pShaderManager, const char* computePath)
+{
+    if (NULL == pShaderManager || !IsSupported())
+        return false;
+
+    m_pShaderManager = pShaderManager;
+    m_pResources = &m_pShaderManager->GetResources();
+    if (!m_cullProgram.IsValid())
+    {
+        m_cullProgram = m_pResources->AddProgram(computePath, m_pShaderManager->LoadComputeProgram(computePath));
+    }
+    if (!m_cullProgram.IsValid())
+        return false;
+
+    GLuint program = m_pResources->GetProgram(m_cullProgram);
+    m_frustumPlanesLocation = glGetUniformLocation(program, "frustumPlanes");
+    m_objectCountLocation = glGetUniformLocation(program, "objectCount");
+    return true;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method removes all objects and frees the buffers.
+ ***********************************************************/
+void GpuCuller::Clear()
+{
+    m_objects.clear();
+    m_groupFirst.clear();
+    m_groupCapacity.clear();
+    m_zeroCounts.clear();
+    m_dirtyFirst = 0;
+    m_dirtyEnd = 0;
+    DestroyBuffers();
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method adds one object.  draw[3] is its draw group.
+ ***********************************************************/
+unsigned int GpuCuller::AddObject(const CULL_OBJECT& object)
+{
+    m_objects.push_back(object);
+    return (unsigned int)(m_objects.size() - 1);
+}
+
+/***********************************************************
+ *  SetObjectModel()
+ *
+ *  This method replaces the model transform of an object.
+ *  Changed objects are uploaded as one range by the next
+ *  culling pass.
+ ***********************************************************/
+void GpuCuller::SetObjectModel(unsigned int index, const glm::mat4& model)
+{
+    if (index >= m_objects.size())
+        return;
+
+    m_objects[index].model = model;
+    if (m_dirtyFirst == m_dirtyEnd)
+    {
+        m_dirtyFirst = index;
+        m_dirtyEnd = index + 1;
+    }
+    else
+    {
+        if (index < m_dirtyFirst)
+            m_dirtyFirst = index;
+        if (index + 1 > m_dirtyEnd)
+            m_dirtyEnd = index + 1;
+    }
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method gives every draw group a range of command slots
+ *  as large as its object count and uploads the objects.
+ * Time Complexity: O(n) - Where n is the number of objects
+ ***********************************************************/
+void GpuCuller::Build()
+{
+    DestroyBuffers();
+
+    size_t groupCount = 0;
+    for (const CULL_OBJECT& object : m_objects)
+    {
+        if (object.draw[3] + 1 > groupCount)
+            groupCount = object.draw[3] + 1;
+    }
+
+    m_groupCapacity.assign(groupCount, 0);
+    for (const CULL_OBJECT& object : m_objects)
+    {
+        m_groupCapacity[object.draw[3]]++;
+    }
+
+    m_groupFirst.assign(groupCount, 0);
+    GLuint first = 0;
+    for (size_t group = 0; group < groupCount; group++)
+    {
+        m_groupFirst[group] = first;
+        first += m_groupCapacity[group];
+    }
+    m_zeroCounts.assign(groupCount, 0);
+
+    m_dirtyFirst = 0;
+    m_dirtyEnd = 0;
+
+    if (m_objects.empty() || NULL == m_pResources)
+        return;
+
+    // Objects and counts are rewritten from the CPU; the rest only by the culling pass
+    m_objectBuffer = m_pResources->CreateBuffer("cull objects", GL_SHADER_STORAGE_BUFFER,
+        m_objects.size() * sizeof(CULL_OBJECT), m_objects.data(), GL_DYNAMIC_STORAGE_BIT);
+    m_groupBuffer = m_pResources->CreateBuffer("cull group offsets", GL_SHADER_STORAGE_BUFFER,
+        m_groupFirst.size() * sizeof(GLuint), m_groupFirst.data(), 0);
+    m_countBuffer = m_pResources->CreateBuffer("cull group counts", GL_SHADER_STORAGE_BUFFER,
+        m_zeroCounts.size() * sizeof(GLuint), m_zeroCounts.data(), GL_DYNAMIC_STORAGE_BIT);
+    m_commandBuffer = m_pResources->CreateBuffer("cull draw commands", GL_SHADER_STORAGE_BUFFER,
+        m_objects.size() * sizeof(ShapeMeshes::DRAW_COMMAND), NULL, 0);
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method uploads the changed objects, clears the group
+ *  counts and dispatches the culling pass.  The barrier makes
+ *  the written commands, counts and instance records visible
+ *  to the indirect draws that follow.  The scene program is
+ *  made current again afterwards.
+ * Time Complexity: O(1) on the CPU - One dispatch for any number of objects
+ ***********************************************************/
+bool GpuCuller::Cull(const glm::mat4& viewProjection, GLuint instanceBuffer)
+{
+    if (!m_cullProgram.IsValid() || !m_objectBuffer.IsValid() || instanceBuffer == 0)
+        return false;
+
+    GLStateCache& stateCache = m_pResources->GetStateCache();
+    GLuint objectBuffer = m_pResources->GetBuffer(m_objectBuffer);
+    GLuint countBuffer = m_pResources->GetBuffer(m_countBuffer);
+
+    if (m_dirtyFirst != m_dirtyEnd)
+    {
+        GLResources::UpdateBuffer(stateCache, GL_SHADER_STORAGE_BUFFER, objectBuffer, m_dirtyFirst * sizeof(CULL_OBJECT),
+            (m_dirtyEnd - m_dirtyFirst) * sizeof(CULL_OBJECT), &m_objects[m_dirtyFirst]);
+        m_dirtyFirst = 0;
+        m_dirtyEnd = 0;
+    }
+
+    GLResources::UpdateBuffer(stateCache, GL_SHADER_STORAGE_BUFFER, countBuffer, 0,
+        m_zeroCounts.size() * sizeof(GLuint), m_zeroCounts.data());
+
+    glm::vec4 planes[6];
+    ExtractFrustumPlanes(viewProjection, planes);
+
+    stateCache.UseProgram(m_pResources->GetProgram(m_cullProgram));
+    glUniform4fv(m_frustumPlanesLocation, 6, &planes[0].x);
+    glUniform1ui(m_objectCountLocation, (GLuint)m_objects.size());
+
+    stateCache.BindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectBuffer);
+    stateCache.BindBufferBase(GL_SHADER_STORAGE_BUFFER, GROUP_BINDING, m_pResources->GetBuffer(m_groupBuffer));
+    stateCache.BindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, countBuffer);
+    stateCache.BindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, GetCommandBuffer());
+    stateCache.BindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer);
+
+    GLuint workGroups = ((GLuint)m_objects.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+    glDispatchCompute(workGroups, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    m_pShaderManager->UseProgram();
+    return true;
+}
+
+/***********************************************************
+ *  GetGroupCommandOffset()
+ *
+ *  This method gets the byte offset of the first command slot
+ *  of a draw group in the command buffer.
+ ***********************************************************/
+GLintptr GpuCuller::GetGroupCommandOffset(size_t group) const
+{
+    return (GLintptr)(m_groupFirst[group] * sizeof(ShapeMeshes::DRAW_COMMAND));
+}
+
+/***********************************************************
+ *  GetGroupCountOffset()
+ *
+ *  This method gets the byte offset of the visible count of a
+ *  draw group in the count buffer.
+ ***********************************************************/
+GLintptr GpuCuller::GetGroupCountOffset(size_t group) const
+{
+    return (GLintptr)(group * sizeof(GLuint));
+}
+
+/***********************************************************
+ *  GetCommandBuffer() / GetCountBuffer()
+ *
+ *  These methods get the buffers the culling pass writes the
+ *  draw commands and the visible counts of the groups to.
+ ***********************************************************/
+GLuint GpuCuller::GetCommandBuffer() const
+{
+    return (NULL != m_pResources) ? m_pResources->GetBuffer(m_commandBuffer) : 0;
+}
+
+GLuint GpuCuller::GetCountBuffer() const
+{
+    return (NULL != m_pResources) ? m_pResources->GetBuffer(m_countBuffer) : 0;
+}
+
+/***********************************************************
+ *  DestroyBuffers()
+ *
+ *  This method releases the culling buffers.
+ ***********************************************************/
+void GpuCuller::DestroyBuffers()
+{
+    if (NULL == m_pResources)
+        return;
+
+    m_pResources->Release(m_objectBuffer);
+    m_pResources->Release(m_groupBuffer);
+    m_pResources->Release(m_countBuffer);
+    m_pResources->Release(m_commandBuffer);
+}
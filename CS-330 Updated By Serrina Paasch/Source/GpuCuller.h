@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuCuller.h
+// ===========
+// Cull scene objects on the GPU and write their indirect draw commands
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GpuResourceManager.h"
+
+#include <vector>
+#include <glm/glm.hpp>
+
+class ShaderManager;
+
+/***********************************************************
+ *  GpuCuller
+ *
+ *  This class keeps the transforms and bounds of every scene
+ *  object in a shader storage buffer.  Each frame a compute
+ *  pass (shaders/cullShader.glsl) tests the objects against
+ *  the view frustum and writes one indirect draw command and
+ *  one instance record per visible object, plus a visible
+ *  count per draw group.  The frame then draws each group with
+ *  glMultiDrawElementsIndirectCount, so the CPU work per frame
+ *  does not depend on the number of objects.
+ *
+ *  Objects are assigned to draw groups by the caller (one
+ *  group per shader variant).  Group g owns a fixed
+ *  range of command slots sized to its object count.
+ ***********************************************************/
+class GpuCuller
+{
+public:
+    // Constructor: Initialize member variables
+    GpuCuller();
+
+    // Destructor: Cleanup the culling buffers and program
+    ~GpuCuller();
+
+    // std430 layout of one object in the object buffer
+    struct CULL_OBJECT
+    {
+        glm::mat4 model;             // Model transform
+        glm::vec4 params;            // xy: UV scale, z: material index, w: texture layer
+        glm::vec4 color;             // Solid color (untextured draws)
+        glm::vec4 bounds;            // xyz: model-space bounding sphere center, w: radius
+        GLuint draw[4];              // Index count, first index, base vertex, draw group
+    };
+
+    // True when compute shaders and storage buffers are available
+    static bool IsSupported();
+
+    // Load the culling compute program
+    bool Initialize(ShaderManager* pShaderManager, const char* computePath);
+
+    // True once the culling program is loaded
+    bool IsReady() const { return m_cullProgram.IsValid(); }
+
+    // Remove all objects
+    void Clear();
+
+    // Add one object (returns its index)
+    unsigned int AddObject(const CULL_OBJECT& object);
+
+    // Replace the model transform of an object (uploaded by the next Cull())
+    void SetObjectModel(unsigned int index, const glm::mat4& model);
+
+    // Upload the objects and size the command and count buffers
+    void Build();
+
+    // Run the culling pass; instance records go to instanceBuffer
+    bool Cull(const glm::mat4& viewProjection, GLuint instanceBuffer);
+
+    // Access the draw groups written by the culling pass
+    unsigned int GetObjectCount() const { return (unsigned int)m_objects.size(); }
+    size_t GetGroupCount() const { return m_groupFirst.size(); }
+    int GetGroupCapacity(size_t group) const { return (int)m_groupCapacity[group]; }
+    GLintptr GetGroupCommandOffset(size_t group) const;
+    GLintptr GetGroupCountOffset(size_t group) const;
+    GLuint GetCommandBuffer() const;
+    GLuint GetCountBuffer() const;
+
+private:
+    ShaderManager* m_pShaderManager;     // Restores the scene program after culling
+    GpuResourceManager* m_pResources;    // Owner of the program and buffers
+    GpuResourceManager::PROGRAM_HANDLE m_cullProgram;   // Culling compute program
+    GLint m_frustumPlanesLocation;       // frustumPlanes uniform
+    GLint m_objectCountLocation;         // objectCount uniform
+    GpuResourceManager::BUFFER_HANDLE m_objectBuffer;   // Objects (binding 0)
+    GpuResourceManager::BUFFER_HANDLE m_groupBuffer;    // First command slot per group (binding 1)
+    GpuResourceManager::BUFFER_HANDLE m_countBuffer;    // Visible count per group (binding 2)
+    GpuResourceManager::BUFFER_HANDLE m_commandBuffer;  // Indirect draw commands (binding 3)
+    std::vector<CULL_OBJECT> m_objects;          // Objects in submission order
+    std::vector<GLuint> m_groupFirst;            // First command slot per group
+    std::vector<GLuint> m_groupCapacity;         // Command slots per group
+    std::vector<GLuint> m_zeroCounts;            // Cleared group counts
+    size_t m_dirtyFirst;                 // First object changed since the last upload
+    size_t m_dirtyEnd;                   // One past the last changed object
+
+    // Free the culling buffers
+    void DestroyBuffers();
+};
@@ -0,0 +1,324 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuMemoryTracker.cpp
+// ====================
+// Account GPU memory by category and keep it within a budget
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuMemoryTracker.h"
+#include "BlockCompressor.h"
+
+#include <iostream>
+#include <algorithm>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Share of the reported video memory the scene may use; the rest is
+    // left for the framebuffers, the driver and other applications
+    const size_t BUDGET_PERCENT_OF_VIDEO_MEMORY = 75;
+
+    // Bytes in a kilobyte and a megabyte
+    const size_t KILOBYTE = 1024;
+    const double MEGABYTE = 1024.0 * 1024.0;
+
+    // Names of the categories in reports
+    const char* CATEGORY_NAMES[GpuMemoryTracker::MEMORY_CATEGORY_COUNT] =
+    {
+        "textures", "meshes", "staging", "shader data"
+    };
+
+    // Get the bytes of one texel of an uncompressed internal format
+    size_t GetTexelSize(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_R8:
+            return 1;
+        case GL_RG8:
+        case GL_R16F:
+        case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RGBA16F:
+        case GL_RG32F:
+            return 8;
+        case GL_RGBA32F:
+            return 16;
+        default:
+            // RGB8 and 24-bit depth are padded to 4 bytes by drivers
+            return 4;
+        }
+    }
+}
+
+/***********************************************************
+ *  GpuMemoryTracker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuMemoryTracker::GpuMemoryTracker()
+{
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        m_categories[i] = 0;
+    }
+    m_total = 0;
+    m_peak = 0;
+    m_budget = 0;
+    m_nextEvictableId = 1;
+    m_frame = 0;
+    m_bReportedOverBudget = false;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method records memory created in a category.
+ ***********************************************************/
+void GpuMemoryTracker::Allocate(MEMORY_CATEGORY category, size_t bytes)
+{
+    m_categories[category] += bytes;
+    m_total += bytes;
+    m_peak = (m_total > m_peak) ? m_total : m_peak;
+}
+
+/***********************************************************
+ *  Free()
+ *
+ *  This method records memory released in a category.
+ ***********************************************************/
+void GpuMemoryTracker::Free(MEMORY_CATEGORY category, size_t bytes)
+{
+    bytes = (bytes < m_categories[category]) ? bytes : m_categories[category];
+    m_categories[category] -= bytes;
+    m_total -= bytes;
+}
+
+/***********************************************************
+ *  SetBudget()
+ *
+ *  This method sets the budget in bytes; 0 means unlimited.
+ *  The new budget is enforced at the next EnforceBudget().
+ ***********************************************************/
+void GpuMemoryTracker::SetBudget(size_t bytes)
+{
+    m_budget = bytes;
+    m_bReportedOverBudget = false;
+    std::cout << "GPU memory budget: ";
+    if (bytes == 0)
+        std::cout << "unlimited" << std::endl;
+    else
+        std::cout << (double)bytes / MEGABYTE << " MB" << std::endl;
+}
+
+/***********************************************************
+ *  GetCurrent()
+ *
+ *  This method gets the current bytes of one category.
+ ***********************************************************/
+size_t GpuMemoryTracker::GetCurrent(MEMORY_CATEGORY category) const
+{
+    return m_categories[category];
+}
+
+/***********************************************************
+ *  AddEvictable()
+ *
+ *  This method registers a resource that can give memory
+ *  back.  It counts as drawn in the current frame.
+ ***********************************************************/
+int GpuMemoryTracker::AddEvictable(const std::string& label, const EVICT_CALLBACK& evict)
+{
+    EVICTABLE evictable;
+    evictable.id = m_nextEvictableId++;
+    evictable.label = label;
+    evictable.evict = evict;
+    evictable.lastUsedFrame = m_frame;
+    m_evictables.push_back(evictable);
+    return evictable.id;
+}
+
+/***********************************************************
+ *  RemoveEvictable()
+ *
+ *  This method forgets an evictable resource.
+ ***********************************************************/
+void GpuMemoryTracker::RemoveEvictable(int id)
+{
+    for (size_t i = 0; i < m_evictables.size(); i++)
+    {
+        if (m_evictables[i].id == id)
+        {
+            m_evictables.erase(m_evictables.begin() + i);
+            return;
+        }
+    }
+}
+
+/***********************************************************
+ *  Touch()
+ *
+ *  This method marks an evictable resource as drawn in the
+ *  current frame.
+ ***********************************************************/
+void GpuMemoryTracker::Touch(int id)
+{
+    for (EVICTABLE& evictable : m_evictables)
+    {
+        if (evictable.id == id)
+        {
+            evictable.lastUsedFrame = m_frame;
+            return;
+        }
+    }
+}
+
+/***********************************************************
+ *  EnforceBudget()
+ *
+ *  This method evicts from the least recently drawn resource
+ *  until the total fits the budget.  A resource is asked
+ *  again until it has nothing left to give, then the next
+ *  one is asked.  When every resource is exhausted and the
+ *  total still exceeds the budget an error is printed once.
+ *  The frame counter then moves on.
+ *
+ * Time Complexity: O(n log n) for n evictable resources,
+ *  plus the evictions themselves.
+ ***********************************************************/
+void GpuMemoryTracker::EnforceBudget()
+{
+    if (m_budget > 0 && m_total > m_budget)
+    {
+        // Sort a copy, since callbacks may register or remove resources
+        std::vector<EVICTABLE> order = m_evictables;
+        std::sort(order.begin(), order.end(), [](const EVICTABLE& a, const EVICTABLE& b)
+        {
+            return a.lastUsedFrame < b.lastUsedFrame;
+        });
+
+        for (const EVICTABLE& evictable : order)
+        {
+            while (m_total > m_budget)
+            {
+                size_t freed = evictable.evict();
+                if (freed == 0)
+                    break;
+                std::cout << "GPU memory: evicted " << (double)freed / MEGABYTE << " MB from " << evictable.label
+                    << " (" << (double)m_total / MEGABYTE << " of " << (double)m_budget / MEGABYTE << " MB in use)" << std::endl;
+            }
+            if (m_total <= m_budget)
+                break;
+        }
+
+        if (m_total > m_budget && !m_bReportedOverBudget)
+        {
+            std::cerr << "ERROR::GPU_MEMORY::OVER_BUDGET: " << (double)m_total / MEGABYTE << " MB in use, budget "
+                << (double)m_budget / MEGABYTE << " MB" << std::endl;
+            m_bReportedOverBudget = true;
+        }
+    }
+
+    if (m_budget == 0 || m_total <= m_budget)
+    {
+        m_bReportedOverBudget = false;
+    }
+
+    m_frame++;
+}
+
+/***********************************************************
+ *  PrintReport()
+ *
+ *  This method prints the current, peak and budget totals and
+ *  the bytes of every category.
+ ***********************************************************/
+void GpuMemoryTracker::PrintReport() const
+{
+    std::cout << "GPU memory: " << (double)m_total / MEGABYTE << " MB in use, peak " << (double)m_peak / MEGABYTE << " MB, budget ";
+    if (m_budget == 0)
+        std::cout << "unlimited";
+    else
+        std::cout << (double)m_budget / MEGABYTE << " MB";
+    std::cout << std::endl;
+
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        std::cout << "  " << CATEGORY_NAMES[i] << ": " << (double)m_categories[i] / MEGABYTE << " MB" << std::endl;
+    }
+}
+
+/***********************************************************
+ *  GetTextureSize()
+ *
+ *  This method adds up the bytes of every mip level of every
+ *  layer of a texture.  Block-compressed levels are rounded
+ *  up to whole 4x4 blocks.
+ ***********************************************************/
+size_t GpuMemoryTracker::GetTextureSize(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei layers, GLsizei levels)
+{
+    size_t size = 0;
+    for (GLsizei level = 0; level < levels; level++)
+    {
+        if (BlockCompressor::IsSupportedFormat(internalFormat))
+            size += BlockCompressor::GetCompressedSize(internalFormat, width, height);
+        else
+            size += (size_t)width * height * GetTexelSize(internalFormat);
+
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+    return size * (size_t)((layers > 0) ? layers : 1);
+}
+
+/***********************************************************
+ *  GetBufferCategory()
+ *
+ *  This method gets the category of a buffer from the target
+ *  it was created for.
+ ***********************************************************/
+GpuMemoryTracker::MEMORY_CATEGORY GpuMemoryTracker::GetBufferCategory(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:
+    case GL_ELEMENT_ARRAY_BUFFER:
+    case GL_DRAW_INDIRECT_BUFFER:
+        return MEMORY_MESH;
+    case GL_PIXEL_UNPACK_BUFFER:
+    case GL_COPY_READ_BUFFER:
+        return MEMORY_STAGING;
+    default:
+        return MEMORY_SHADER_DATA;
+    }
+}
+
+/***********************************************************
+ *  QueryDefaultBudget()
+ *
+ *  This method asks the driver for the dedicated video memory
+ *  (NVX_gpu_memory_info) or, failing that, for the free
+ *  texture memory (ATI_meminfo), both in kilobytes, and
+ *  returns a share of it.  Other drivers, including software
+ *  renderers, report nothing and get 0 (unlimited).
+ ***********************************************************/
+size_t GpuMemoryTracker::QueryDefaultBudget()
+{
+    GLint kilobytes = 0;
+    if (GLEW_NVX_gpu_memory_info)
+    {
+        glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &kilobytes);
+    }
+    else if (GLEW_ATI_meminfo)
+    {
+        // Total free, largest free block, total auxiliary free, largest auxiliary free
+        GLint freeMemory[4] = { 0, 0, 0, 0 };
+        glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, freeMemory);
+        kilobytes = freeMemory[0];
+    }
+
+    if (kilobytes <= 0)
+        return 0;
+    return (size_t)kilobytes * KILOBYTE / 100 * BUDGET_PERCENT_OF_VIDEO_MEMORY;
+}
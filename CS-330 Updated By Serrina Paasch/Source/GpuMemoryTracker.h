@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuMemoryTracker.h
+// ==================
+// Account GPU memory by category and keep it within a budget
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+/***********************************************************
+ *  GpuMemoryTracker
+ *
+ *  This class adds up the bytes of every texture (with all
+ *  its mip levels and layers) and buffer the application
+ *  creates, by category, and keeps the current total, the
+ *  peak total and a budget.  Memory counts from creation
+ *  until release; the driver may free it a frame or two
+ *  later, once the GPU is done with the object.
+ *
+ *  Resources that can give memory back under pressure, such
+ *  as textures that can drop their finest mip levels, are
+ *  registered as evictable and marked each frame they are
+ *  drawn.  When the total exceeds the budget, EnforceBudget()
+ *  evicts from the least recently drawn resource first until
+ *  the total fits again.
+ ***********************************************************/
+class GpuMemoryTracker
+{
+public:
+    // Kinds of GPU memory
+    enum MEMORY_CATEGORY
+    {
+        MEMORY_TEXTURE = 0,              // Textures and texture arrays
+        MEMORY_MESH,                     // Vertex, index, instance and draw command buffers
+        MEMORY_STAGING,                  // Upload buffers
+        MEMORY_SHADER_DATA,              // Uniform and shader storage buffers
+        MEMORY_CATEGORY_COUNT
+    };
+
+    // Give back some memory of an evictable resource; returns the bytes freed (0 = nothing left)
+    typedef std::function<size_t()> EVICT_CALLBACK;
+
+    // Constructor: Initialize member variables
+    GpuMemoryTracker();
+
+    // Record created and released memory
+    void Allocate(MEMORY_CATEGORY category, size_t bytes);
+    void Free(MEMORY_CATEGORY category, size_t bytes);
+
+    // Set the budget in bytes (0 = unlimited)
+    void SetBudget(size_t bytes);
+
+    // Get the budget, the current and peak totals and the current bytes of one category
+    size_t GetBudget() const { return m_budget; }
+    size_t GetCurrent() const { return m_total; }
+    size_t GetPeak() const { return m_peak; }
+    size_t GetCurrent(MEMORY_CATEGORY category) const;
+
+    // Register a resource that can give memory back; returns its id
+    int AddEvictable(const std::string& label, const EVICT_CALLBACK& evict);
+
+    // Forget an evictable resource
+    void RemoveEvictable(int id);
+
+    // Mark an evictable resource as drawn this frame
+    void Touch(int id);
+
+    // Evict least recently drawn resources until the total fits the budget, then start the next frame
+    void EnforceBudget();
+
+    // Print the current, peak and budget totals and the bytes per category
+    void PrintReport() const;
+
+    // Get the bytes of a texture with immutable storage
+    static size_t GetTextureSize(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei layers, GLsizei levels);
+
+    // Get the category of a buffer from the target it was created for
+    static MEMORY_CATEGORY GetBufferCategory(GLenum target);
+
+    // Get a budget from the video memory the driver reports (0 when it reports none)
+    static size_t QueryDefaultBudget();
+
+private:
+    // Structure to hold one evictable resource
+    struct EVICTABLE
+    {
+        int id;
+        std::string label;
+        EVICT_CALLBACK evict;
+        unsigned long long lastUsedFrame;  // Frame the resource was last drawn
+    };
+
+    size_t m_categories[MEMORY_CATEGORY_COUNT];  // Current bytes per category
+    size_t m_total;                      // Current bytes of all categories
+    size_t m_peak;                       // Highest total so far
+    size_t m_budget;                     // Budget in bytes (0 = unlimited)
+    std::vector<EVICTABLE> m_evictables; // Resources that can give memory back
+    int m_nextEvictableId;               // Id of the next registered resource
+    unsigned long long m_frame;          // Current frame number
+    bool m_bReportedOverBudget;          // Over-budget error printed since the total last fit
+};
@@ -0,0 +1,320 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuResourceManager.cpp
+// ======================
+// Own GPU textures, buffers and programs behind generational handles
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuResourceManager.h"
+#include "GLResources.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  GpuResourceManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuResourceManager::GpuResourceManager(GLStateCache* pStateCache)
+{
+    m_pStateCache = pStateCache;
+    m_pendingCount = 0;
+}
+
+/***********************************************************
+ *  ~GpuResourceManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuResourceManager::~GpuResourceManager()
+{
+    Shutdown();
+}
+
+/***********************************************************
+ *  CreateTexture2D()
+ *
+ *  This method creates a 2D texture with immutable storage for
+ *  levels mip levels and registers it.
+ ***********************************************************/
+GpuResourceManager::TEXTURE_HANDLE GpuResourceManager::CreateTexture2D(const std::string& label, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+    RESOURCE_RECORD<RESOURCE_TEXTURE> record;
+    record.name = GLResources::CreateTexture2D(*m_pStateCache, levels, internalFormat, width, height);
+    record.label = label;
+    record.bytes = (record.name != 0) ? GpuMemoryTracker::GetTextureSize(internalFormat, width, height, 1, levels) : 0;
+    record.category = GpuMemoryTracker::MEMORY_TEXTURE;
+    m_memory.Allocate(record.category, record.bytes);
+    return m_textures.Allocate(record);
+}
+
+/***********************************************************
+ *  CreateTexture2DArray()
+ *
+ *  This method creates a 2D texture array with immutable
+ *  storage for levels mip levels of layers layers and
+ *  registers it.
+ ***********************************************************/
+GpuResourceManager::TEXTURE_HANDLE GpuResourceManager::CreateTexture2DArray(const std::string& label, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei layers)
+{
+    RESOURCE_RECORD<RESOURCE_TEXTURE> record;
+    record.name = GLResources::CreateTexture2DArray(*m_pStateCache, levels, internalFormat, width, height, layers);
+    record.label = label;
+    record.bytes = (record.name != 0) ? GpuMemoryTracker::GetTextureSize(internalFormat, width, height, layers, levels) : 0;
+    record.category = GpuMemoryTracker::MEMORY_TEXTURE;
+    m_memory.Allocate(record.category, record.bytes);
+    return m_textures.Allocate(record);
+}
+
+/***********************************************************
+ *  CreateBuffer()
+ *
+ *  This method creates a buffer with immutable storage and
+ *  registers it.
+ ***********************************************************/
+GpuResourceManager::BUFFER_HANDLE GpuResourceManager::CreateBuffer(const std::string& label, GLenum target, GLsizeiptr size, const void* pData, GLbitfield storageFlags)
+{
+    RESOURCE_RECORD<RESOURCE_BUFFER> record;
+    record.name = GLResources::CreateBuffer(*m_pStateCache, target, size, pData, storageFlags);
+    record.label = label;
+    record.bytes = (record.name != 0 && size > 0) ? (size_t)size : 0;
+    record.category = GpuMemoryTracker::GetBufferCategory(target);
+    m_memory.Allocate(record.category, record.bytes);
+    return m_buffers.Allocate(record);
+}
+
+/***********************************************************
+ *  AddProgram()
+ *
+ *  This method registers a linked program; the manager
+ *  deletes it from now on.
+ ***********************************************************/
+GpuResourceManager::PROGRAM_HANDLE GpuResourceManager::AddProgram(const std::string& label, GLuint program)
+{
+    if (program == 0)
+        return PROGRAM_HANDLE();
+
+    RESOURCE_RECORD<RESOURCE_PROGRAM> record;
+    record.name = program;
+    record.label = label;
+    return m_programs.Allocate(record);
+}
+
+/***********************************************************
+ *  GetTexture() / GetBuffer() / GetProgram()
+ *
+ *  These methods resolve a handle to its GL name in O(1).  A
+ *  stale or invalid handle resolves to 0.
+ ***********************************************************/
+GLuint GpuResourceManager::GetTexture(const TEXTURE_HANDLE& handle) const
+{
+    const RESOURCE_RECORD<RESOURCE_TEXTURE>* pRecord = m_textures.Get(handle);
+    return (NULL != pRecord) ? pRecord->name : 0;
+}
+
+GLuint GpuResourceManager::GetBuffer(const BUFFER_HANDLE& handle) const
+{
+    const RESOURCE_RECORD<RESOURCE_BUFFER>* pRecord = m_buffers.Get(handle);
+    return (NULL != pRecord) ? pRecord->name : 0;
+}
+
+GLuint GpuResourceManager::GetProgram(const PROGRAM_HANDLE& handle) const
+{
+    const RESOURCE_RECORD<RESOURCE_PROGRAM>* pRecord = m_programs.Get(handle);
+    return (NULL != pRecord) ? pRecord->name : 0;
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  These methods free the slot of a handle, queue its GL
+ *  object for deletion after the frame fence and reset the
+ *  handle.  The memory of textures and buffers counts as
+ *  freed right away, so evictions see their effect in the
+ *  same frame.  Releasing a stale or invalid handle does
+ *  nothing.
+ ***********************************************************/
+void GpuResourceManager::Release(TEXTURE_HANDLE& handle)
+{
+    GLuint name = GetTexture(handle);
+    const RESOURCE_RECORD<RESOURCE_TEXTURE>* pRecord = m_textures.Get(handle);
+    if (NULL != pRecord)
+    {
+        m_memory.Free(pRecord->category, pRecord->bytes);
+    }
+    if (m_textures.Free(handle))
+    {
+        QueueDelete(RESOURCE_TEXTURE, name);
+    }
+    handle = TEXTURE_HANDLE();
+}
+
+void GpuResourceManager::Release(BUFFER_HANDLE& handle)
+{
+    GLuint name = GetBuffer(handle);
+    const RESOURCE_RECORD<RESOURCE_BUFFER>* pRecord = m_buffers.Get(handle);
+    if (NULL != pRecord)
+    {
+        m_memory.Free(pRecord->category, pRecord->bytes);
+    }
+    if (m_buffers.Free(handle))
+    {
+        QueueDelete(RESOURCE_BUFFER, name);
+    }
+    handle = BUFFER_HANDLE();
+}
+
+void GpuResourceManager::Release(PROGRAM_HANDLE& handle)
+{
+    GLuint name = GetProgram(handle);
+    if (m_programs.Free(handle))
+    {
+        QueueDelete(RESOURCE_PROGRAM, name);
+    }
+    handle = PROGRAM_HANDLE();
+}
+
+/***********************************************************
+ *  QueueDelete()
+ *
+ *  This method adds a released object to the current frame.
+ ***********************************************************/
+void GpuResourceManager::QueueDelete(RESOURCE_KIND kind, GLuint name)
+{
+    if (name == 0)
+        return;
+
+    PENDING_DELETE pending;
+    pending.kind = kind;
+    pending.name = name;
+    m_released.push_back(pending);
+    m_pendingCount++;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method fences the objects released during the frame
+ *  and deletes the batches of earlier frames whose fences have
+ *  signaled.  Fences are polled without waiting; batches are
+ *  retired oldest first.
+ ***********************************************************/
+void GpuResourceManager::EndFrame()
+{
+    if (!m_released.empty())
+    {
+        RELEASE_BATCH batch;
+        batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        batch.objects.swap(m_released);
+        m_fencedBatches.push_back(batch);
+    }
+
+    while (!m_fencedBatches.empty())
+    {
+        RELEASE_BATCH& batch = m_fencedBatches.front();
+        GLenum result = glClientWaitSync(batch.fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+            break;
+        if (result == GL_WAIT_FAILED)
+        {
+            std::cerr << "ERROR::RESOURCES::FENCE_WAIT_FAILED" << std::endl;
+        }
+
+        glDeleteSync(batch.fence);
+        DeleteObjects(batch.objects);
+        m_fencedBatches.pop_front();
+    }
+}
+
+/***********************************************************
+ *  Shutdown()
+ *
+ *  This method deletes every released object and reports and
+ *  deletes every object that was never released.
+ ***********************************************************/
+void GpuResourceManager::Shutdown()
+{
+    while (!m_fencedBatches.empty())
+    {
+        glDeleteSync(m_fencedBatches.front().fence);
+        DeleteObjects(m_fencedBatches.front().objects);
+        m_fencedBatches.pop_front();
+    }
+    DeleteObjects(m_released);
+    m_released.clear();
+
+    std::vector<PENDING_DELETE> leaked;
+    m_textures.ForEachLive([this, &leaked](const TEXTURE_HANDLE&, const RESOURCE_RECORD<RESOURCE_TEXTURE>& record)
+    {
+        m_memory.Free(record.category, record.bytes);
+        std::cerr << "ERROR::RESOURCES::LEAKED_TEXTURE: " << record.label << " (GL name " << record.name << ")" << std::endl;
+        leaked.push_back({ RESOURCE_TEXTURE, record.name });
+    });
+    m_buffers.ForEachLive([this, &leaked](const BUFFER_HANDLE&, const RESOURCE_RECORD<RESOURCE_BUFFER>& record)
+    {
+        m_memory.Free(record.category, record.bytes);
+        std::cerr << "ERROR::RESOURCES::LEAKED_BUFFER: " << record.label << " (GL name " << record.name << ")" << std::endl;
+        leaked.push_back({ RESOURCE_BUFFER, record.name });
+    });
+    m_programs.ForEachLive([&leaked](const PROGRAM_HANDLE&, const RESOURCE_RECORD<RESOURCE_PROGRAM>& record)
+    {
+        std::cerr << "ERROR::RESOURCES::LEAKED_PROGRAM: " << record.label << " (GL name " << record.name << ")" << std::endl;
+        leaked.push_back({ RESOURCE_PROGRAM, record.name });
+    });
+
+    DeleteObjects(leaked);
+    m_textures.Clear();
+    m_buffers.Clear();
+    m_programs.Clear();
+    m_pendingCount = 0;
+}
+
+/***********************************************************
+ *  GetLiveCount()
+ *
+ *  This method gets the number of registered objects.
+ ***********************************************************/
+size_t GpuResourceManager::GetLiveCount() const
+{
+    return m_textures.GetLiveCount() + m_buffers.GetLiveCount() + m_programs.GetLiveCount();
+}
+
+/***********************************************************
+ *  GetPendingCount()
+ *
+ *  This method gets the number of released objects whose
+ *  deletion still waits for a frame fence.
+ ***********************************************************/
+size_t GpuResourceManager::GetPendingCount() const
+{
+    return m_pendingCount;
+}
+
+/***********************************************************
+ *  DeleteObjects()
+ *
+ *  This method deletes GL objects and tells the state cache.
+ ***********************************************************/
+void GpuResourceManager::DeleteObjects(const std::vector<PENDING_DELETE>& objects)
+{
+    for (const PENDING_DELETE& pending : objects)
+    {
+        GLuint name = pending.name;
+        switch (pending.kind)
+        {
+        case RESOURCE_TEXTURE:
+            GLResources::DeleteTexture(*m_pStateCache, name);
+            break;
+        case RESOURCE_BUFFER:
+            GLResources::DeleteBuffer(*m_pStateCache, name);
+            break;
+        case RESOURCE_PROGRAM:
+            glDeleteProgram(name);
+            m_pStateCache->OnProgramDeleted(name);
+            break;
+        }
+    }
+
+    m_pendingCount = (m_pendingCount > objects.size()) ? m_pendingCount - objects.size() : 0;
+}
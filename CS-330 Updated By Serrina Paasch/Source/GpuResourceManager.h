@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuResourceManager.h
+// ====================
+// Own GPU textures, buffers and programs behind generational handles
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GLStateCache.h"
+#include "HandlePool.h"
+#include "GpuMemoryTracker.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+
+/***********************************************************
+ *  GpuResourceManager
+ *
+ *  This class owns GL textures, buffers and programs.  Each
+ *  object is registered in a handle pool of its kind together
+ *  with a label, and callers keep the handle instead of the
+ *  GL name.
+ *
+ *  Releasing a handle makes it stale at once, but the GL
+ *  object is only deleted after a fence placed at the end of
+ *  the frame has signaled, so draws already queued can still
+ *  use it.  Objects that are still registered at shutdown are
+ *  reported as leaks and deleted.
+ *
+ *  The size of every texture and buffer is recorded in the
+ *  memory tracker from creation until release.
+ ***********************************************************/
+class GpuResourceManager
+{
+public:
+    // Kinds of GL objects the manager owns
+    enum RESOURCE_KIND
+    {
+        RESOURCE_TEXTURE = 0,
+        RESOURCE_BUFFER,
+        RESOURCE_PROGRAM
+    };
+
+    // Structure to hold one owned GL object
+    template<RESOURCE_KIND KIND>
+    struct RESOURCE_RECORD
+    {
+        GLuint name = 0;                 // GL object name
+        std::string label;               // Label used in leak reports
+        size_t bytes = 0;                // GPU memory of the object
+        GpuMemoryTracker::MEMORY_CATEGORY category = GpuMemoryTracker::MEMORY_TEXTURE;  // Category of bytes
+    };
+
+    typedef HandlePool<RESOURCE_RECORD<RESOURCE_TEXTURE> >::HANDLE TEXTURE_HANDLE;
+    typedef HandlePool<RESOURCE_RECORD<RESOURCE_BUFFER> >::HANDLE BUFFER_HANDLE;
+    typedef HandlePool<RESOURCE_RECORD<RESOURCE_PROGRAM> >::HANDLE PROGRAM_HANDLE;
+
+    // Constructor: Objects are bound and forgotten through pStateCache
+    explicit GpuResourceManager(GLStateCache* pStateCache);
+
+    // Destructor: Report leaks and delete every object
+    ~GpuResourceManager();
+
+    // Access the state cache used for binds
+    GLStateCache& GetStateCache() { return *m_pStateCache; }
+
+    // Access the memory accounting of the owned objects
+    GpuMemoryTracker& GetMemoryTracker() { return m_memory; }
+
+    // Create objects owned by the manager
+    TEXTURE_HANDLE CreateTexture2D(const std::string& label, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+    TEXTURE_HANDLE CreateTexture2DArray(const std::string& label, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei layers);
+    BUFFER_HANDLE CreateBuffer(const std::string& label, GLenum target, GLsizeiptr size, const void* pData, GLbitfield storageFlags);
+
+    // Take ownership of a linked program
+    PROGRAM_HANDLE AddProgram(const std::string& label, GLuint program);
+
+    // Resolve a handle to its GL name (0 when the handle is stale or invalid)
+    GLuint GetTexture(const TEXTURE_HANDLE& handle) const;
+    GLuint GetBuffer(const BUFFER_HANDLE& handle) const;
+    GLuint GetProgram(const PROGRAM_HANDLE& handle) const;
+
+    // Release an object and reset the handle; the GL object is deleted after the frame fence
+    void Release(TEXTURE_HANDLE& handle);
+    void Release(BUFFER_HANDLE& handle);
+    void Release(PROGRAM_HANDLE& handle);
+
+    // Fence the objects released this frame and delete those whose fence has signaled
+    void EndFrame();
+
+    // Report leaked objects and delete everything, without waiting on fences
+    void Shutdown();
+
+    // Get the number of registered objects and of released objects not deleted yet
+    size_t GetLiveCount() const;
+    size_t GetPendingCount() const;
+
+private:
+    // Structure to hold a released GL object waiting for deletion
+    struct PENDING_DELETE
+    {
+        RESOURCE_KIND kind;
+        GLuint name;
+    };
+
+    // Structure to hold the objects released in one frame and its fence
+    struct RELEASE_BATCH
+    {
+        GLsync fence;
+        std::vector<PENDING_DELETE> objects;
+    };
+
+    GLStateCache* m_pStateCache;         // Cache told about deleted objects
+    GpuMemoryTracker m_memory;           // Bytes of the textures and buffers
+    HandlePool<RESOURCE_RECORD<RESOURCE_TEXTURE> > m_textures;  // Owned textures
+    HandlePool<RESOURCE_RECORD<RESOURCE_BUFFER> > m_buffers;    // Owned buffers
+    HandlePool<RESOURCE_RECORD<RESOURCE_PROGRAM> > m_programs;  // Owned programs
+    std::vector<PENDING_DELETE> m_released;      // Released during the current frame
+    std::deque<RELEASE_BATCH> m_fencedBatches;   // Released in earlier frames, oldest first
+    size_t m_pendingCount;               // Objects in m_released and m_fencedBatches
+
+    // Queue a released GL object for deletion
+    void QueueDelete(RESOURCE_KIND kind, GLuint name);
+
+    // Delete GL objects right away
+    void DeleteObjects(const std::vector<PENDING_DELETE>& objects);
+};
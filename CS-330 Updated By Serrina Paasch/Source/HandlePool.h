@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+// HandlePool.h
+// ============
+// Slot pool addressed by generational handles
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/***********************************************************
+ *  HandlePool
+ *
+ *  This class stores values in slots that are addressed by a
+ *  handle made of the slot index and the generation of the
+ *  slot.  Freeing a slot bumps its generation, so handles to
+ *  a freed value stop resolving even after the slot has been
+ *  reused for a new value.  Lookup, allocation and freeing are
+ *  O(1).
+ *
+ *  Every value type gets its own handle type, so a handle of
+ *  one pool cannot be passed to another.
+ ***********************************************************/
+template<typename T>
+class HandlePool
+{
+public:
+    // Index of a handle that refers to nothing
+    static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+    // Structure to hold a reference to one value of the pool
+    struct HANDLE
+    {
+        uint32_t index = INVALID_INDEX;  // Slot of the value
+        uint32_t generation = 0;         // Generation of the slot at allocation
+
+        bool IsValid() const { return index != INVALID_INDEX; }
+        bool operator==(const HANDLE& other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const HANDLE& other) const { return !(*this == other); }
+    };
+
+    // Constructor: Initialize member variables
+    HandlePool() : m_liveCount(0) {}
+
+    // Store a value in a free slot and return its handle
+    HANDLE Allocate(const T& value)
+    {
+        uint32_t index;
+        if (!m_freeSlots.empty())
+        {
+            index = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)m_slots.size();
+            m_slots.push_back(SLOT());
+        }
+
+        SLOT& slot = m_slots[index];
+        slot.value = value;
+        slot.bLive = true;
+        m_liveCount++;
+
+        HANDLE handle;
+        handle.index = index;
+        handle.generation = slot.generation;
+        return handle;
+    }
+
+    // Get the value of a handle (NULL when the handle is stale or invalid)
+    T* Get(const HANDLE& handle)
+    {
+        return IsLive(handle) ? &m_slots[handle.index].value : NULL;
+    }
+
+    const T* Get(const HANDLE& handle) const
+    {
+        return IsLive(handle) ? &m_slots[handle.index].value : NULL;
+    }
+
+    // Free the slot of a handle; false when the handle is stale or invalid
+    bool Free(const HANDLE& handle)
+    {
+        if (!IsLive(handle))
+            return false;
+
+        SLOT& slot = m_slots[handle.index];
+        slot.value = T();
+        slot.bLive = false;
+        slot.generation++;
+        m_freeSlots.push_back(handle.index);
+        m_liveCount--;
+        return true;
+    }
+
+    // True when a handle refers to a value that has not been freed
+    bool IsLive(const HANDLE& handle) const
+    {
+        return handle.index < m_slots.size() &&
+            m_slots[handle.index].bLive &&
+            m_slots[handle.index].generation == handle.generation;
+    }
+
+    // Get the number of values that have not been freed
+    size_t GetLiveCount() const { return m_liveCount; }
+
+    // Call func(handle, value) for every value that has not been freed
+    template<typename FUNC>
+    void ForEachLive(FUNC func) const
+    {
+        for (size_t i = 0; i < m_slots.size(); i++)
+        {
+            if (m_slots[i].bLive)
+            {
+                HANDLE handle;
+                handle.index = (uint32_t)i;
+                handle.generation = m_slots[i].generation;
+                func(handle, m_slots[i].value);
+            }
+        }
+    }
+
+    // Free every slot (outstanding handles become stale)
+    void Clear()
+    {
+        for (size_t i = 0; i < m_slots.size(); i++)
+        {
+            if (m_slots[i].bLive)
+            {
+                HANDLE handle;
+                handle.index = (uint32_t)i;
+                handle.generation = m_slots[i].generation;
+                Free(handle);
+            }
+        }
+    }
+
+private:
+    // Structure to hold one slot of the pool
+    struct SLOT
+    {
+        T value = T();                   // Stored value
+        uint32_t generation = 0;         // Bumped every time the slot is freed
+        bool bLive = false;              // Slot holds a value
+    };
+
+    std::vector<SLOT> m_slots;           // All slots, live and free
+    std::vector<uint32_t> m_freeSlots;   // Indices of the free slots
+    size_t m_liveCount;                  // Number of live slots
+};
@@ -0,0 +1,289 @@
+///////////////////////////////////////////////////////////////////////////////
+// ImageDecoder.cpp
+// ================
+// Decode image files through interchangeable backends
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#ifdef USE_LIBJPEG_TURBO
+#include <turbojpeg.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+
+// Declaration of global variables and defines
+namespace
+{
+    typedef std::chrono::steady_clock CLOCK;
+
+    /***********************************************************
+     *  StbImageDecoder
+     *
+     *  Decodes every format stb_image reads.  stb_image
+     *  allocates its own output, so the rows are copied into
+     *  the caller's buffer, flipped on the way; its global
+     *  flip setting is left alone.
+     ***********************************************************/
+    class StbImageDecoder : public ImageDecoder
+    {
+    public:
+        const char* GetName() const { return "stb_image"; }
+
+        bool GetInfo(const unsigned char* pData, size_t size, IMAGE_INFO& info) const
+        {
+            return stbi_info_from_memory(pData, (int)size, &info.width, &info.height, &info.channels) != 0 &&
+                info.width > 0 && info.height > 0 && info.channels >= 1 && info.channels <= 4;
+        }
+
+        bool Decode(const unsigned char* pData, size_t size, const IMAGE_INFO& info, unsigned char* pPixels) const
+        {
+            int width = 0;
+            int height = 0;
+            int channels = 0;
+            unsigned char* pImage = stbi_load_from_memory(pData, (int)size, &width, &height, &channels, info.channels);
+            if (NULL == pImage)
+                return false;
+
+            bool bMatches = (width == info.width && height == info.height);
+            if (bMatches)
+            {
+                size_t rowSize = (size_t)width * info.channels;
+                for (int y = 0; y < height; y++)
+                {
+                    memcpy(pPixels + (size_t)(height - 1 - y) * rowSize, pImage + (size_t)y * rowSize, rowSize);
+                }
+            }
+
+            stbi_image_free(pImage);
+            return bMatches;
+        }
+    };
+
+#ifdef USE_LIBJPEG_TURBO
+    /***********************************************************
+     *  TurboJpegDecoder
+     *
+     *  Decodes JPEG files with libjpeg-turbo, whose IDCT and
+     *  color conversion use SSE2 / AVX2 / NEON.  The pixels
+     *  are written straight into the caller's buffer, bottom
+     *  row first.  A turbojpeg handle must not be shared
+     *  between threads, so each thread keeps its own.
+     ***********************************************************/
+    class TurboJpegDecoder : public ImageDecoder
+    {
+    public:
+        const char* GetName() const { return "libjpeg-turbo"; }
+
+        bool GetInfo(const unsigned char* pData, size_t size, IMAGE_INFO& info) const
+        {
+            tjhandle handle = GetHandle();
+            int subsampling = 0;
+            int colorspace = 0;
+            if (NULL == handle || tjDecompressHeader3(handle, pData, (unsigned long)size,
+                &info.width, &info.height, &subsampling, &colorspace) != 0)
+                return false;
+
+            // CMYK and YCCK images cannot be converted to RGB by libjpeg-turbo
+            if (colorspace == TJCS_CMYK || colorspace == TJCS_YCCK)
+                return false;
+
+            info.channels = (colorspace == TJCS_GRAY) ? 1 : 3;
+            return info.width > 0 && info.height > 0;
+        }
+
+        bool Decode(const unsigned char* pData, size_t size, const IMAGE_INFO& info, unsigned char* pPixels) const
+        {
+            tjhandle handle = GetHandle();
+            int pixelFormat = (info.channels == 1) ? TJPF_GRAY : TJPF_RGB;
+            return NULL != handle && tjDecompress2(handle, pData, (unsigned long)size, pPixels,
+                info.width, info.width * info.channels, info.height, pixelFormat, TJFLAG_BOTTOMUP) == 0;
+        }
+
+    private:
+        // Owns the decompressor of one thread
+        struct HANDLE_OWNER
+        {
+            tjhandle handle;
+            HANDLE_OWNER() { handle = tjInitDecompress(); }
+            ~HANDLE_OWNER() { if (NULL != handle) tjDestroy(handle); }
+        };
+
+        static tjhandle GetHandle()
+        {
+            thread_local HANDLE_OWNER owner;
+            return owner.handle;
+        }
+    };
+#endif
+
+    // Totals of one backend over the benchmark
+    struct BENCHMARK_TOTAL
+    {
+        int images;
+        double megapixels;
+        double seconds;
+    };
+}
+
+/***********************************************************
+ *  GetImageSize()
+ *
+ *  This method gets the bytes of the pixels of an image.
+ ***********************************************************/
+size_t ImageDecoder::GetImageSize(const IMAGE_INFO& info)
+{
+    return (size_t)info.width * (size_t)info.height * (size_t)info.channels;
+}
+
+/***********************************************************
+ *  GetDecoders()
+ *
+ *  This method gets the compiled-in backends, the fast paths
+ *  first and stb_image last.
+ ***********************************************************/
+const std::vector<const ImageDecoder*>& ImageDecoder::GetDecoders()
+{
+#ifdef USE_LIBJPEG_TURBO
+    static const TurboJpegDecoder turboJpegDecoder;
+#endif
+    static const StbImageDecoder stbImageDecoder;
+    static const std::vector<const ImageDecoder*> decoders =
+    {
+#ifdef USE_LIBJPEG_TURBO
+        &turboJpegDecoder,
+#endif
+        &stbImageDecoder
+    };
+    return decoders;
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method gets the first backend that reads the header
+ *  of an image.
+ ***********************************************************/
+const ImageDecoder* ImageDecoder::Find(const unsigned char* pData, size_t size, IMAGE_INFO& info)
+{
+    for (const ImageDecoder* pDecoder : GetDecoders())
+    {
+        if (pDecoder->GetInfo(pData, size, info))
+            return pDecoder;
+    }
+    return NULL;
+}
+
+/***********************************************************
+ *  DecodeImage()
+ *
+ *  This method decodes an image with the first able backend.
+ *  The pixel vector is only grown, so reusing it across
+ *  images avoids an allocation per image.
+ ***********************************************************/
+bool ImageDecoder::DecodeImage(const unsigned char* pData, size_t size, IMAGE_INFO& info, std::vector<unsigned char>& pixels)
+{
+    const ImageDecoder* pDecoder = Find(pData, size, info);
+    if (NULL == pDecoder)
+        return false;
+
+    if (pixels.size() < GetImageSize(info))
+    {
+        pixels.resize(GetImageSize(info));
+    }
+    return pDecoder->Decode(pData, size, info, pixels.data());
+}
+
+/***********************************************************
+ *  RunBenchmark()
+ *
+ *  This method decodes every image of a directory iterations
+ *  times with each backend that reads it and prints the time
+ *  per decode and the throughput in megapixels per second,
+ *  per image and per backend.  Files are mapped once, so the
+ *  numbers cover decoding only.  Returns false when no image
+ *  was decoded.
+ ***********************************************************/
+bool ImageDecoder::RunBenchmark(const std::string& directory, int iterations)
+{
+    iterations = (iterations > 0) ? iterations : 1;
+    const std::vector<const ImageDecoder*>& decoders = GetDecoders();
+    std::vector<BENCHMARK_TOTAL> totals(decoders.size(), BENCHMARK_TOTAL{ 0, 0.0, 0.0 });
+    std::vector<unsigned char> pixels;
+
+    std::cout << "Decode benchmark: " << directory << ", " << iterations << " decodes per image" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+
+    for (const std::string& name : MappedFile::ListDirectory(directory))
+    {
+        MappedFile file;
+        if (!file.Open(directory + "/" + name))
+            continue;
+
+        for (size_t i = 0; i < decoders.size(); i++)
+        {
+            IMAGE_INFO info;
+            if (!decoders[i]->GetInfo(file.GetData(), file.GetSize(), info))
+                continue;
+
+            if (pixels.size() < GetImageSize(info))
+            {
+                pixels.resize(GetImageSize(info));
+            }
+
+            bool bDecoded = true;
+            CLOCK::time_point start = CLOCK::now();
+            for (int iteration = 0; iteration < iterations && bDecoded; iteration++)
+            {
+                bDecoded = decoders[i]->Decode(file.GetData(), file.GetSize(), info, pixels.data());
+            }
+            double seconds = std::chrono::duration<double>(CLOCK::now() - start).count();
+
+            if (!bDecoded)
+            {
+                std::cerr << "ERROR::IMAGE::DECODE_FAILED: " << name << " (" << decoders[i]->GetName() << ")" << std::endl;
+                continue;
+            }
+
+            double megapixels = (double)info.width * info.height * iterations / 1000000.0;
+            std::cout << "  " << std::left << std::setw(16) << name << std::setw(16) << decoders[i]->GetName() << std::right
+                << std::setw(6) << info.width << "x" << std::setw(5) << std::left << info.height << std::right
+                << std::setw(9) << seconds * 1000.0 / iterations << " ms"
+                << std::setw(9) << megapixels / seconds << " MP/s" << std::endl;
+
+            totals[i].images++;
+            totals[i].megapixels += megapixels;
+            totals[i].seconds += seconds;
+        }
+    }
+
+    bool bAnyDecoded = false;
+    for (size_t i = 0; i < decoders.size(); i++)
+    {
+        if (totals[i].images == 0)
+            continue;
+
+        std::cout << "  " << std::left << std::setw(16) << decoders[i]->GetName() << std::right << totals[i].images << " images, "
+            << totals[i].megapixels / totals[i].seconds << " MP/s overall" << std::endl;
+        bAnyDecoded = true;
+    }
+
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+
+    if (!bAnyDecoded)
+    {
+        std::cerr << "ERROR::IMAGE::NO_IMAGES: " << directory << std::endl;
+    }
+    return bAnyDecoded;
+}
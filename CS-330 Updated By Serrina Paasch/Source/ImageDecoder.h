@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// ImageDecoder.h
+// ==============
+// Decode image files through interchangeable backends
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/***********************************************************
+ *  ImageDecoder
+ *
+ *  This class is the interface of an image decoding backend.
+ *  Decoding is split in two steps so callers choose where the
+ *  pixels go: GetInfo() reads the size and channels from the
+ *  header, then Decode() writes the pixels into a buffer the
+ *  caller provides, such as a reused scratch buffer or mapped
+ *  staging memory.  Rows are written bottom row first, the
+ *  order OpenGL expects, and backends keep no per-call global
+ *  state, so worker threads may decode at the same time.
+ *
+ *  Backends are tried in order by Find():
+ *  - libjpeg-turbo (SIMD), for JPEG files, when built with
+ *    USE_LIBJPEG_TURBO defined and turbojpeg linked, as the
+ *    project does (Libraries\libjpeg-turbo, next to GLFW).
+ *  - stb_image, for every format it reads (JPEG, PNG, BMP,
+ *    TGA, ...), always available as the fallback.
+ ***********************************************************/
+class ImageDecoder
+{
+public:
+    // Structure to hold the header of an image
+    struct IMAGE_INFO
+    {
+        int width;
+        int height;
+        int channels;                    // Channels Decode() writes, 1 to 4
+    };
+
+    // Destructor: Backends are deleted through the interface
+    virtual ~ImageDecoder() {}
+
+    // Get the name of the backend for reports
+    virtual const char* GetName() const = 0;
+
+    // Read the header of an encoded image; false when the backend cannot decode it
+    virtual bool GetInfo(const unsigned char* pData, size_t size, IMAGE_INFO& info) const = 0;
+
+    // Decode into pPixels, which holds at least GetImageSize(info) bytes
+    virtual bool Decode(const unsigned char* pData, size_t size, const IMAGE_INFO& info, unsigned char* pPixels) const = 0;
+
+    // Get the bytes Decode() writes for an image
+    static size_t GetImageSize(const IMAGE_INFO& info);
+
+    // Get the first backend able to decode an image, with its header (NULL when none is)
+    static const ImageDecoder* Find(const unsigned char* pData, size_t size, IMAGE_INFO& info);
+
+    // Decode an image with the first able backend into pixels, resized to fit
+    static bool DecodeImage(const unsigned char* pData, size_t size, IMAGE_INFO& info, std::vector<unsigned char>& pixels);
+
+    // Get every backend compiled in, in the order Find() tries them
+    static const std::vector<const ImageDecoder*>& GetDecoders();
+
+    // Decode every image of a directory with every able backend and print the throughput
+    static bool RunBenchmark(const std::string& directory, int iterations);
+};
@@ -7,7 +7,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <iostream>         // error handling and output
-#include <cstdlib>          // EXIT_FAILURE
+#include <cstdlib>          // EXIT_FAILURE, atoi
+#include <cstring>          // strncmp
+#include <chrono>           // startup timing
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -21,6 +23,10 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "ImageDecoder.h"
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include "SceneFile.h"
 
 // Namespace for declaring global variables
 namespace
@@ -28,6 +34,35 @@ namespace
 	// Macro for window title
 	const char* const WINDOW_TITLE = "7-1 Final Project and Milestones";
 
+	// Command line option overriding the GPU memory budget in megabytes (0 = unlimited)
+	const char* const GPU_BUDGET_OPTION = "--gpu-budget-mb=";
+
+	// Command line option that benchmarks image decoding, optionally "=directory", and exits
+	const char* const BENCH_DECODE_OPTION = "--bench-decode";
+	const char* const BENCH_DECODE_DIRECTORY = "textures";
+	const int BENCH_DECODE_ITERATIONS = 5;
+
+	// Command line option that loads every asset before the first frame
+	const char* const BLOCKING_STARTUP_OPTION = "--blocking-startup";
+
+	// Asset pack read before the loose files when present, and the command line
+	// option that packs the asset directories into it, optionally "=path", and exits
+	const char* const ASSET_PACK_PATH = "assets.pak";
+	const char* const PACK_ASSETS_OPTION = "--pack-assets";
+	const char* const PACK_DIRECTORIES[] = { "shaders", "textures", "scenes" };
+
+	// Text scene rendered unless "--scene=path" names another; its compiled form is loaded
+	const char* const DEFAULT_SCENE_PATH = "scenes/desk.scene";
+	const char* const SCENE_OPTION = "--scene=";
+
+	// Command line option that compiles a text scene, "=path", and exits
+	const char* const COMPILE_SCENE_OPTION = "--compile-scene=";
+	const char* const SCENE_DIRECTORY = "scenes";
+	const char* const SCENE_EXTENSION = ".scene";
+
+	// Archive of the shaders and textures, mapped for the whole run
+	AssetPack g_AssetPack;
+
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
 
@@ -43,6 +78,7 @@ namespace
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+bool PackAssets(const char* outputPath);
 
 
 /***********************************************************
@@ -53,6 +89,41 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// Startup is timed from here to the first frame and to the fully loaded scene
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	bool bProgressiveStartup = true;
+	const char* pScenePath = DEFAULT_SCENE_PATH;
+
+	// The decode benchmark needs no window or GL context
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], BENCH_DECODE_OPTION, strlen(BENCH_DECODE_OPTION)) == 0)
+		{
+			const char* pDirectory = argv[i] + strlen(BENCH_DECODE_OPTION);
+			pDirectory = (*pDirectory == '=') ? pDirectory + 1 : BENCH_DECODE_DIRECTORY;
+			return ImageDecoder::RunBenchmark(pDirectory, BENCH_DECODE_ITERATIONS) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (strncmp(argv[i], PACK_ASSETS_OPTION, strlen(PACK_ASSETS_OPTION)) == 0)
+		{
+			const char* pOutput = argv[i] + strlen(PACK_ASSETS_OPTION);
+			pOutput = (*pOutput == '=') ? pOutput + 1 : ASSET_PACK_PATH;
+			return PackAssets(pOutput) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (strncmp(argv[i], COMPILE_SCENE_OPTION, strlen(COMPILE_SCENE_OPTION)) == 0)
+		{
+			std::string sourcePath = argv[i] + strlen(COMPILE_SCENE_OPTION);
+			return SceneFile::Compile(sourcePath, SceneFile::GetCompiledPath(sourcePath)) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (strcmp(argv[i], BLOCKING_STARTUP_OPTION) == 0)
+		{
+			bProgressiveStartup = false;
+		}
+		if (strncmp(argv[i], SCENE_OPTION, strlen(SCENE_OPTION)) == 0)
+		{
+			pScenePath = argv[i] + strlen(SCENE_OPTION);
+		}
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (!InitializeGLFW())
 	{
@@ -74,39 +145,117 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// Load shaders from external GLSL files
-	g_ShaderManager->LoadShaders(
-		"../../../Utilities/shaders/vertexShader.glsl",
-		"../../../Utilities/shaders/fragmentShader.glsl");
-	g_ShaderManager->use();
+	// Textures are evicted to stay within the GPU memory budget, sized from the
+	// video memory the driver reports unless given on the command line
+	GpuMemoryTracker& memoryTracker = g_ShaderManager->GetResources().GetMemoryTracker();
+	size_t budget = GpuMemoryTracker::QueryDefaultBudget();
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], GPU_BUDGET_OPTION, strlen(GPU_BUDGET_OPTION)) == 0)
+		{
+			int megabytes = atoi(argv[i] + strlen(GPU_BUDGET_OPTION));
+			budget = (megabytes > 0) ? (size_t)megabytes * 1024 * 1024 : 0;
+		}
+	}
+	memoryTracker.SetBudget(budget);
+
+	// Read shaders and textures out of the asset pack when one was built,
+	// falling back to the loose files for anything it does not hold
+	if (g_AssetPack.Open(ASSET_PACK_PATH))
+	{
+		std::cout << "Asset pack: " << ASSET_PACK_PATH << ", " << g_AssetPack.GetEntryCount() << " files" << std::endl;
+		g_ShaderManager->SetAssetPack(&g_AssetPack);
+	}
+
+	// Start loading shaders from external GLSL files - a fallback
+	// program is used until the background compile finishes
+	g_ShaderManager->LoadShadersAsync(
+		"shaders/vertexShader.glsl",
+		"shaders/fragmentShader.glsl");
+	g_ShaderManager->UseProgram();
 
 	// Initialize Scene Manager and prepare the 3D scene
 	g_SceneManager = new SceneManager(g_ShaderManager);
-	g_SceneManager->PrepareScene();
+	if (g_AssetPack.IsOpen())
+	{
+		g_SceneManager->SetAssetPack(&g_AssetPack);
+	}
+
+	// if the scene cannot be loaded, then terminate the application
+	if (!g_SceneManager->LoadScene(pScenePath))
+	{
+		delete g_SceneManager;
+		g_SceneManager = nullptr;
+		delete g_ViewManager;
+		g_ViewManager = nullptr;
+		delete g_ShaderManager;
+		g_ShaderManager = nullptr;
+		glfwTerminate();
+		return(EXIT_FAILURE);
+	}
+	g_SceneManager->PrepareScene(bProgressiveStartup);
+	bool bFirstFrameShown = false;
+	bool bFullyLoaded = false;
 
 	// Main application loop
 	while (!glfwWindowShouldClose(g_Window))
 	{
+		// Swap in the real shader program once it has finished compiling
+		if (g_ShaderManager->PollShaders())
+		{
+			g_ShaderManager->UseProgram();
+			g_SceneManager->OnShaderProgramChanged();
+		}
+
 		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+		g_ShaderManager->GetStateCache().Enable(GL_DEPTH_TEST);
 
 		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		g_ShaderManager->GetStateCache().ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Prepare the 3D scene view projection
 		g_ViewManager->PrepareSceneView();
 
-		// Render the scene with updated objects and textures
+		// Render the scene with updated objects and textures,
+		// sorted front to back from the camera position and
+		// culled against the view frustum
+		g_SceneManager->SetViewPosition(g_ViewManager->GetCameraPosition());
+		g_SceneManager->SetViewProjection(g_ViewManager->GetViewProjection());
+
+		// Texture mip levels are kept resident by on-screen size
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+		g_SceneManager->SetViewportHeight(framebufferHeight);
 		g_SceneManager->RenderScene();
 
 		// Swap the buffers
 		glfwSwapBuffers(g_Window);
 
+		// Report the time to the first frame and to the fully loaded scene
+		if (!bFirstFrameShown || !bFullyLoaded)
+		{
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+			if (!bFirstFrameShown)
+			{
+				std::cout << "Startup: first frame after " << milliseconds << " ms" << std::endl;
+				bFirstFrameShown = true;
+			}
+			if (g_SceneManager->IsFullyLoaded() && g_ShaderManager->IsProgramReady())
+			{
+				std::cout << "Startup: fully loaded after " << milliseconds << " ms" << std::endl;
+				bFullyLoaded = true;
+			}
+		}
+
 		// Poll events
 		glfwPollEvents();
 	}
 
+	// Report the GPU memory in use and its peak
+	memoryTracker.PrintReport();
+
 	// Cleanup and free memory
 	if (g_SceneManager != nullptr)
 	{
@@ -177,3 +326,39 @@ bool InitializeGLEW()
 
 	return true;
 }
+
+/***********************************************************
+ *	PackAssets()
+ *
+ *  This function packs every file of the asset directories
+ *  into an archive and checks the result by reading it back.
+ *  Text scenes are compiled first where they changed, so the
+ *  pack holds their current compiled form.  Meshes are
+ *  generated in code, so there are none to pack.
+ ***********************************************************/
+bool PackAssets(const char* outputPath)
+{
+	const size_t extensionLength = strlen(SCENE_EXTENSION);
+	for (const std::string& name : MappedFile::ListDirectory(SCENE_DIRECTORY))
+	{
+		std::string sourcePath = std::string(SCENE_DIRECTORY) + "/" + name;
+		std::string compiledPath = SceneFile::GetCompiledPath(sourcePath);
+		if (name.size() > extensionLength && name.compare(name.size() - extensionLength, extensionLength, SCENE_EXTENSION) == 0 &&
+			SceneFile::IsOutOfDate(sourcePath, compiledPath) && !SceneFile::Compile(sourcePath, compiledPath))
+		{
+			return false;
+		}
+	}
+
+	std::vector<std::string> paths;
+	for (const char* pDirectory : PACK_DIRECTORIES)
+	{
+		for (const std::string& name : MappedFile::ListDirectory(pDirectory))
+		{
+			paths.push_back(std::string(pDirectory) + "/" + name);
+		}
+	}
+
+	AssetPack pack;
+	return AssetPack::Build(outputPath, paths) && pack.Open(outputPath) && pack.Verify();
+}
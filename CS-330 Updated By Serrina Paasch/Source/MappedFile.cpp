@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////
+// MappedFile.cpp
+// ==============
+// Map a whole file read-only into memory
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#include <algorithm>
+
+/***********************************************************
+ *  MappedFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedFile::MappedFile()
+{
+    m_pData = NULL;
+    m_size = 0;
+#ifdef _WIN32
+    m_fileHandle = INVALID_HANDLE_VALUE;
+    m_mappingHandle = NULL;
+#else
+    m_descriptor = -1;
+#endif
+}
+
+/***********************************************************
+ *  ~MappedFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method maps a whole file read-only.
+ ***********************************************************/
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    m_fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart <= 0)
+    {
+        Close();
+        return false;
+    }
+
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mappingHandle == NULL)
+    {
+        Close();
+        return false;
+    }
+
+    m_pData = (const unsigned char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    m_size = (size_t)fileSize.QuadPart;
+#else
+    m_descriptor = open(path.c_str(), O_RDONLY);
+    if (m_descriptor < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(m_descriptor, &status) != 0 || status.st_size <= 0)
+    {
+        Close();
+        return false;
+    }
+
+    void* pMapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, m_descriptor, 0);
+    m_pData = (pMapping == MAP_FAILED) ? NULL : (const unsigned char*)pMapping;
+    m_size = (size_t)status.st_size;
+#endif
+
+    if (m_pData == NULL)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method unmaps and closes the file.
+ ***********************************************************/
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (m_pData != NULL)
+    {
+        UnmapViewOfFile(m_pData);
+    }
+    if (m_mappingHandle != NULL)
+    {
+        CloseHandle(m_mappingHandle);
+        m_mappingHandle = NULL;
+    }
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_fileHandle);
+        m_fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_pData != NULL)
+    {
+        munmap((void*)m_pData, m_size);
+    }
+    if (m_descriptor >= 0)
+    {
+        close(m_descriptor);
+        m_descriptor = -1;
+    }
+#endif
+
+    m_pData = NULL;
+    m_size = 0;
+}
+
+/***********************************************************
+ *  ListDirectory()
+ *
+ *  This method gets the names of the files in a directory,
+ *  sorted, without the directory itself.  Hidden entries,
+ *  such as Thumbs.db, are skipped, and so are subdirectories
+ *  on Windows; elsewhere they are listed and fail to map.
+ ***********************************************************/
+std::vector<std::string> MappedFile::ListDirectory(const std::string& directory)
+{
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &findData);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if ((findData.dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_HIDDEN)) == 0)
+            {
+                names.push_back(findData.cFileName);
+            }
+        } while (FindNextFileA(find, &findData));
+        FindClose(find);
+    }
+#else
+    DIR* pDirectory = opendir(directory.c_str());
+    if (NULL != pDirectory)
+    {
+        for (struct dirent* pEntry = readdir(pDirectory); NULL != pEntry; pEntry = readdir(pDirectory))
+        {
+            if (pEntry->d_name[0] != '.')
+            {
+                names.push_back(pEntry->d_name);
+            }
+        }
+        closedir(pDirectory);
+    }
+#endif
+    std::sort(names.begin(), names.end());
+    return names;
+}
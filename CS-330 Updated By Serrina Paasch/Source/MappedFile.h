@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// MappedFile.h
+// ============
+// Map a whole file read-only into memory
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a file read-only into the address space
+ *  (MapViewOfFile on Windows, mmap elsewhere), so its bytes
+ *  can be read in place without copying them into a buffer
+ *  first.  Pages are loaded by the OS on first access.  The
+ *  mapping stays valid until Close() or destruction.
+ ***********************************************************/
+class MappedFile
+{
+public:
+    // Constructor: Initialize member variables
+    MappedFile();
+
+    // Destructor: Unmap and close the file
+    ~MappedFile();
+
+    // Map a whole file; false when it cannot be opened, is empty or cannot be mapped
+    bool Open(const std::string& path);
+
+    // Unmap and close the file
+    void Close();
+
+    // Access the mapped bytes
+    const unsigned char* GetData() const { return m_pData; }
+    size_t GetSize() const { return m_size; }
+    bool IsOpen() const { return m_pData != NULL; }
+
+    // Get the names of the files in a directory, sorted
+    static std::vector<std::string> ListDirectory(const std::string& directory);
+
+private:
+    const unsigned char* m_pData;        // Start of the mapping
+    size_t m_size;                       // Size of the file in bytes
+#ifdef _WIN32
+    void* m_fileHandle;                  // File handle
+    void* m_mappingHandle;               // File mapping object
+#else
+    int m_descriptor;                    // File descriptor
+#endif
+
+    // Mappings are owned by one object
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////////
+// PersistentRingBuffer.cpp
+// ========================
+// Persistently mapped buffer split into fenced per-frame regions
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PersistentRingBuffer.h"
+#include "GLResources.h"
+
+#include <iostream>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Longest single wait on a region fence before warning (nanoseconds)
+    const GLuint64 FENCE_TIMEOUT = 1000000000;
+}
+
+/***********************************************************
+ *  PersistentRingBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PersistentRingBuffer::PersistentRingBuffer()
+{
+    m_pStateCache = NULL;
+    m_pMemory = NULL;
+    m_target = GL_ARRAY_BUFFER;
+    m_buffer = 0;
+    m_pMapped = NULL;
+    m_regionSize = 0;
+    m_region = 0;
+    m_regionUsed = 0;
+    m_stallCount = 0;
+    for (int i = 0; i < REGION_COUNT; i++)
+    {
+        m_fences[i] = 0;
+    }
+}
+
+/***********************************************************
+ *  ~PersistentRingBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+PersistentRingBuffer::~PersistentRingBuffer()
+{
+    Destroy();
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method checks for immutable buffer storage (GL 4.4 or
+ *  ARB_buffer_storage) and fence syncs.
+ ***********************************************************/
+bool PersistentRingBuffer::IsSupported()
+{
+    return GLEW_VERSION_4_4 || (GLEW_ARB_buffer_storage && (GLEW_VERSION_3_2 || GLEW_ARB_sync));
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method creates the buffer with REGION_COUNT regions
+ *  of regionSize bytes and maps it persistently.  Coherent
+ *  mapping makes CPU writes visible to the GPU without
+ *  explicit flushes.
+ ***********************************************************/
+bool PersistentRingBuffer::Create(GLStateCache* pStateCache, GLenum target, GLsizeiptr regionSize, GpuMemoryTracker* pMemory)
+{
+    Destroy();
+
+    if (NULL == pStateCache || !IsSupported() || regionSize <= 0)
+        return false;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = regionSize * REGION_COUNT;
+
+    m_pStateCache = pStateCache;
+    m_target = target;
+    m_buffer = GLResources::CreateBuffer(*m_pStateCache, m_target, size, NULL, flags);
+    m_pMapped = (unsigned char*)GLResources::MapBuffer(*m_pStateCache, m_target, m_buffer, 0, size, flags);
+
+    if (m_pMapped == NULL)
+    {
+        std::cerr << "ERROR::BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+        Destroy();
+        return false;
+    }
+
+    m_regionSize = regionSize;
+    m_region = 0;
+    m_regionUsed = 0;
+
+    m_pMemory = pMemory;
+    if (NULL != m_pMemory)
+    {
+        m_pMemory->Allocate(GpuMemoryTracker::GetBufferCategory(m_target), (size_t)size);
+    }
+    return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method unmaps and frees the buffer and its fences.
+ ***********************************************************/
+void PersistentRingBuffer::Destroy()
+{
+    for (int i = 0; i < REGION_COUNT; i++)
+    {
+        if (m_fences[i] != 0)
+        {
+            glDeleteSync(m_fences[i]);
+            m_fences[i] = 0;
+        }
+    }
+
+    if (m_buffer != 0)
+    {
+        if (m_pMapped != NULL)
+        {
+            GLResources::UnmapBuffer(*m_pStateCache, m_target, m_buffer);
+            m_pMapped = NULL;
+        }
+        GLResources::DeleteBuffer(*m_pStateCache, m_buffer);
+    }
+
+    if (NULL != m_pMemory)
+    {
+        m_pMemory->Free(GpuMemoryTracker::GetBufferCategory(m_target), (size_t)(m_regionSize * REGION_COUNT));
+        m_pMemory = NULL;
+    }
+
+    m_regionSize = 0;
+    m_regionUsed = 0;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method moves to the next region and waits until the
+ *  GPU has finished the frame that last used it.
+ ***********************************************************/
+void PersistentRingBuffer::BeginFrame()
+{
+    if (m_pMapped == NULL)
+        return;
+
+    m_region = (m_region + 1) % REGION_COUNT;
+    m_regionUsed = 0;
+
+    GLsync fence = m_fences[m_region];
+    if (fence == 0)
+        return;
+
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        m_stallCount++;
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+        }
+    }
+    if (result == GL_WAIT_FAILED)
+    {
+        std::cerr << "ERROR::BUFFER::FENCE_WAIT_FAILED" << std::endl;
+    }
+
+    glDeleteSync(fence);
+    m_fences[m_region] = 0;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method fences the current region so that it is not
+ *  written again before the GPU has read it.
+ ***********************************************************/
+void PersistentRingBuffer::EndFrame()
+{
+    if (m_pMapped == NULL)
+        return;
+
+    if (m_fences[m_region] != 0)
+    {
+        glDeleteSync(m_fences[m_region]);
+    }
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method reserves size bytes in the current region.  The
+ *  offset is rounded up to a multiple of alignment measured
+ *  from the start of the buffer, so records of one type can be
+ *  addressed by index (e.g. through baseInstance).  Returns
+ *  NULL when the region has no room left this frame.
+ ***********************************************************/
+void* PersistentRingBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+{
+    if (m_pMapped == NULL || size <= 0)
+        return NULL;
+
+    GLintptr regionStart = m_region * m_regionSize;
+    GLintptr start = regionStart + m_regionUsed;
+    if (alignment > 1)
+    {
+        start = ((start + alignment - 1) / alignment) * alignment;
+    }
+
+    if (start + size > regionStart + m_regionSize)
+        return NULL;
+
+    m_regionUsed = start + size - regionStart;
+    offset = start;
+    return m_pMapped + start;
+}
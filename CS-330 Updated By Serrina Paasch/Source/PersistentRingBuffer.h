@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// PersistentRingBuffer.h
+// ======================
+// Persistently mapped buffer split into fenced per-frame regions
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GLStateCache.h"
+#include "GpuMemoryTracker.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  PersistentRingBuffer
+ *
+ *  This class owns one buffer created with glBufferStorage
+ *  and mapped once for the lifetime of the buffer (persistent
+ *  and coherent).  The buffer is split into REGION_COUNT equal
+ *  regions used round robin, one per frame.  The end of each
+ *  frame places a fence on its region; before the CPU writes
+ *  a region again it waits on that fence, which only blocks
+ *  when the GPU is more than REGION_COUNT - 1 frames behind.
+ *
+ *  Data is written straight into the mapped memory returned
+ *  by Allocate(); there is no map/unmap or copy per write.
+ ***********************************************************/
+class PersistentRingBuffer
+{
+public:
+    // Number of frames the CPU may run ahead of the GPU
+    static const int REGION_COUNT = 3;
+
+    // Constructor: Initialize member variables
+    PersistentRingBuffer();
+
+    // Destructor: Unmap and free the buffer
+    ~PersistentRingBuffer();
+
+    // True when persistently mapped buffers are available
+    static bool IsSupported();
+
+    // Create the buffer with regions of regionSize bytes (binds go through pStateCache,
+    // the size is recorded in pMemory when given)
+    bool Create(GLStateCache* pStateCache, GLenum target, GLsizeiptr regionSize, GpuMemoryTracker* pMemory = NULL);
+
+    // Unmap and free the buffer and its fences
+    void Destroy();
+
+    // Start a frame: move to the next region, waiting for the GPU if needed
+    void BeginFrame();
+
+    // End a frame: fence the region written during the frame
+    void EndFrame();
+
+    // Reserve size bytes at a multiple of alignment from the buffer start;
+    // returns the mapped pointer (NULL when the region is full)
+    void* Allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+
+    // Access the buffer
+    GLuint GetBuffer() const { return m_buffer; }
+    bool IsCreated() const { return m_pMapped != NULL; }
+
+    // Get the number of frames that had to wait on the GPU
+    unsigned int GetStallCount() const { return m_stallCount; }
+
+private:
+    GLStateCache* m_pStateCache;         // Cache used to bind the buffer
+    GpuMemoryTracker* m_pMemory;         // Records the size of the buffer (optional)
+    GLenum m_target;                     // Binding target used to create the buffer
+    GLuint m_buffer;                     // Buffer object
+    unsigned char* m_pMapped;            // Persistent mapping of the whole buffer
+    GLsizeiptr m_regionSize;             // Size of one region in bytes
+    int m_region;                        // Region of the current frame
+    GLsizeiptr m_regionUsed;             // Bytes allocated in the current region
+    GLsync m_fences[REGION_COUNT];       // Fence of the last frame that used each region
+    unsigned int m_stallCount;           // Frames that waited on a fence
+};
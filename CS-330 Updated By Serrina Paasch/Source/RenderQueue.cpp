@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderQueue.cpp
+// ===============
+// Collect the draws of a frame and order them to minimize state changes
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Widths and positions of the sort key fields
+    const int PROGRAM_SHIFT = 56;
+    const int MESH_SHIFT = 50;
+    const int TEXTURE_SHIFT = 41;
+    const int MATERIAL_SHIFT = 32;
+    const unsigned long long PROGRAM_MASK = 0xFF;
+    const unsigned long long MESH_MASK = 0x3F;
+    const unsigned long long TEXTURE_MASK = 0x1FF;
+    const unsigned long long MATERIAL_MASK = 0x1FF;
+
+    // The bits of a non-negative float order the same way as its value
+    unsigned int DepthBits(float depth)
+    {
+        if (!(depth > 0.0f))
+            return 0;
+
+        unsigned int bits;
+        memcpy(&bits, &depth, sizeof(bits));
+        return bits;
+    }
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+    m_viewPosition = glm::vec3(0.0f);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method removes all queued draws while keeping the
+ *  allocated storage for the next frame.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+    m_items.clear();
+    m_sortEntries.clear();
+}
+
+/***********************************************************
+ *  SetViewPosition()
+ *
+ *  This method sets the viewer position that the depth part
+ *  of the sort key is measured from.
+ ***********************************************************/
+void RenderQueue::SetViewPosition(const glm::vec3& viewPosition)
+{
+    m_viewPosition = viewPosition;
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method queues one draw item and computes its key.
+ * Time Complexity: O(1) - Amortized constant time
+ ***********************************************************/
+void RenderQueue::Submit(const DRAW_ITEM& item)
+{
+    DRAW_ITEM queued = item;
+    queued.depth = glm::length(glm::vec3(queued.model[3]) - m_viewPosition);
+    AddItem(queued);
+}
+
+/***********************************************************
+ *  Record()
+ *
+ *  This method records one draw item into a list, computing
+ *  its depth.  It only reads the queue, so worker threads can
+ *  record into their own lists at the same time.
+ * Time Complexity: O(1) - Amortized constant time
+ ***********************************************************/
+void RenderQueue::Record(DRAW_LIST& list, const DRAW_ITEM& item) const
+{
+    list.push_back(item);
+
+    DRAW_ITEM& recorded = list.back();
+    recorded.depth = glm::length(glm::vec3(recorded.model[3]) - m_viewPosition);
+}
+
+/***********************************************************
+ *  SubmitLists()
+ *
+ *  This method queues recorded lists one after another, so
+ *  the merged order does not depend on which thread finished
+ *  first.  Sort keys are computed here since the program
+ *  ranks are shared state.
+ * Time Complexity: O(n) - Where n is the number of recorded draws
+ ***********************************************************/
+void RenderQueue::SubmitLists(const DRAW_LIST* lists, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        for (const DRAW_ITEM& item : lists[i])
+        {
+            AddItem(item);
+        }
+    }
+}
+
+/***********************************************************
+ *  AddItem()
+ *
+ *  This method appends a draw item with its depth already set
+ *  and computes its key.
+ ***********************************************************/
+void RenderQueue::AddItem(const DRAW_ITEM& item)
+{
+    m_items.push_back(item);
+
+    SORT_ENTRY entry;
+    entry.key = MakeSortKey(item);
+    entry.itemIndex = (unsigned int)(m_items.size() - 1);
+    m_sortEntries.push_back(entry);
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method orders the queued draws by their keys and
+ *  records the state changes before and after sorting.  Equal
+ *  keys keep their submission order.
+ * Time Complexity: O(n log n) - Where n is the number of queued draws
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+    m_submittedChanges = CountStateChanges();
+
+    std::stable_sort(m_sortEntries.begin(), m_sortEntries.end(),
+        [](const SORT_ENTRY& a, const SORT_ENTRY& b) { return a.key < b.key; });
+
+    m_sortedChanges = CountStateChanges();
+}
+
+/***********************************************************
+ *  MakeSortKey()
+ *
+ *  This method packs the state of a draw item into its key.
+ *  Permutation keys are ranked in the order they are first
+ *  seen so the program fits in eight bits.
+ ***********************************************************/
+unsigned long long RenderQueue::MakeSortKey(const DRAW_ITEM& item)
+{
+    auto found = m_programRanks.find(item.programKey);
+    if (found == m_programRanks.end())
+    {
+        unsigned int rank = (unsigned int)m_programRanks.size();
+        found = m_programRanks.insert(std::make_pair(item.programKey, rank)).first;
+    }
+
+    unsigned long long key = 0;
+    key |= ((unsigned long long)found->second & PROGRAM_MASK) << PROGRAM_SHIFT;
+    key |= ((unsigned long long)(item.textureLayer + 1) & TEXTURE_MASK) << TEXTURE_SHIFT;
+    key |= ((unsigned long long)(item.materialIndex + 1) & MATERIAL_MASK) << MATERIAL_SHIFT;
+    key |= ((unsigned long long)item.mesh & MESH_MASK) << MESH_SHIFT;
+    key |= DepthBits(item.depth);
+    return key;
+}
+
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  This method counts how often the program, texture,
+ *  material and mesh change when the queued draws are issued
+ *  in the current entry order.  The first draw counts as a
+ *  change of every state.
+ * Time Complexity: O(n) - Where n is the number of queued draws
+ ***********************************************************/
+RenderQueue::STATE_CHANGES RenderQueue::CountStateChanges() const
+{
+    STATE_CHANGES changes;
+    const DRAW_ITEM* previous = NULL;
+
+    for (const SORT_ENTRY& entry : m_sortEntries)
+    {
+        const DRAW_ITEM& item = m_items[entry.itemIndex];
+        if (previous == NULL || previous->programKey != item.programKey)
+            changes.programChanges++;
+        if (previous == NULL || previous->textureLayer != item.textureLayer)
+            changes.textureChanges++;
+        if (previous == NULL || previous->materialIndex != item.materialIndex)
+            changes.materialChanges++;
+        if (previous == NULL || previous->mesh != item.mesh)
+            changes.meshChanges++;
+
+        changes.draws++;
+        previous = &item;
+    }
+
+    return changes;
+}
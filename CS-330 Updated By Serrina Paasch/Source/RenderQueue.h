@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderQueue.h
+// =============
+// Collect the draws of a frame and order them to minimize state changes
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class collects the draw items submitted for a frame
+ *  and sorts them by a packed 64-bit key so that draws sharing
+ *  a program, texture, mesh and material are issued together.
+ *  Draws can also be recorded into separate lists on worker
+ *  threads and merged on the GL thread.
+ *  Mesh sorts right below the program so that all draws of
+ *  one mesh are adjacent and can be merged into a single
+ *  instanced draw (the texture layer and the material are
+ *  per-instance values).
+ *
+ *  Sort key layout (most significant bits first):
+ *    63-56  program      (rank of the shader permutation)
+ *    55-50  mesh         (mesh type)
+ *    49-41  texture      (texture layer + 1, 0 = solid color)
+ *    40-32  material     (material index + 1, 0 = none)
+ *    31-0   depth        (distance to the viewer, front to back)
+ ***********************************************************/
+class RenderQueue
+{
+public:
+    // Constructor: Initialize member variables
+    RenderQueue();
+
+    // Structure to hold everything needed to issue one draw
+    struct DRAW_ITEM
+    {
+        glm::mat4 model;             // Model transform
+        glm::vec4 color;             // Solid color (untextured draws)
+        glm::vec2 uvScale;           // Texture coordinate scale
+        unsigned int programKey;     // Shader permutation key
+        int textureLayer;            // Texture array layer, -1 = solid color
+        int materialIndex;           // Material buffer index, -1 = none
+        int mesh;                    // Mesh type to draw
+        float depth;                 // Distance to the viewer (filled by Submit)
+    };
+
+    // Draws recorded by one thread, merged into the queue with SubmitLists()
+    typedef std::vector<DRAW_ITEM> DRAW_LIST;
+
+    // Structure to hold the number of state changes needed to
+    // issue the queued draws in a given order
+    struct STATE_CHANGES
+    {
+        unsigned int draws = 0;
+        unsigned int programChanges = 0;
+        unsigned int textureChanges = 0;
+        unsigned int materialChanges = 0;
+        unsigned int meshChanges = 0;
+
+        unsigned int Total() const { return programChanges + textureChanges + materialChanges + meshChanges; }
+    };
+
+    // Remove all queued draws (start of a frame)
+    void Clear();
+
+    // Set the viewer position used for depth sorting
+    void SetViewPosition(const glm::vec3& viewPosition);
+
+    // Queue one draw item
+    void Submit(const DRAW_ITEM& item);
+
+    // Record one draw item into a list (safe on worker threads)
+    void Record(DRAW_LIST& list, const DRAW_ITEM& item) const;
+
+    // Queue recorded lists in list order
+    void SubmitLists(const DRAW_LIST* lists, size_t count);
+
+    // Sort the queued draws by their packed keys
+    void Sort();
+
+    // Access the queued draws in sorted order
+    size_t GetCount() const { return m_sortEntries.size(); }
+    const DRAW_ITEM& GetItem(size_t index) const { return m_items[m_sortEntries[index].itemIndex]; }
+
+    // Get the state changes of the frame in submission and in sorted order
+    const STATE_CHANGES& GetSubmittedChanges() const { return m_submittedChanges; }
+    const STATE_CHANGES& GetSortedChanges() const { return m_sortedChanges; }
+
+private:
+    // Structure to hold the sort key of one queued draw
+    struct SORT_ENTRY
+    {
+        unsigned long long key;
+        unsigned int itemIndex;
+    };
+
+    std::vector<DRAW_ITEM> m_items;          // Queued draws in submission order
+    std::vector<SORT_ENTRY> m_sortEntries;   // Keys of the queued draws
+    std::unordered_map<unsigned int, unsigned int> m_programRanks;  // Permutation key -> key bits
+    glm::vec3 m_viewPosition;                // Viewer position for depth sorting
+    STATE_CHANGES m_submittedChanges;        // State changes in submission order
+    STATE_CHANGES m_sortedChanges;           // State changes in sorted order
+
+    // Build the packed sort key of a draw item
+    unsigned long long MakeSortKey(const DRAW_ITEM& item);
+
+    // Append a draw item whose depth is set and compute its key
+    void AddItem(const DRAW_ITEM& item);
+
+    // Count the state changes of issuing the draws in the current entry order
+    STATE_CHANGES CountStateChanges() const;
+};
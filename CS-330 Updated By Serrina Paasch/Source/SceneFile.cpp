@@ -0,0 +1,565 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneFile.cpp
+// =============
+// Compile scene descriptions and map the compiled form for rendering
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+#include "ShapeMeshes.h"
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include <glm/gtx/transform.hpp>
+
+// Declaration of global variables and defines
+namespace
+{
+    const char SCENE_MAGIC[8] = { 'S', 'C', 'E', 'N', 'E', 'B', 'I', 'N' };
+    const unsigned int SCENE_VERSION = 1;
+
+    // Extension of compiled scenes
+    const char* COMPILED_EXTENSION = ".scnb";
+
+    // Sections of a compiled scene, in file order
+    enum SECTION
+    {
+        SECTION_TRANSFORMS = 0,
+        SECTION_UV_SCALES,
+        SECTION_MESH_IDS,
+        SECTION_TEXTURE_IDS,
+        SECTION_MATERIAL_IDS,
+        SECTION_OBJECT_FLAGS,
+        SECTION_TEXTURES,
+        SECTION_MATERIALS,
+        SECTION_LIGHTS,
+        SECTION_STRINGS,
+        SECTION_COUNT
+    };
+
+    // Header of a compiled scene as stored in the file
+    struct SCENE_HEADER
+    {
+        char magic[8];
+        unsigned int version;
+        unsigned int objectCount;
+        unsigned int textureCount;
+        unsigned int materialCount;
+        unsigned int lightCount;
+        unsigned int stringsSize;
+        unsigned long long sectionOffsets[SECTION_COUNT];  // Byte offset of every section
+    };
+
+    // Names of the meshes in text scenes
+    struct MESH_NAME
+    {
+        const char* name;
+        ShapeMeshes::MESH_TYPE mesh;
+    };
+
+    const MESH_NAME MESH_NAMES[] =
+    {
+        { "plane", ShapeMeshes::MESH_PLANE },
+        { "box", ShapeMeshes::MESH_BOX },
+        { "cylinder", ShapeMeshes::MESH_CYLINDER },
+        { "cone", ShapeMeshes::MESH_CONE },
+        { "torus", ShapeMeshes::MESH_TORUS },
+        { "tapered_cylinder", ShapeMeshes::MESH_TAPERED_CYLINDER },
+        { "sphere", ShapeMeshes::MESH_SPHERE }
+    };
+
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return ((value + alignment - 1) / alignment) * alignment;
+    }
+
+    bool ReadVec3(std::istream& fields, glm::vec3& value)
+    {
+        return static_cast<bool>(fields >> value.x >> value.y >> value.z);
+    }
+
+    // Append a string to the string table; returns its offset
+    unsigned int AddString(std::string& strings, const std::string& value)
+    {
+        unsigned int offset = (unsigned int)strings.size();
+        strings += value;
+        return offset;
+    }
+
+    // Check that a section holds count elements of elementSize bytes inside the file
+    bool IsSectionValid(const SCENE_HEADER& header, int section, size_t count, size_t elementSize, size_t fileSize)
+    {
+        unsigned long long offset = header.sectionOffsets[section];
+        return offset % SceneFile::SECTION_ALIGNMENT == 0 && offset <= fileSize &&
+            count <= (fileSize - offset) / elementSize;
+    }
+
+    bool IsStringValid(unsigned int offset, unsigned int length, size_t stringsSize)
+    {
+        return offset <= stringsSize && length <= stringsSize - offset;
+    }
+}
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+    Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method maps a compiled scene, or finds it in the
+ *  asset pack, and points at its sections.
+ ***********************************************************/
+bool SceneFile::Open(const std::string& path, const AssetPack* pAssetPack)
+{
+    Close();
+
+    const unsigned char* pData = NULL;
+    size_t size = 0;
+    if (NULL == pAssetPack || !pAssetPack->Find(path, pData, size))
+    {
+        if (!m_file.Open(path))
+        {
+            std::cerr << "ERROR::SCENE::FILE_NOT_READ: " << path << std::endl;
+            return false;
+        }
+        pData = m_file.GetData();
+        size = m_file.GetSize();
+    }
+
+    if (!Attach(pData, size))
+    {
+        std::cerr << "ERROR::SCENE::INVALID: " << path << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+/***********************************************************
+ *  Attach()
+ *
+ *  This method checks the header, that every section lies
+ *  inside the data and that every id and string refers to
+ *  something that exists, then points at the sections.
+ *  Renderers can then index the arrays without any checks.
+ *
+ * Time Complexity: O(n) for n objects, a few comparisons each.
+ ***********************************************************/
+bool SceneFile::Attach(const unsigned char* pData, size_t size)
+{
+    static_assert(sizeof(glm::mat4) == 64 && sizeof(glm::vec2) == 8, "glm types must be tightly packed");
+    static_assert(sizeof(SCENE_MATERIAL) == 52 && sizeof(SCENE_LIGHT) == 56, "scene records must match the file layout");
+
+    if (size < sizeof(SCENE_HEADER))
+        return false;
+
+    const SCENE_HEADER& header = *(const SCENE_HEADER*)pData;
+    if (memcmp(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC)) != 0 || header.version != SCENE_VERSION)
+        return false;
+
+    size_t objects = header.objectCount;
+    if (!IsSectionValid(header, SECTION_TRANSFORMS, objects, sizeof(glm::mat4), size) ||
+        !IsSectionValid(header, SECTION_UV_SCALES, objects, sizeof(glm::vec2), size) ||
+        !IsSectionValid(header, SECTION_MESH_IDS, objects, sizeof(unsigned char), size) ||
+        !IsSectionValid(header, SECTION_TEXTURE_IDS, objects, sizeof(int), size) ||
+        !IsSectionValid(header, SECTION_MATERIAL_IDS, objects, sizeof(int), size) ||
+        !IsSectionValid(header, SECTION_OBJECT_FLAGS, objects, sizeof(unsigned char), size) ||
+        !IsSectionValid(header, SECTION_TEXTURES, header.textureCount, sizeof(SCENE_TEXTURE), size) ||
+        !IsSectionValid(header, SECTION_MATERIALS, header.materialCount, sizeof(SCENE_MATERIAL), size) ||
+        !IsSectionValid(header, SECTION_LIGHTS, header.lightCount, sizeof(SCENE_LIGHT), size) ||
+        !IsSectionValid(header, SECTION_STRINGS, header.stringsSize, sizeof(char), size))
+        return false;
+
+    const SCENE_TEXTURE* pTextures = (const SCENE_TEXTURE*)(pData + header.sectionOffsets[SECTION_TEXTURES]);
+    const SCENE_MATERIAL* pMaterials = (const SCENE_MATERIAL*)(pData + header.sectionOffsets[SECTION_MATERIALS]);
+    for (unsigned int i = 0; i < header.textureCount; i++)
+    {
+        if (!IsStringValid(pTextures[i].tagOffset, pTextures[i].tagLength, header.stringsSize) ||
+            !IsStringValid(pTextures[i].pathOffset, pTextures[i].pathLength, header.stringsSize))
+            return false;
+    }
+    for (unsigned int i = 0; i < header.materialCount; i++)
+    {
+        if (!IsStringValid(pMaterials[i].tagOffset, pMaterials[i].tagLength, header.stringsSize))
+            return false;
+    }
+
+    const unsigned char* pMeshIds = pData + header.sectionOffsets[SECTION_MESH_IDS];
+    const int* pTextureIds = (const int*)(pData + header.sectionOffsets[SECTION_TEXTURE_IDS]);
+    const int* pMaterialIds = (const int*)(pData + header.sectionOffsets[SECTION_MATERIAL_IDS]);
+    for (size_t i = 0; i < objects; i++)
+    {
+        if (pMeshIds[i] >= ShapeMeshes::MESH_COUNT ||
+            pTextureIds[i] < -1 || pTextureIds[i] >= (int)header.textureCount ||
+            pMaterialIds[i] < -1 || pMaterialIds[i] >= (int)header.materialCount)
+            return false;
+    }
+
+    m_pData = pData;
+    m_objectCount = objects;
+    m_pTransforms = (const glm::mat4*)(pData + header.sectionOffsets[SECTION_TRANSFORMS]);
+    m_pUVScales = (const glm::vec2*)(pData + header.sectionOffsets[SECTION_UV_SCALES]);
+    m_pMeshIds = pMeshIds;
+    m_pTextureIds = pTextureIds;
+    m_pMaterialIds = pMaterialIds;
+    m_pObjectFlags = pData + header.sectionOffsets[SECTION_OBJECT_FLAGS];
+    m_textureCount = header.textureCount;
+    m_pTextures = pTextures;
+    m_materialCount = header.materialCount;
+    m_pMaterials = pMaterials;
+    m_lightCount = header.lightCount;
+    m_pLights = (const SCENE_LIGHT*)(pData + header.sectionOffsets[SECTION_LIGHTS]);
+    m_pStrings = (const char*)(pData + header.sectionOffsets[SECTION_STRINGS]);
+    m_stringsSize = header.stringsSize;
+    return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method unmaps the scene.  Pointers handed out by the
+ *  getters are invalid afterwards.
+ ***********************************************************/
+void SceneFile::Close()
+{
+    m_file.Close();
+    m_pData = NULL;
+    m_objectCount = 0;
+    m_pTransforms = NULL;
+    m_pUVScales = NULL;
+    m_pMeshIds = NULL;
+    m_pTextureIds = NULL;
+    m_pMaterialIds = NULL;
+    m_pObjectFlags = NULL;
+    m_textureCount = 0;
+    m_pTextures = NULL;
+    m_materialCount = 0;
+    m_pMaterials = NULL;
+    m_lightCount = 0;
+    m_pLights = NULL;
+    m_pStrings = NULL;
+    m_stringsSize = 0;
+}
+
+/***********************************************************
+ *  GetString()
+ *
+ *  This method copies a string out of the string table.
+ ***********************************************************/
+std::string SceneFile::GetString(unsigned int offset, unsigned int length) const
+{
+    if (!IsStringValid(offset, length, m_stringsSize))
+        return std::string();
+    return std::string(m_pStrings + offset, length);
+}
+
+/***********************************************************
+ *  Compile()
+ *
+ *  This method parses a text scene, resolves the texture and
+ *  material tags of its objects to ids, bakes their model
+ *  matrices and writes the sections of the compiled form.
+ *  The first syntax error is reported with its line and
+ *  stops the compile.  The output is written to a temporary
+ *  file and renamed, so a failed compile leaves an older
+ *  scene alone.
+ *
+ * Time Complexity: O(n) for n lines.
+ ***********************************************************/
+bool SceneFile::Compile(const std::string& sourcePath, const std::string& outputPath)
+{
+    std::ifstream sourceFile(sourcePath.c_str());
+    if (!sourceFile)
+    {
+        std::cerr << "ERROR::SCENE::FILE_NOT_READ: " << sourcePath << std::endl;
+        return false;
+    }
+
+    std::vector<glm::mat4> transforms;
+    std::vector<glm::vec2> uvScales;
+    std::vector<unsigned char> meshIds;
+    std::vector<int> textureIds;
+    std::vector<int> materialIds;
+    std::vector<unsigned char> objectFlags;
+    std::vector<SCENE_TEXTURE> textures;
+    std::vector<SCENE_MATERIAL> materials;
+    std::vector<SCENE_LIGHT> lights;
+    std::string strings;
+    std::unordered_map<std::string, int> textureTags;
+    std::unordered_map<std::string, int> materialTags;
+
+    std::string line;
+    std::string error;
+    int lineNumber = 0;
+    while (error.empty() && std::getline(sourceFile, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword))
+            continue;
+
+        if (keyword == "texture")
+        {
+            std::string tag;
+            std::string path;
+            if (!(fields >> tag >> path))
+                error = "expected: texture <tag> <image path>";
+            else if (textureTags.count(tag) != 0)
+                error = "texture '" + tag + "' is already defined";
+            else
+            {
+                SCENE_TEXTURE texture;
+                texture.tagLength = (unsigned int)tag.size();
+                texture.tagOffset = AddString(strings, tag);
+                texture.pathLength = (unsigned int)path.size();
+                texture.pathOffset = AddString(strings, path);
+                textureTags[tag] = (int)textures.size();
+                textures.push_back(texture);
+            }
+        }
+        else if (keyword == "material")
+        {
+            std::string tag;
+            SCENE_MATERIAL material;
+            if (!(fields >> tag) || !ReadVec3(fields, material.ambientColor) || !(fields >> material.ambientStrength) ||
+                !ReadVec3(fields, material.diffuseColor) || !ReadVec3(fields, material.specularColor) || !(fields >> material.shininess))
+                error = "expected: material <tag> <ambient r g b> <ambient strength> <diffuse r g b> <specular r g b> <shininess>";
+            else if (materialTags.count(tag) != 0)
+                error = "material '" + tag + "' is already defined";
+            else
+            {
+                material.tagLength = (unsigned int)tag.size();
+                material.tagOffset = AddString(strings, tag);
+                materialTags[tag] = (int)materials.size();
+                materials.push_back(material);
+            }
+        }
+        else if (keyword == "light")
+        {
+            SCENE_LIGHT light;
+            if (!ReadVec3(fields, light.position) || !ReadVec3(fields, light.ambientColor) || !ReadVec3(fields, light.diffuseColor) ||
+                !ReadVec3(fields, light.specularColor) || !(fields >> light.focalStrength >> light.specularIntensity))
+                error = "expected: light <position x y z> <ambient r g b> <diffuse r g b> <specular r g b> <focal strength> <specular intensity>";
+            else
+                lights.push_back(light);
+        }
+        else if (keyword == "object")
+        {
+            std::string meshName;
+            std::string textureTag;
+            std::string materialTag;
+            glm::vec3 scale;
+            glm::vec3 rotation;
+            glm::vec3 position;
+            if (!(fields >> meshName >> textureTag >> materialTag) ||
+                !ReadVec3(fields, scale) || !ReadVec3(fields, rotation) || !ReadVec3(fields, position))
+            {
+                error = "expected: object <mesh> <texture tag | -> <material tag | -> <scale x y z> <rotation x y z> <position x y z> [uv <u> <v>] [dynamic]";
+            }
+
+            int mesh = -1;
+            for (const MESH_NAME& name : MESH_NAMES)
+            {
+                if (meshName == name.name)
+                    mesh = name.mesh;
+            }
+
+            glm::vec2 uvScale(1.0f);
+            unsigned char flags = 0;
+            std::string option;
+            while (error.empty() && fields >> option)
+            {
+                if (option == "uv" && fields >> uvScale.x >> uvScale.y)
+                    continue;
+                if (option == "dynamic")
+                    flags |= OBJECT_DYNAMIC;
+                else
+                    error = "unexpected '" + option + "'";
+            }
+
+            if (!error.empty())
+                continue;
+            else if (mesh < 0)
+                error = "unknown mesh '" + meshName + "'";
+            else if (textureTag != "-" && textureTags.count(textureTag) == 0)
+                error = "undefined texture '" + textureTag + "'";
+            else if (materialTag != "-" && materialTags.count(materialTag) == 0)
+                error = "undefined material '" + materialTag + "'";
+
+            if (error.empty())
+            {
+                transforms.push_back(BuildModelMatrix(scale, rotation.x, rotation.y, rotation.z, position));
+                uvScales.push_back(uvScale);
+                meshIds.push_back((unsigned char)mesh);
+                textureIds.push_back((textureTag == "-") ? -1 : textureTags[textureTag]);
+                materialIds.push_back((materialTag == "-") ? -1 : materialTags[materialTag]);
+                objectFlags.push_back(flags);
+            }
+        }
+        else
+        {
+            error = "unknown keyword '" + keyword + "'";
+        }
+
+        // Everything a line holds must be used
+        std::string extra;
+        if (error.empty() && fields >> extra)
+            error = "unexpected '" + extra + "'";
+    }
+
+    if (!error.empty())
+    {
+        std::cerr << "ERROR::SCENE::SYNTAX: " << sourcePath << ":" << lineNumber << ": " << error << std::endl;
+        return false;
+    }
+
+    // Place the sections after the header, each aligned
+    SCENE_HEADER header = {};
+    memcpy(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+    header.version = SCENE_VERSION;
+    header.objectCount = (unsigned int)transforms.size();
+    header.textureCount = (unsigned int)textures.size();
+    header.materialCount = (unsigned int)materials.size();
+    header.lightCount = (unsigned int)lights.size();
+    header.stringsSize = (unsigned int)strings.size();
+
+    const void* sectionData[SECTION_COUNT] =
+    {
+        transforms.data(), uvScales.data(), meshIds.data(), textureIds.data(), materialIds.data(),
+        objectFlags.data(), textures.data(), materials.data(), lights.data(), strings.data()
+    };
+    const size_t sectionSizes[SECTION_COUNT] =
+    {
+        transforms.size() * sizeof(glm::mat4), uvScales.size() * sizeof(glm::vec2), meshIds.size(),
+        textureIds.size() * sizeof(int), materialIds.size() * sizeof(int), objectFlags.size(),
+        textures.size() * sizeof(SCENE_TEXTURE), materials.size() * sizeof(SCENE_MATERIAL),
+        lights.size() * sizeof(SCENE_LIGHT), strings.size()
+    };
+
+    size_t fileSize = sizeof(SCENE_HEADER);
+    for (int section = 0; section < SECTION_COUNT; section++)
+    {
+        fileSize = AlignUp(fileSize, SECTION_ALIGNMENT);
+        header.sectionOffsets[section] = fileSize;
+        fileSize += sectionSizes[section];
+    }
+
+    std::vector<unsigned char> contents(fileSize, 0);
+    memcpy(contents.data(), &header, sizeof(header));
+    for (int section = 0; section < SECTION_COUNT; section++)
+    {
+        if (sectionSizes[section] > 0)
+        {
+            memcpy(&contents[(size_t)header.sectionOffsets[section]], sectionData[section], sectionSizes[section]);
+        }
+    }
+
+    std::string tempPath = outputPath + ".tmp";
+    std::ofstream outputFile(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (outputFile)
+    {
+        outputFile.write((const char*)contents.data(), (std::streamsize)contents.size());
+        outputFile.close();
+    }
+
+    // A failed write leaves the previous compiled scene in place
+    bool bWritten = (bool)outputFile;
+    if (bWritten)
+    {
+        // rename() does not replace an existing file on every platform
+        std::remove(outputPath.c_str());
+        bWritten = std::rename(tempPath.c_str(), outputPath.c_str()) == 0;
+    }
+
+    if (!bWritten)
+    {
+        std::cerr << "ERROR::SCENE::WRITE_FAILED: " << outputPath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::cout << "Scene: compiled " << sourcePath << " to " << outputPath << ", " << header.objectCount << " objects, "
+        << header.textureCount << " textures, " << header.materialCount << " materials, " << header.lightCount << " lights" << std::endl;
+    return true;
+}
+
+/***********************************************************
+ *  GetCompiledPath()
+ *
+ *  This method replaces the extension of a text scene with
+ *  the one of compiled scenes.
+ ***********************************************************/
+std::string SceneFile::GetCompiledPath(const std::string& sourcePath)
+{
+    size_t directoryEnd = sourcePath.find_last_of("/\\");
+    size_t extension = sourcePath.find_last_of('.');
+    if (extension == std::string::npos || (directoryEnd != std::string::npos && extension < directoryEnd))
+        return sourcePath + COMPILED_EXTENSION;
+    return sourcePath.substr(0, extension) + COMPILED_EXTENSION;
+}
+
+/***********************************************************
+ *  HasSource()
+ *
+ *  This method checks whether the text form of a scene is on
+ *  disk, as it is while scenes are being edited.
+ ***********************************************************/
+bool SceneFile::HasSource(const std::string& sourcePath)
+{
+    struct stat sourceStatus;
+    return stat(sourcePath.c_str(), &sourceStatus) == 0;
+}
+
+/***********************************************************
+ *  IsOutOfDate()
+ *
+ *  This method compares the modification times of a text
+ *  scene and its compiled form.  A missing text scene, as
+ *  when shipping only compiled scenes, is never out of date.
+ ***********************************************************/
+bool SceneFile::IsOutOfDate(const std::string& sourcePath, const std::string& compiledPath)
+{
+    struct stat sourceStatus;
+    struct stat compiledStatus;
+    if (stat(sourcePath.c_str(), &sourceStatus) != 0)
+        return false;
+    if (stat(compiledPath.c_str(), &compiledStatus) != 0)
+        return true;
+    return sourceStatus.st_mtime > compiledStatus.st_mtime;
+}
+
+/***********************************************************
+ *  BuildModelMatrix()
+ *
+ *  This method builds a model transform: scale, then rotate
+ *  about Z, Y and X, then translate.
+ * Time Complexity: O(1) - Fixed number of matrix operations
+ ***********************************************************/
+glm::mat4 SceneFile::BuildModelMatrix(const glm::vec3& scale, float xRotation, float yRotation, float zRotation, const glm::vec3& position)
+{
+    glm::mat4 scaling = glm::scale(scale);
+    glm::mat4 rotationX = glm::rotate(glm::radians(xRotation), glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::mat4 rotationY = glm::rotate(glm::radians(yRotation), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 rotationZ = glm::rotate(glm::radians(zRotation), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 translation = glm::translate(position);
+
+    return translation * rotationX * rotationY * rotationZ * scaling;
+}
@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneFile.h
+// ===========
+// Compile scene descriptions and map the compiled form for rendering
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+#include "AssetPack.h"
+
+#include <string>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class holds a scene in its compiled form: the
+ *  textures, materials and lights it uses and flat arrays of
+ *  its objects' transforms, UV scales, mesh ids, texture ids,
+ *  material ids and flags.  Open() maps the file (or finds it
+ *  in an asset pack) and points at the arrays where they lie,
+ *  so loading costs a few bounds checks however many objects
+ *  the scene holds; nothing is parsed or copied.
+ *
+ *  Scenes are written by hand in a text form, one item per
+ *  line, and compiled once with Compile():
+ *
+ *    texture  <tag> <image path>
+ *    material <tag> <ambient r g b> <ambient strength>
+ *             <diffuse r g b> <specular r g b> <shininess>
+ *    light    <position x y z> <ambient r g b> <diffuse r g b>
+ *             <specular r g b> <focal strength> <specular intensity>
+ *    object   <mesh> <texture tag | -> <material tag | ->
+ *             <scale x y z> <rotation x y z in degrees>
+ *             <position x y z> [uv <u> <v>] [dynamic]
+ *
+ *  Meshes are named plane, box, cylinder, cone, torus,
+ *  tapered_cylinder and sphere.  Tags must be defined before
+ *  the objects using them; "#" starts a comment.  The
+ *  compiler resolves tags to ids and bakes the transforms
+ *  into model matrices.
+ *
+ *  Compiled layout, in the byte order and float format of
+ *  the host (little-endian IEEE on every supported platform):
+ *  a header with the counts and the offset of every section,
+ *  then the sections, each aligned to SECTION_ALIGNMENT.
+ ***********************************************************/
+class SceneFile
+{
+public:
+    // Object flags
+    static const unsigned char OBJECT_DYNAMIC = 0x01;   // Moves; recorded every frame instead of batched
+
+    // Sections start at multiples of this many bytes
+    static const size_t SECTION_ALIGNMENT = 64;
+
+    // Structure to hold a texture of the scene
+    struct SCENE_TEXTURE
+    {
+        unsigned int tagOffset;          // Tag in the string table
+        unsigned int tagLength;
+        unsigned int pathOffset;         // Image path in the string table
+        unsigned int pathLength;
+    };
+
+    // Structure to hold a material of the scene
+    struct SCENE_MATERIAL
+    {
+        glm::vec3 ambientColor;
+        float ambientStrength;
+        glm::vec3 diffuseColor;
+        glm::vec3 specularColor;
+        float shininess;
+        unsigned int tagOffset;          // Tag in the string table
+        unsigned int tagLength;
+    };
+
+    // Structure to hold a light source of the scene
+    struct SCENE_LIGHT
+    {
+        glm::vec3 position;
+        glm::vec3 ambientColor;
+        glm::vec3 diffuseColor;
+        glm::vec3 specularColor;
+        float focalStrength;
+        float specularIntensity;
+    };
+
+    // Constructor: Initialize member variables
+    SceneFile();
+
+    // Map a compiled scene, from the asset pack when it holds the file; false when missing or malformed
+    bool Open(const std::string& path, const AssetPack* pAssetPack = NULL);
+
+    // Unmap the scene
+    void Close();
+
+    // Check whether a scene is open
+    bool IsOpen() const { return NULL != m_pData; }
+
+    // Get the object arrays, GetObjectCount() entries each
+    size_t GetObjectCount() const { return m_objectCount; }
+    const glm::mat4* GetTransforms() const { return m_pTransforms; }
+    const glm::vec2* GetUVScales() const { return m_pUVScales; }
+    const unsigned char* GetMeshIds() const { return m_pMeshIds; }
+    const int* GetTextureIds() const { return m_pTextureIds; }       // -1 = solid color
+    const int* GetMaterialIds() const { return m_pMaterialIds; }     // -1 = none
+    const unsigned char* GetObjectFlags() const { return m_pObjectFlags; }
+
+    // Get the textures, materials and lights of the scene
+    size_t GetTextureCount() const { return m_textureCount; }
+    const SCENE_TEXTURE* GetTextures() const { return m_pTextures; }
+    size_t GetMaterialCount() const { return m_materialCount; }
+    const SCENE_MATERIAL* GetMaterials() const { return m_pMaterials; }
+    size_t GetLightCount() const { return m_lightCount; }
+    const SCENE_LIGHT* GetLights() const { return m_pLights; }
+
+    // Get a string of the string table
+    std::string GetString(unsigned int offset, unsigned int length) const;
+
+    // Compile a text scene into the binary form; false on a syntax error or when it cannot be written
+    static bool Compile(const std::string& sourcePath, const std::string& outputPath);
+
+    // Get the path a text scene compiles to (its extension replaced by ".scnb")
+    static std::string GetCompiledPath(const std::string& sourcePath);
+
+    // Check whether a text scene is on disk (false when only compiled scenes ship)
+    static bool HasSource(const std::string& sourcePath);
+
+    // Check whether a text scene is newer than its compiled form, or that is missing
+    static bool IsOutOfDate(const std::string& sourcePath, const std::string& compiledPath);
+
+    // Build a model matrix from a scale, rotations in degrees and a position
+    static glm::mat4 BuildModelMatrix(const glm::vec3& scale, float xRotation, float yRotation, float zRotation, const glm::vec3& position);
+
+private:
+    MappedFile m_file;                   // Mapping of the scene (unused when it is in a pack)
+    const unsigned char* m_pData;        // Start of the compiled scene
+    size_t m_objectCount;                // Objects in the scene
+    const glm::mat4* m_pTransforms;      // Model matrix per object
+    const glm::vec2* m_pUVScales;        // Texture coordinate scale per object
+    const unsigned char* m_pMeshIds;     // ShapeMeshes::MESH_TYPE per object
+    const int* m_pTextureIds;            // Texture per object
+    const int* m_pMaterialIds;           // Material per object
+    const unsigned char* m_pObjectFlags; // OBJECT_* flags per object
+    size_t m_textureCount;               // Textures of the scene
+    const SCENE_TEXTURE* m_pTextures;
+    size_t m_materialCount;              // Materials of the scene
+    const SCENE_MATERIAL* m_pMaterials;
+    size_t m_lightCount;                 // Light sources of the scene
+    const SCENE_LIGHT* m_pLights;
+    const char* m_pStrings;              // String table
+    size_t m_stringsSize;                // Bytes of the string table
+
+    // Point at the sections of a compiled scene after checking them
+    bool Attach(const unsigned char* pData, size_t size);
+
+    // Scenes are owned by one object
+    SceneFile(const SceneFile&);
+    SceneFile& operator=(const SceneFile&);
+};
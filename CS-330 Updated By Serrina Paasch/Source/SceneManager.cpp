@@ -6,156 +6,1203 @@
 //  AUTHOR: Serrina Paasch
 ///////////////////////////////////////////////////////////////////////////////
 #include "SceneManager.h"
+#include "GLResources.h"
 
-// Constants for repeated values
-const glm::vec3 DEFAULT_ROTATION = glm::vec3(0.0f);
-const float PLANE_UV_SCALE = 2.0f;
-const float DEFAULT_UV_SCALE = 1.0f;
-const glm::vec3 FLOOR_SCALE = glm::vec3(20.0f, 2.0f, 10.0f);
-const glm::vec3 BACKGROUND_SCALE = glm::vec3(20.0f, 2.0f, 10.0f);
-const glm::vec3 TEA_MUG_SCALE = glm::vec3(2.0f, 7.0f, 2.0f);
-const glm::vec3 TEA_LIQUID_SCALE = glm::vec3(1.9f, 7.01f, 2.0f);
-const glm::vec3 HANDLE_SCALE = glm::vec3(2.0f, 2.5f, 2.0f);
+#include <iostream>
+#include <thread>
+#include <chrono>
 
-// Helper Functions
-void ApplyTransformations(const glm::vec3& scale, float xRotation, float yRotation, float zRotation, const glm::vec3& position) {
-    SetTransformations(scale, xRotation, yRotation, zRotation, position);
+// Shader uniform names
+namespace
+{
+    const char* g_ModelName = "model";
+    const char* g_ColorValueName = "objectColor";
+    const char* g_TextureLayerName = "textureLayer";
+    const char* g_UseTextureName = "bUseTexture";
+    const char* g_UseLightingName = "bUseLighting";
+    const char* g_UVScaleName = "UVscale";
+    const char* g_MaterialIndexName = "materialIndex";
+
+    // Uniform buffer blocks and their binding points
+    const char* g_LightBlockName = "LightBlock";
+    const char* g_MaterialBlockName = "MaterialBlock";
+    const GLuint LIGHT_BLOCK_BINDING = 0;
+    const GLuint MATERIAL_BLOCK_BINDING = 1;
+}
+
+// Smallest run of identical mesh/texture draws merged into an instanced draw
+const size_t MIN_INSTANCED_DRAW = 2;
+
+// Smallest number of objects or records prepared by one worker thread
+const size_t MIN_RECORD_RANGE = 512;
+
+// Width and height every texture is resampled to in the texture array
+const GLsizei TEXTURE_LAYER_SIZE = 1024;
+
+// Time per frame spent uploading streamed texture levels
+const double TEXTURE_UPLOAD_BUDGET_MS = 2.0;
+
+// Mip level the texture array starts from (256x256) until the first frame measures what is needed
+const GLint TEXTURE_INITIAL_RESIDENT_LEVEL = 2;
+
+/***********************************************************
+ *  SceneManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneManager::SceneManager(ShaderManager* pShaderManager)
+{
+    m_pShaderManager = pShaderManager;
+    m_basicMeshes = new ShapeMeshes(&m_pShaderManager->GetStateCache(), &m_pShaderManager->GetResources().GetMemoryTracker());
+
+    m_lightBuffer = 0;
+    m_materialBuffer = 0;
+    m_bUseLighting = false;
+    m_pAssetPack = NULL;
+    m_reportedDrawCalls = 0;
+    m_viewProjection = glm::mat4(1.0f);
+    m_viewportHeight = 0;
+    m_bFrameRendered = false;
+    m_textureLoader.Initialize(&m_threadPool, &m_textureArray, &m_pShaderManager->GetResources());
+    m_textureStreamer.Initialize(&m_textureArray, &m_textureLoader, &m_pShaderManager->GetResources().GetMemoryTracker());
+
+    ResolveUniformHandles();
+}
+
+/***********************************************************
+ *  ~SceneManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneManager::~SceneManager()
+{
+    if (NULL != m_basicMeshes)
+    {
+        delete m_basicMeshes;
+        m_basicMeshes = NULL;
+    }
+    DestroyGLTextures();
+    m_pShaderManager = NULL;
+
+    // The uniform buffers themselves are owned by the shader manager
+    m_lightBuffer = 0;
+    m_materialBuffer = 0;
+}
+
+/***********************************************************
+ *  ResolveUniformHandles()
+ *
+ *  This method resolves the handles for every uniform the
+ *  scene sets per draw, so draws never look uniforms up by
+ *  name.
+ * Time Complexity: O(1) - Fixed number of uniforms resolved once
+ ***********************************************************/
+void SceneManager::ResolveUniformHandles()
+{
+    if (NULL == m_pShaderManager)
+        return;
+
+    m_uniforms.model = m_pShaderManager->GetUniform<glm::mat4>(g_ModelName);
+    m_uniforms.objectColor = m_pShaderManager->GetUniform<glm::vec4>(g_ColorValueName);
+    m_uniforms.textureLayer = m_pShaderManager->GetUniform<int>(g_TextureLayerName);
+    m_uniforms.useTexture = m_pShaderManager->GetUniform<bool>(g_UseTextureName);
+    m_uniforms.useLighting = m_pShaderManager->GetUniform<bool>(g_UseLightingName);
+    m_uniforms.uvScale = m_pShaderManager->GetUniform<glm::vec2>(g_UVScaleName);
+
+    m_uniforms.materialAmbientColor = m_pShaderManager->GetUniform<glm::vec3>("material.ambientColor");
+    m_uniforms.materialAmbientStrength = m_pShaderManager->GetUniform<float>("material.ambientStrength");
+    m_uniforms.materialDiffuseColor = m_pShaderManager->GetUniform<glm::vec3>("material.diffuseColor");
+    m_uniforms.materialSpecularColor = m_pShaderManager->GetUniform<glm::vec3>("material.specularColor");
+    m_uniforms.materialShininess = m_pShaderManager->GetUniform<float>("material.shininess");
+    m_uniforms.materialIndex = m_pShaderManager->GetUniform<int>(g_MaterialIndexName);
+}
+
+/***********************************************************
+ *  CreateGLTexture()
+ *
+ *  This method reserves the next free layer of the texture
+ *  array for an image file and associates it with the tag at
+ *  once.  The image is decoded on the thread pool and its
+ *  pixels are uploaded by RenderScene() over the next frames;
+ *  until then the layer shows neutral grey.  The array must
+ *  have been created with room for the texture.
+ ***********************************************************/
+bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
+{
+    if (m_textureArray.GetLayerCount() >= m_textureArray.GetCapacity())
+    {
+        std::cerr << "ERROR::TEXTURE::NO_FREE_LAYER: " << tag << " (" << m_textureArray.GetCapacity() << " layers in use)" << std::endl;
+        return false;
+    }
+
+    TEXTURE_INFO texture;
+    texture.tag = tag;
+    texture.layer = m_textureLoader.Queue(filename);
+    if (texture.layer < 0)
+    {
+        std::cout << "Could not load image:" << filename << std::endl;
+        return false;
+    }
+
+    // Register the texture and associate it with the tag string
+    m_textures.push_back(texture);
+
+    return true;
+}
+
+/***********************************************************
+ *  BindGLTextures()
+ *
+ *  This method binds the texture array holding every loaded
+ *  texture to texture unit 0, where the objectTextures
+ *  sampler of the shaders reads by default.
+ ***********************************************************/
+void SceneManager::BindGLTextures()
+{
+    m_textureArray.Bind(0);
+}
+
+/***********************************************************
+ *  DestroyGLTextures()
+ *
+ *  This method stops loading textures and frees the texture
+ *  array.  It is deleted once the frames still using it have
+ *  finished.
+ ***********************************************************/
+void SceneManager::DestroyGLTextures()
+{
+    m_textureLoader.Cancel();
+    m_textureArray.Destroy();
+    m_textures.clear();
+}
+
+/***********************************************************
+ *  GetPermutationKey()
+ *
+ *  This method builds the shader permutation key for a draw
+ *  from its texturing and the scene lighting state.
+ ***********************************************************/
+unsigned int SceneManager::GetPermutationKey(bool bTextured) const
+{
+    unsigned int flags = 0;
+    int lightCount = 0;
+
+    if (bTextured)
+        flags |= SHADER_PERMUTATION_TEXTURE;
+
+    if (m_bUseLighting)
+    {
+        flags |= SHADER_PERMUTATION_LIGHTING;
+        lightCount = (int)m_lights.size() < MAX_LIGHTS ? (int)m_lights.size() : MAX_LIGHTS;
+    }
+
+    return ShaderManager::MakePermutationKey(flags, lightCount);
+}
+
+/***********************************************************
+ *  SetShaderMaterialIndex()
+ *
+ *  This method selects the material with the given buffer
+ *  index for the next draw.  A negative index leaves the
+ *  current material in place.
+ ***********************************************************/
+void SceneManager::SetShaderMaterialIndex(int materialIndex)
+{
+    if (NULL == m_pShaderManager || materialIndex < 0 || materialIndex >= (int)m_objectMaterials.size())
+        return;
+
+    if (m_materialBuffer != 0)
+    {
+        m_pShaderManager->setIntValue(m_uniforms.materialIndex, materialIndex);
+        return;
+    }
+
+    const OBJECT_MATERIAL& material = m_objectMaterials[materialIndex];
+    m_pShaderManager->setVec3Value(m_uniforms.materialAmbientColor, material.ambientColor);
+    m_pShaderManager->setFloatValue(m_uniforms.materialAmbientStrength, material.ambientStrength);
+    m_pShaderManager->setVec3Value(m_uniforms.materialDiffuseColor, material.diffuseColor);
+    m_pShaderManager->setVec3Value(m_uniforms.materialSpecularColor, material.specularColor);
+    m_pShaderManager->setFloatValue(m_uniforms.materialShininess, material.shininess);
+}
+
+/***********************************************************
+ *  MakeDrawItem()
+ *
+ *  This method builds the draw item of a scene object.  It
+ *  only reads scene state, so worker threads may call it.
+ * Time Complexity: O(1) - Constant time to build the draw item
+ ***********************************************************/
+RenderQueue::DRAW_ITEM SceneManager::MakeDrawItem(const SCENE_OBJECT& object) const
+{
+    RenderQueue::DRAW_ITEM item;
+    item.model = object.model;
+    item.color = glm::vec4(1.0f);
+    item.uvScale = object.uvScale;
+    item.programKey = GetPermutationKey(object.textureLayer >= 0);
+    item.textureLayer = object.textureLayer;
+    item.materialIndex = object.materialIndex;
+    item.mesh = object.mesh;
+    item.depth = 0.0f;
+    return item;
+}
+
+/***********************************************************
+ *  RecordDynamicObjects()
+ *
+ *  This method splits the scene objects into ranges that the
+ *  worker threads record into their own draw lists.  The GL
+ *  thread then merges the lists in range order, so the queue
+ *  matches a single-threaded traversal.
+ * Time Complexity: O(n / t) - Where n is the number of scene objects, t the number of threads
+ ***********************************************************/
+void SceneManager::RecordDynamicObjects()
+{
+    size_t rangeCount = m_threadPool.GetRangeCount(m_sceneObjects.size(), MIN_RECORD_RANGE);
+    if (m_drawLists.size() < rangeCount)
+    {
+        m_drawLists.resize(rangeCount);
+    }
+
+    m_threadPool.ParallelFor(m_sceneObjects.size(), MIN_RECORD_RANGE,
+        [this](size_t range, size_t begin, size_t end)
+        {
+            RenderQueue::DRAW_LIST& list = m_drawLists[range];
+            list.clear();
+            for (size_t i = begin; i < end; i++)
+            {
+                if (!m_sceneObjects[i].bStatic)
+                {
+                    m_renderQueue.Record(list, MakeDrawItem(m_sceneObjects[i]));
+                }
+            }
+        });
+
+    m_renderQueue.SubmitLists(m_drawLists.data(), rangeCount);
+}
+
+/***********************************************************
+ *  BuildStaticBatches()
+ *
+ *  This method merges the geometry of every static scene
+ *  object into world-space batches, one per texture and
+ *  material pair.  Runs once after the scene objects are
+ *  defined.
+ * Time Complexity: O(V) - Where V is the number of vertices of the static objects
+ ***********************************************************/
+void SceneManager::BuildStaticBatches()
+{
+    m_staticBatcher.Clear();
+
+    for (const SCENE_OBJECT& object : m_sceneObjects)
+    {
+        if (!object.bStatic)
+            continue;
+
+        m_staticBatcher.AddObject(
+            m_basicMeshes->GetMeshVertices(object.mesh),
+            m_basicMeshes->GetMeshIndices(object.mesh),
+            object.model,
+            object.uvScale,
+            object.textureLayer,
+            object.materialIndex);
+    }
+
+    m_staticBatcher.Build(&m_pShaderManager->GetResources());
+
+    std::cout << "Static batching: " << m_staticBatcher.GetObjectCount() << " objects merged into "
+        << m_staticBatcher.GetBatchCount() << " batches" << std::endl;
+}
+
+/***********************************************************
+ *  DrawStaticBatches()
+ *
+ *  This method draws every static batch with one draw call.
+ *  The batch vertices are already in world space, so the model
+ *  transform is the identity and the UV scale is one.
+ * Time Complexity: O(B) - Where B is the number of batches
+ ***********************************************************/
+void SceneManager::DrawStaticBatches()
+{
+    if (NULL == m_pShaderManager)
+        return;
+
+    for (size_t i = 0; i < m_staticBatcher.GetBatchCount(); i++)
+    {
+        const StaticBatcher::BATCH& batch = m_staticBatcher.GetBatch(i);
+        bool bTextured = batch.textureLayer >= 0;
+
+        m_pShaderManager->UseVariant(GetPermutationKey(bTextured));
+        m_pShaderManager->setBoolValue(m_uniforms.useTexture, bTextured);
+        if (bTextured)
+            m_pShaderManager->setIntValue(m_uniforms.textureLayer, batch.textureLayer);
+        else
+            m_pShaderManager->setVec4Value(m_uniforms.objectColor, glm::vec4(1.0f));
+
+        m_pShaderManager->setVec2Value(m_uniforms.uvScale, glm::vec2(1.0f, 1.0f));
+        SetShaderMaterialIndex(batch.materialIndex);
+        m_pShaderManager->setMat4Value(m_uniforms.model, glm::mat4(1.0f));
+
+        m_staticBatcher.DrawBatch(i);
+    }
+}
+
+/***********************************************************
+ *  BuildGpuCulling()
+ *
+ *  This method uploads every scene object with its mesh
+ *  range and bounding sphere to the GPU culler.  Objects are
+ *  grouped by shader variant (textured or colored), so each
+ *  group is one indirect draw; the texture layer travels with
+ *  the object.
+ *  Nothing is built when compute shaders or indirect draw
+ *  counts are unavailable.
+ * Time Complexity: O(n) - Where n is the number of scene objects
+ ***********************************************************/
+void SceneManager::BuildGpuCulling()
+{
+    m_gpuCuller.Clear();
+    m_cullGroupTextured.clear();
+
+    if (!m_basicMeshes->IsMultiDrawIndirectCountSupported() ||
+        !m_gpuCuller.Initialize(m_pShaderManager, "shaders/cullShader.glsl"))
+        return;
+
+    for (SCENE_OBJECT& object : m_sceneObjects)
+    {
+        bool bTextured = object.textureLayer >= 0;
+        size_t group = 0;
+        while (group < m_cullGroupTextured.size() && m_cullGroupTextured[group] != bTextured)
+        {
+            group++;
+        }
+        if (group == m_cullGroupTextured.size())
+        {
+            m_cullGroupTextured.push_back(bTextured);
+        }
+
+        const ShapeMeshes::MESH_DESCRIPTOR& descriptor = m_basicMeshes->GetMeshDescriptor(object.mesh);
+
+        GpuCuller::CULL_OBJECT cullObject;
+        cullObject.model = object.model;
+        cullObject.params = glm::vec4(object.uvScale.x, object.uvScale.y,
+            (float)(object.materialIndex < 0 ? 0 : object.materialIndex), (float)(bTextured ? object.textureLayer : 0));
+        cullObject.color = glm::vec4(1.0f);
+        cullObject.bounds = m_basicMeshes->GetMeshBounds(object.mesh);
+        cullObject.draw[0] = (GLuint)descriptor.indexCount;
+        cullObject.draw[1] = descriptor.firstIndex;
+        cullObject.draw[2] = (GLuint)descriptor.baseVertex;
+        cullObject.draw[3] = (GLuint)group;
+        object.cullIndex = m_gpuCuller.AddObject(cullObject);
+    }
+
+    m_gpuCuller.Build();
+
+    std::cout << "GPU culling: " << m_gpuCuller.GetObjectCount() << " objects in "
+        << m_gpuCuller.GetGroupCount() << " draw groups" << std::endl;
+}
+
+/***********************************************************
+ *  UpdateTextureStreaming()
+ *
+ *  This method reports the world-space bounding sphere and UV
+ *  scale of every textured object to the texture streamer and
+ *  binds the texture array again when its storage changed.
+ * Time Complexity: O(n) - Where n is the number of scene objects
+ ***********************************************************/
+void SceneManager::UpdateTextureStreaming()
+{
+    m_textureStreamer.BeginFrame(m_viewProjection, m_viewportHeight);
+
+    for (const SCENE_OBJECT& object : m_sceneObjects)
+    {
+        if (object.textureLayer < 0)
+            continue;
+
+        glm::vec4 bounds = m_basicMeshes->GetMeshBounds(object.mesh);
+        glm::vec3 center = glm::vec3(object.model * glm::vec4(glm::vec3(bounds), 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(object.model[0])),
+            glm::max(glm::length(glm::vec3(object.model[1])), glm::length(glm::vec3(object.model[2]))));
+
+        m_textureStreamer.AddObject(object.textureLayer, center, bounds.w * scale, object.uvScale);
+    }
+
+    // Evictions replace the array too, so the streamer reports them with its own changes
+    m_pShaderManager->GetResources().GetMemoryTracker().EnforceBudget();
+    if (m_textureStreamer.EndFrame())
+    {
+        BindGLTextures();
+    }
 }
 
-// Time Complexity: O(1) - Constant time to apply transformations
-void DrawTexturedMesh(const std::string& texture, const glm::vec3& scale, float xRotation, float yRotation, float zRotation, const glm::vec3& position, const std::string& material = "") {
-    ApplyTransformations(scale, xRotation, yRotation, zRotation, position);
-    SetShaderTexture(texture);
-    SetTextureUVScale(DEFAULT_UV_SCALE, DEFAULT_UV_SCALE);
-    if (!material.empty()) {
-        SetShaderMaterial(material);
+/***********************************************************
+ *  DrawGpuCulled()
+ *
+ *  This method culls every scene object against the view
+ *  frustum in a compute pass and draws the visible ones with
+ *  one glMultiDrawElementsIndirectCount call per shader
+ *  variant.  The
+ *  CPU only refreshes the transforms of dynamic objects; the
+ *  visible draws are never read back.  Returns false (and
+ *  draws nothing) when the GPU path is unavailable so the
+ *  batched path can be used instead.
+ * Time Complexity: O(D + G) - Where D is the number of dynamic objects, G the number of draw groups
+ ***********************************************************/
+bool SceneManager::DrawGpuCulled()
+{
+    if (NULL == m_pShaderManager || !m_gpuCuller.IsReady() || m_gpuCuller.GetObjectCount() == 0 || m_materialBuffer == 0)
+        return false;
+
+    // Every group's variant has to exist before the pass is committed to
+    for (size_t group = 0; group < m_cullGroupTextured.size(); group++)
+    {
+        if (!m_pShaderManager->PrecompileVariant(GetPermutationKey(m_cullGroupTextured[group]) | SHADER_PERMUTATION_INSTANCED))
+            return false;
     }
+
+    for (const SCENE_OBJECT& object : m_sceneObjects)
+    {
+        if (!object.bStatic)
+        {
+            m_gpuCuller.SetObjectModel(object.cullIndex, object.model);
+        }
+    }
+
+    GLuint instanceBuffer = m_basicMeshes->ReserveInstanceBuffer((int)m_gpuCuller.GetObjectCount());
+    if (!m_gpuCuller.Cull(m_viewProjection, instanceBuffer))
+        return false;
+
+    for (size_t group = 0; group < m_gpuCuller.GetGroupCount(); group++)
+    {
+        m_pShaderManager->UseVariant(GetPermutationKey(m_cullGroupTextured[group]) | SHADER_PERMUTATION_INSTANCED);
+
+        m_basicMeshes->MultiDrawIndirectCount(
+            m_gpuCuller.GetCommandBuffer(), m_gpuCuller.GetGroupCommandOffset(group),
+            m_gpuCuller.GetCountBuffer(), m_gpuCuller.GetGroupCountOffset(group),
+            m_gpuCuller.GetGroupCapacity(group));
+    }
+
+    return true;
 }
 
-// Time Complexity O(1) - Constant time for applying transformations and setting textures
-void DrawTexturedMeshWithUVScale(const std::string& texture, const glm::vec3& scale, float xRotation, float yRotation, float zRotation, const glm::vec3& position, float uvScaleX, float uvScaleY, const std::string& material = "") {
-    ApplyTransformations(scale, xRotation, yRotation, zRotation, position);
-    SetShaderTexture(texture);
-    SetTextureUVScale(uvScaleX, uvScaleY);
-    if (!material.empty()) {
-        SetShaderMaterial(material);
+/***********************************************************
+ *  FlushRenderQueue()
+ *
+ *  This method sorts the draws queued for the frame and
+ *  issues them, as indirect multi-draws where supported.
+ *  Otherwise runs of draws that share a program and mesh are
+ *  merged into one instanced draw call, so the number of draw
+ *  calls follows the number of unique program/mesh pairs
+ *  instead of the number of objects.  Textures do not split
+ *  runs, since each instance selects its texture array layer.
+ * Time Complexity: O(n log n) - Where n is the number of queued draws
+ ***********************************************************/
+void SceneManager::FlushRenderQueue()
+{
+    m_renderQueue.Sort();
+
+    if (NULL == m_pShaderManager)
+        return;
+
+    // Records written to the persistent ring cost no uniform uploads,
+    // so even single draws take the instanced path there
+    size_t minInstancedDraw = m_basicMeshes->HasPersistentInstanceData() ? 1 : MIN_INSTANCED_DRAW;
+
+    unsigned int drawCalls = 0;
+    if (DrawQueuedIndirect(drawCalls))
+    {
+        ReportRenderQueueChanges(drawCalls);
+        return;
+    }
+
+    size_t count = m_renderQueue.GetCount();
+    size_t first = 0;
+    while (first < count)
+    {
+        const RenderQueue::DRAW_ITEM& item = m_renderQueue.GetItem(first);
+
+        size_t end = first + 1;
+        while (end < count)
+        {
+            const RenderQueue::DRAW_ITEM& next = m_renderQueue.GetItem(end);
+            if (next.programKey != item.programKey || next.mesh != item.mesh)
+                break;
+            end++;
+        }
+
+        if (end - first >= minInstancedDraw && DrawQueuedInstances(first, end - first))
+        {
+            drawCalls++;
+        }
+        else
+        {
+            for (size_t i = first; i < end; i++)
+            {
+                DrawQueuedItem(m_renderQueue.GetItem(i));
+                drawCalls++;
+            }
+        }
+
+        first = end;
     }
+
+    ReportRenderQueueChanges(drawCalls);
 }
 
-// Function to simplify the rendering of repeated objects (Kiss Cone and Plane)
-// Time Complexity: 0(1) - Single draw call with UV scaling
-void RenderKissObject(const glm::vec3& conePosition, const glm::vec3& planePosition, const std::string& coneTexture, const std::string& planeTexture, const std::string& material) {
-    // Kiss Cone Mesh
-    DrawTexturedMeshWithUVScale(coneTexture, glm::vec3(0.70f, 1.0f, 1.0f), 0.0f, 0.0f, 0.0f, conePosition, PLANE_UV_SCALE, PLANE_UV_SCALE, material);
-    m_basicMeshes->DrawConeMesh(); // Time Complexity: O(1) - Constant time to render cone
+/***********************************************************
+ *  DrawQueuedItem()
+ *
+ *  This method issues one queued draw.  Only state that
+ *  differs from the previous draw reaches GL, since the
+ *  shader manager filters repeated uniform values.
+ * Time Complexity: O(1) - Single draw call
+ ***********************************************************/
+void SceneManager::DrawQueuedItem(const RenderQueue::DRAW_ITEM& item)
+{
+    bool bTextured = item.textureLayer >= 0;
+
+    m_pShaderManager->UseVariant(item.programKey);
+    m_pShaderManager->setBoolValue(m_uniforms.useTexture, bTextured);
+    if (bTextured)
+        m_pShaderManager->setIntValue(m_uniforms.textureLayer, item.textureLayer);
+    else
+        m_pShaderManager->setVec4Value(m_uniforms.objectColor, item.color);
+
+    m_pShaderManager->setVec2Value(m_uniforms.uvScale, item.uvScale);
+    SetShaderMaterialIndex(item.materialIndex);
+    m_pShaderManager->setMat4Value(m_uniforms.model, item.model);
 
-    // Kiss Plane Mesh
-    DrawTexturedMeshWithUVScale(planeTexture, glm::vec3(0.75f, 1.0f, 0.1f), 90.0f, 90.0f, 0.0f, planePosition, 0.1f, 0.1f);
-    m_basicMeshes->DrawPlaneMesh(); // Time Complexity: O(1) - Constant time to render plane
+    m_basicMeshes->DrawMesh((ShapeMeshes::MESH_TYPE)item.mesh);
+}
+
+/***********************************************************
+ *  DrawQueuedInstances()
+ *
+ *  This method issues a run of sorted draws that share a
+ *  program and mesh as one instanced draw.  The model matrix,
+ *  UV scale, material index, texture layer and color of every
+ *  draw travel in the instance buffer.  Instancing needs the
+ *  material uniform buffer and the instanced shader variant;
+ *  without them the run is drawn one item at a time.
+ * Time Complexity: O(k) - Where k is the number of instances
+ ***********************************************************/
+bool SceneManager::DrawQueuedInstances(size_t first, size_t count)
+{
+    const RenderQueue::DRAW_ITEM& item = m_renderQueue.GetItem(first);
+
+    if (m_materialBuffer == 0 || !m_pShaderManager->UseVariant(item.programKey | SHADER_PERMUTATION_INSTANCED))
+        return false;
+
+    m_instanceData.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        m_instanceData[i] = MakeInstanceData(m_renderQueue.GetItem(first + i));
+    }
+    m_basicMeshes->SetInstanceData(m_instanceData.data(), (int)count);
+    m_basicMeshes->DrawMeshInstanced((ShapeMeshes::MESH_TYPE)item.mesh, (int)count);
+    return true;
+}
+
+/***********************************************************
+ *  DrawQueuedIndirect()
+ *
+ *  This method uploads the instance records of every queued
+ *  draw once, in sorted order, and issues the frame with one
+ *  glMultiDrawElementsIndirect call per program.
+ *  Each run of one mesh becomes a command whose baseInstance
+ *  points at its records, so no vertex array is rebound and
+ *  no per-draw uniforms are set.
+ * Time Complexity: O(n) - Where n is the number of queued draws
+ ***********************************************************/
+bool SceneManager::DrawQueuedIndirect(unsigned int& drawCalls)
+{
+    if (m_materialBuffer == 0 || !m_basicMeshes->IsMultiDrawIndirectSupported())
+        return false;
+
+    size_t count = m_renderQueue.GetCount();
+    if (count == 0)
+        return true;
+
+    // Every worker packs the records of its own range of the sorted queue
+    m_instanceData.resize(count);
+    m_threadPool.ParallelFor(count, MIN_RECORD_RANGE,
+        [this](size_t range, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                m_instanceData[i] = MakeInstanceData(m_renderQueue.GetItem(i));
+            }
+        });
+    m_basicMeshes->SetInstanceData(m_instanceData.data(), (int)count);
+
+    size_t first = 0;
+    while (first < count)
+    {
+        const RenderQueue::DRAW_ITEM& item = m_renderQueue.GetItem(first);
+
+        // Collect one command per mesh run while the program stays the same
+        m_drawCommands.clear();
+        size_t end = first;
+        while (end < count)
+        {
+            const RenderQueue::DRAW_ITEM& run = m_renderQueue.GetItem(end);
+            if (run.programKey != item.programKey)
+                break;
+
+            size_t runEnd = end + 1;
+            while (runEnd < count && m_renderQueue.GetItem(runEnd).mesh == run.mesh &&
+                m_renderQueue.GetItem(runEnd).programKey == run.programKey)
+            {
+                runEnd++;
+            }
+
+            m_drawCommands.push_back(m_basicMeshes->MakeDrawCommand(
+                (ShapeMeshes::MESH_TYPE)run.mesh, (int)(runEnd - end), (int)end));
+            end = runEnd;
+        }
+
+        if (m_pShaderManager->UseVariant(item.programKey | SHADER_PERMUTATION_INSTANCED))
+        {
+            m_basicMeshes->MultiDrawIndirect(m_drawCommands.data(), (int)m_drawCommands.size());
+            drawCalls++;
+        }
+        else
+        {
+            for (size_t i = first; i < end; i++)
+            {
+                DrawQueuedItem(m_renderQueue.GetItem(i));
+                drawCalls++;
+            }
+        }
+
+        first = end;
+    }
+
+    return true;
+}
+
+/***********************************************************
+ *  MakeInstanceData()
+ *
+ *  This method packs the per-draw values of a queued draw into
+ *  an instance record.
+ ***********************************************************/
+ShapeMeshes::INSTANCE_DATA SceneManager::MakeInstanceData(const RenderQueue::DRAW_ITEM& item) const
+{
+    ShapeMeshes::INSTANCE_DATA instance;
+    instance.model = item.model;
+    instance.params = glm::vec4(item.uvScale.x, item.uvScale.y,
+        (float)(item.materialIndex < 0 ? 0 : item.materialIndex), (float)(item.textureLayer < 0 ? 0 : item.textureLayer));
+    instance.color = item.color;
+    return instance;
+}
+
+/***********************************************************
+ *  ReportRenderQueueChanges()
+ *
+ *  This method prints the draw calls and the state changes of
+ *  the frame before and after sorting whenever they differ
+ *  from the last report, so a static scene logs once instead
+ *  of per frame.
+ ***********************************************************/
+void SceneManager::ReportRenderQueueChanges(unsigned int drawCalls)
+{
+    const RenderQueue::STATE_CHANGES& submitted = m_renderQueue.GetSubmittedChanges();
+    const RenderQueue::STATE_CHANGES& sorted = m_renderQueue.GetSortedChanges();
+
+    if (sorted.draws == m_reportedChanges.draws && sorted.Total() == m_reportedChanges.Total() && drawCalls == m_reportedDrawCalls)
+        return;
+    m_reportedChanges = sorted;
+    m_reportedDrawCalls = drawCalls;
+
+    std::cout << "Render queue: " << sorted.draws << " objects in " << drawCalls << " draw calls, state changes "
+        << submitted.Total() << " submitted -> " << sorted.Total() << " sorted"
+        << " (program " << submitted.programChanges << "->" << sorted.programChanges
+        << ", texture " << submitted.textureChanges << "->" << sorted.textureChanges
+        << ", material " << submitted.materialChanges << "->" << sorted.materialChanges
+        << ", mesh " << submitted.meshChanges << "->" << sorted.meshChanges << ")" << std::endl;
+}
+
+/***********************************************************
+ *  ReportStateCacheStats()
+ *
+ *  This method prints how many GL state calls of the frame
+ *  reached the driver and how many the cache dropped as
+ *  redundant whenever the counts differ from the last report,
+ *  then starts counting the next frame.
+ ***********************************************************/
+void SceneManager::ReportStateCacheStats()
+{
+    GLStateCache& stateCache = m_pShaderManager->GetStateCache();
+    const GLStateCache::STATE_STATS& stats = stateCache.GetStats();
+
+    if (stats.issued != m_reportedStateStats.issued || stats.filtered != m_reportedStateStats.filtered)
+    {
+        m_reportedStateStats = stats;
+        std::cout << "GL state cache: " << stats.issued << " calls issued, "
+            << stats.filtered << " filtered as redundant" << std::endl;
+    }
+
+    stateCache.ResetStats();
+}
+
+/***********************************************************
+ *  SetViewPosition()
+ *
+ *  This method sets the viewer position used to sort the
+ *  queued draws front to back.
+ ***********************************************************/
+void SceneManager::SetViewPosition(const glm::vec3& viewPosition)
+{
+    m_renderQueue.SetViewPosition(viewPosition);
+}
+
+/***********************************************************
+ *  SetViewProjection()
+ *
+ *  This method sets the view-projection matrix that objects
+ *  are culled against.
+ ***********************************************************/
+void SceneManager::SetViewProjection(const glm::mat4& viewProjection)
+{
+    m_viewProjection = viewProjection;
+}
+
+/***********************************************************
+ *  SetViewportHeight()
+ *
+ *  This method sets the height of the viewport in pixels,
+ *  which the texture streamer measures the objects against.
+ ***********************************************************/
+void SceneManager::SetViewportHeight(int height)
+{
+    m_viewportHeight = height;
 }
 
 /***********************************************************
  *  LoadSceneTextures()
  *
- *  This method loads the textures used in the 3D scene.
+ *  This method loads the textures of the loaded scene and
+ *  records the array layer of each scene texture id.
  * Time Complexity: O(n) - Linear time where n is the number of textures to load
  ***********************************************************/
 void SceneManager::LoadSceneTextures() {
-    std::vector<std::pair<std::string, std::string>> textures = {
-        {"textures/silver.jpg", "silver"},
-        {"textures/tinfoil.jpg", "tinfoil"},
-        {"textures/pinkkiss.jpg", "pinkkiss"},
-        {"textures/Winnie.jpg", "Winnie"},
-        {"textures/floor.jpg", "floor"},
-        {"textures/green.jpg", "green"},
-        {"textures/lemonlime.jpg", "lemonlime"},
-        {"textures/kisstag.jpg", "kisstag"},
-        {"textures/wick.jpg", "wick"},
-        {"textures/tea.jpg", "tea"},
-        {"textures/wax.jpg", "wax"}
-    };
+    const SceneFile::SCENE_TEXTURE* textures = m_sceneFile.GetTextures();
+    size_t textureCount = m_sceneFile.GetTextureCount();
+    m_sceneTextureLayers.assign(textureCount, -1);
+    if (textureCount == 0)
+        return;
+
+    // The scene textures are opaque JPEGs, so BC1 (8:1 against RGBA8) loses no channel
+    GLenum layerFormat = GLEW_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+
+    // One array layer per texture, all resampled to the same size
+    if (!m_textureArray.Create(&m_pShaderManager->GetResources(), "scene textures", TEXTURE_LAYER_SIZE, TEXTURE_LAYER_SIZE,
+        (GLsizei)textureCount, layerFormat, TEXTURE_INITIAL_RESIDENT_LEVEL)) {
+        std::cerr << "ERROR::TEXTURE::ARRAY_CREATION_FAILED" << std::endl;
+        return;
+    }
 
-    // Time Complexity: O(n) - Iterating through all textures
-    for (const auto& texture : textures) {
-        CreateGLTexture(texture.first, texture.second); // Time Complexity: O(1) - Creating texture in constant time
+    // Time Complexity: O(n) - Iterating through all textures; decoding runs on the thread pool
+    for (size_t i = 0; i < textureCount; i++) {
+        std::string tag = m_sceneFile.GetString(textures[i].tagOffset, textures[i].tagLength);
+        std::string path = m_sceneFile.GetString(textures[i].pathOffset, textures[i].pathLength);
+        if (CreateGLTexture(path.c_str(), tag)) { // Time Complexity: O(1) - Queuing the texture in constant time
+            m_sceneTextureLayers[i] = m_textures.back().layer;
+        }
     }
 
-    BindGLTextures(); // Time Complexity: O(1) - Binding all textures in constant time
+    BindGLTextures(); // Time Complexity: O(1) - Binding the texture array once
+}
+
+/***********************************************************
+ *  SetAssetPack()
+ *
+ *  This method sets the archive scenes are read from and
+ *  hands it to the texture loader, which then reads the
+ *  scene's images out of its mapping.
+ ***********************************************************/
+void SceneManager::SetAssetPack(const AssetPack* pAssetPack)
+{
+    m_pAssetPack = pAssetPack;
+    m_textureLoader.SetAssetPack(pAssetPack);
+}
+
+/***********************************************************
+ *  LoadScene()
+ *
+ *  This method maps the compiled form of a text scene.  When
+ *  the text is on disk, the compiled file next to it is used,
+ *  compiled first when the text is newer or it does not exist
+ *  yet, so edited scenes show up on the next run; a copy in
+ *  the asset pack may be older and is skipped.  Without the
+ *  text, as when only compiled scenes ship, the compiled file
+ *  is read from the asset pack or from disk as is.
+ ***********************************************************/
+bool SceneManager::LoadScene(const std::string& sourcePath)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::string compiledPath = SceneFile::GetCompiledPath(sourcePath);
+    const AssetPack* pAssetPack = m_pAssetPack;
+    if (SceneFile::HasSource(sourcePath))
+    {
+        if (SceneFile::IsOutOfDate(sourcePath, compiledPath) && !SceneFile::Compile(sourcePath, compiledPath))
+            return false;
+        pAssetPack = NULL;
+    }
+
+    if (!m_sceneFile.Open(compiledPath, pAssetPack))
+        return false;
+
+    std::cout << "Scene: " << compiledPath << ", " << m_sceneFile.GetObjectCount() << " objects loaded in "
+        << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    return true;
 }
 
 /***********************************************************
  *  PrepareScene()
  *
- *  This method prepares the 3D scene by loading textures,
- *  shapes, materials, and setting up lighting.
+ *  This method prepares the loaded scene by loading its
+ *  textures, materials, objects and their shapes, and setting
+ *  up its lighting.
+ *
+ *  A progressive scene returns as soon as the objects are
+ *  defined: round meshes start with few segments and every
+ *  texture layer shows a grey 1x1 placeholder, and the real
+ *  assets stream in while frames are rendered.  Otherwise
+ *  every texture is uploaded before returning.
  * 
- * Time Complexity: O(n) - Linear time where n is the number of meshes loaded
+ * Time Complexity: O(n) - Linear time where n is the number of objects
  ***********************************************************/
-void SceneManager::PrepareScene() {
+void SceneManager::PrepareScene(bool bProgressive) {
     LoadSceneTextures(); // Loading textures
-    DefineObjectMaterials(); // Constatnt time for defining material
-    SetupSceneLights(); // Constant time for setting up lights
+    DefineObjectMaterials(); // Linear time in the number of materials
+    SetupSceneLights(); // Linear time in the number of lights
 
-    // Load meshes in memory
-    m_basicMeshes->LoadPlaneMesh(); // Time Complexity: O(1) - Loading Individual mesh for each shape
-    m_basicMeshes->LoadCylinderMesh();
-    m_basicMeshes->LoadConeMesh();
-    m_basicMeshes->LoadBoxMesh();
-    m_basicMeshes->LoadTorusMesh();
-    m_basicMeshes->LoadTaperedCylinderMesh();
+    // Objects are copied out of the scene's flat arrays
+    DefineSceneObjects();
+
+    // Load the meshes the objects use in memory
+    m_basicMeshes->SetDetail(bProgressive ? ShapeMeshes::DETAIL_PLACEHOLDER : ShapeMeshes::DETAIL_FULL);
+    LoadBasicMeshes();
+
+    // Static objects are transformed and merged once instead of per frame;
+    // all objects are also handed to the GPU culler where it is supported
+    BuildStaticBatches();
+    BuildGpuCulling();
+    m_bFrameRendered = false;
+
+    if (!bProgressive)
+    {
+        while (m_textureLoader.Update(TEXTURE_UPLOAD_BUDGET_MS))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/***********************************************************
+ *  LoadBasicMeshes()
+ *
+ *  This method generates every basic shape mesh the scene
+ *  objects use at the current detail of the meshes.
+ * 
+ * Time Complexity: O(n) - Linear in the number of scene objects, plus one mesh per shape used
+ ***********************************************************/
+void SceneManager::LoadBasicMeshes()
+{
+    bool bUsed[ShapeMeshes::MESH_COUNT] = {};
+    for (const SCENE_OBJECT& object : m_sceneObjects)
+    {
+        bUsed[object.mesh] = true;
+    }
+
+    if (bUsed[ShapeMeshes::MESH_PLANE])
+        m_basicMeshes->LoadPlaneMesh();
+    if (bUsed[ShapeMeshes::MESH_CYLINDER])
+        m_basicMeshes->LoadCylinderMesh();
+    if (bUsed[ShapeMeshes::MESH_CONE])
+        m_basicMeshes->LoadConeMesh();
+    if (bUsed[ShapeMeshes::MESH_BOX])
+        m_basicMeshes->LoadBoxMesh();
+    if (bUsed[ShapeMeshes::MESH_TORUS])
+        m_basicMeshes->LoadTorusMesh();
+    if (bUsed[ShapeMeshes::MESH_TAPERED_CYLINDER])
+        m_basicMeshes->LoadTaperedCylinderMesh();
+    if (bUsed[ShapeMeshes::MESH_SPHERE])
+        m_basicMeshes->LoadSphereMesh();
+}
+
+/***********************************************************
+ *  LoadFullDetailMeshes()
+ *
+ *  This method regenerates the meshes at full detail and
+ *  rebuilds what holds copies or locations of their geometry:
+ *  the static batches and the GPU culling objects.
+ ***********************************************************/
+void SceneManager::LoadFullDetailMeshes()
+{
+    m_basicMeshes->SetDetail(ShapeMeshes::DETAIL_FULL);
+    LoadBasicMeshes();
+    BuildStaticBatches();
+    BuildGpuCulling();
+}
+
+/***********************************************************
+ *  IsFullyLoaded()
+ *
+ *  This method checks whether the meshes have their full
+ *  detail and every texture has its resident levels.
+ ***********************************************************/
+bool SceneManager::IsFullyLoaded() const
+{
+    return m_basicMeshes->GetDetail() == ShapeMeshes::DETAIL_FULL && m_textureLoader.GetPendingCount() == 0;
 }
 
 /***********************************************************
  *  RenderScene()
  *
- *  This method is used for rendering the 3D scene by
- *  transforming and drawing the basic 3D shapes.
+ *  This method is used for rendering the 3D scene.  Where
+ *  compute shaders are available every object is frustum
+ *  culled and drawn by GPU-written indirect commands;
+ *  otherwise the static batches are drawn and the dynamic
+ *  objects are queued and issued sorted by shader state.
  * 
- * Time Complexity: O(T + P), Where T is the number of objects, P is the number of pixels rendered
+ * Time Complexity: O(B + D + P), Where B is the number of static batches, D is the number of dynamic objects, P is the number of pixels rendered
  ***********************************************************/
 void SceneManager::RenderScene() {
-    // Floor Mesh
-    DrawTexturedMeshWithUVScale("floor", FLOOR_SCALE, 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 0.0f, 0.0f), PLANE_UV_SCALE, PLANE_UV_SCALE, "wood");
-    m_basicMeshes->DrawPlaneMesh();
+    // The placeholder meshes of a progressive startup are replaced once a frame is on screen
+    if (m_bFrameRendered && m_basicMeshes->GetDetail() == ShapeMeshes::DETAIL_PLACEHOLDER)
+    {
+        LoadFullDetailMeshes();
+    }
 
-    // Background Mesh
-    DrawTexturedMesh("green", BACKGROUND_SCALE, 90.0f, 0.0f, 0.0f, glm::vec3(0.0f, 10.0f, -7.0f));
-    m_basicMeshes->DrawPlaneMesh();
+    // Only the mip levels the objects show at their current size stay resident,
+    // and the textures of visible objects near the viewer load first
+    UpdateTextureStreaming();
 
-    // Tea Mug Mesh
-    DrawTexturedMesh("Winnie", TEA_MUG_SCALE, 0.0f, 50.0f, 0.0f, glm::vec3(7.0f, 0.01f, 1.0f), "glass");
-    m_basicMeshes->DrawCylinderMesh();
+    // Decoded textures arrive a few mip levels per frame
+    m_textureLoader.Update(TEXTURE_UPLOAD_BUDGET_MS);
 
-    // Tea Liquid Mesh
-    DrawTexturedMesh("tea", TEA_LIQUID_SCALE, 0.0f, 50.0f, 0.0f, glm::vec3(7.0f, 0.01f, 1.0f), "glass");
-    m_basicMeshes->DrawCylinderMesh();
+    m_basicMeshes->BeginFrame();
 
-    // Mug Handle Mesh
-    DrawTexturedMesh("silver", HANDLE_SCALE, 0.0f, 0.0f, 0.0f, glm::vec3(8.0f, 3.8f, 2.0f), "glass");
-    m_basicMeshes->DrawTorusMesh();
+    // Culled and drawn entirely on the GPU when supported
+    if (!DrawGpuCulled()) {
+        m_renderQueue.Clear();
 
-    // Laptop Screen Box Mesh
-    DrawTexturedMesh("silver", glm::vec3(6.5f, 0.5f, 14.5f), 0.0f, 45.0f, 0.0f, glm::vec3(-9.0f, 0.3f, 2.6f));
-    m_basicMeshes->DrawBoxMesh();
+        // Dynamic objects are recorded every frame; static ones are already batched
+        RecordDynamicObjects();
 
-    // Render Kiss #1 (Cone and Plane)
-    RenderKissObject(glm::vec3(3.0f, 0.01f, 4.0f), glm::vec3(3.0f, 0.9f, 4.0f), "tinfoil", "kisstag", "sunkiss");
+        DrawStaticBatches();
+        FlushRenderQueue();
+    }
+
+    m_basicMeshes->EndFrame();
+    m_pShaderManager->GetResources().EndFrame();
+    m_bFrameRendered = true;
 
-    // Render Kiss #2 (Cone and Plane)
-    RenderKissObject(glm::vec3(3.0f, 0.01f, 2.0f), glm::vec3(3.0f, 0.9f, 2.0f), "pinkkiss", "kisstag", "sunkiss");
+    ReportStateCacheStats();
+}
 
-    // Render Kiss #3 (Cone and Plane)
-    RenderKissObject(glm::vec3(9.0f, 0.01f, 3.5f), glm::vec3(9.0f, 0.9f, 3.5f), "pinkkiss", "kisstag", "sunkiss");
+/***********************************************************
+ *  DefineSceneObjects()
+ *
+ *  This method defines the objects of the 3D scene from the
+ *  flat arrays of the loaded scene: their meshes, textures,
+ *  materials and baked model transforms.  Scene material ids
+ *  are material buffer indices, since the materials are
+ *  defined in scene order.
+ * 
+ * Time Complexity: O(T) - Where T is the number of objects
+ ***********************************************************/
+void SceneManager::DefineSceneObjects() {
+    size_t objectCount = m_sceneFile.GetObjectCount();
+    const glm::mat4* transforms = m_sceneFile.GetTransforms();
+    const glm::vec2* uvScales = m_sceneFile.GetUVScales();
+    const unsigned char* meshIds = m_sceneFile.GetMeshIds();
+    const int* textureIds = m_sceneFile.GetTextureIds();
+    const int* materialIds = m_sceneFile.GetMaterialIds();
+    const unsigned char* objectFlags = m_sceneFile.GetObjectFlags();
 
-    // Candle Cylinder Exterior Mesh
-    DrawTexturedMesh("wax", glm::vec3(2.0f, 3.5f, 2.0f), 0.0f, 0.0f, 0.0f, glm::vec3(-3.0f, 0.01f, 4.0f), "glass");
-    m_basicMeshes->DrawCylinderMesh();
+    m_sceneObjects.resize(objectCount);
+    for (size_t i = 0; i < objectCount; i++) {
+        SCENE_OBJECT& object = m_sceneObjects[i];
+        object.mesh = (ShapeMeshes::MESH_TYPE)meshIds[i];
+        object.textureLayer = (textureIds[i] >= 0) ? m_sceneTextureLayers[textureIds[i]] : -1;
+        object.materialIndex = materialIds[i];
+        object.model = transforms[i];
+        object.uvScale = uvScales[i];
+        object.bStatic = (objectFlags[i] & SceneFile::OBJECT_DYNAMIC) == 0;
+        object.cullIndex = 0;
+    }
+}
 
-    // Candle Cylinder Interior Mesh
-    DrawTexturedMesh("lemonlime", glm::vec3(1.9f, 3.51f, 1.9f), 0.0f, 0.0f, 0.0f, glm::vec3(-3.0f, 0.01f, 4.0f), "glass");
-    m_basicMeshes->DrawCylinderMesh();
+/***********************************************************
+ *  DefineObjectMaterials()
+ *
+ *  This method configures the material settings for all of
+ *  the objects within the 3D scene from the loaded scene.
+ * Time Complexity: O(M) - Linear in the number of materials
+ ***********************************************************/
+void SceneManager::DefineObjectMaterials()
+{
+    const SceneFile::SCENE_MATERIAL* materials = m_sceneFile.GetMaterials();
+
+    m_objectMaterials.clear();
+    for (size_t i = 0; i < m_sceneFile.GetMaterialCount(); i++)
+    {
+        OBJECT_MATERIAL material;
+        material.ambientColor = materials[i].ambientColor;
+        material.ambientStrength = materials[i].ambientStrength;
+        material.diffuseColor = materials[i].diffuseColor;
+        material.specularColor = materials[i].specularColor;
+        material.shininess = materials[i].shininess;
+        material.tag = m_sceneFile.GetString(materials[i].tagOffset, materials[i].tagLength);
+        m_objectMaterials.push_back(material);
+    }
+
+    UploadObjectMaterials();
+}
+
+/***********************************************************
+ *  UploadObjectMaterials()
+ *
+ *  This method packs every defined material into the std140
+ *  MaterialBlock uniform buffer, so a draw only needs to pass
+ *  the index of its material.
+ * Time Complexity: O(M) - Linear in the number of materials
+ ***********************************************************/
+void SceneManager::UploadObjectMaterials()
+{
+    if (NULL == m_pShaderManager)
+        return;
+
+    if (m_materialBuffer == 0)
+    {
+        m_materialBuffer = m_pShaderManager->CreateUniformBuffer(
+            g_MaterialBlockName, MATERIAL_BLOCK_BINDING, sizeof(GPU_MATERIAL) * MAX_MATERIALS);
+    }
+    if (m_materialBuffer == 0)
+        return;
+
+    if ((int)m_objectMaterials.size() > MAX_MATERIALS)
+    {
+        std::cout << "Only the first " << MAX_MATERIALS << " materials fit in the material buffer" << std::endl;
+    }
+
+    std::vector<GPU_MATERIAL> materials;
+    for (int i = 0; i < (int)m_objectMaterials.size() && i < MAX_MATERIALS; i++)
+    {
+        const OBJECT_MATERIAL& material = m_objectMaterials[i];
+        GPU_MATERIAL gpuMaterial;
+        gpuMaterial.ambientColor = glm::vec4(material.ambientColor, material.ambientStrength);
+        gpuMaterial.diffuseColor = glm::vec4(material.diffuseColor, 0.0f);
+        gpuMaterial.specularColor = glm::vec4(material.specularColor, material.shininess);
+        materials.push_back(gpuMaterial);
+    }
+
+    if (!materials.empty())
+    {
+        m_pShaderManager->UpdateUniformBuffer(m_materialBuffer, materials.data(), sizeof(GPU_MATERIAL) * materials.size());
+    }
+}
+
+/***********************************************************
+ *  SetupSceneLights()
+ *
+ *  This method adds and configures the light sources of the
+ *  loaded scene.  There are up to MAX_LIGHTS light sources.
+ * Time Complexity: O(L) - Linear in the number of lights
+ ***********************************************************/
+void SceneManager::SetupSceneLights()
+{
+    const SceneFile::SCENE_LIGHT* lights = m_sceneFile.GetLights();
+
+    m_lights.clear();
+    for (size_t i = 0; i < m_sceneFile.GetLightCount(); i++)
+    {
+        LIGHT_SOURCE light;
+        light.position = lights[i].position;
+        light.ambientColor = lights[i].ambientColor;
+        light.diffuseColor = lights[i].diffuseColor;
+        light.specularColor = lights[i].specularColor;
+        light.focalStrength = lights[i].focalStrength;
+        light.specularIntensity = lights[i].specularIntensity;
+        m_lights.push_back(light);
+    }
+
+    if (NULL == m_pShaderManager)
+        return;
+
+    // Tell the shaders to render the 3D scene with custom lighting
+    m_bUseLighting = true;
+    m_pShaderManager->setBoolValue(m_uniforms.useLighting, true);
+
+    UploadSceneLights();
+}
+
+/***********************************************************
+ *  OnShaderProgramChanged()
+ *
+ *  This method re-applies the shader state that belongs to a
+ *  program, e.g. when the real program replaces the fallback
+ *  used during asynchronous shader compilation, and builds the
+ *  shader variants used by the scene.
+ ***********************************************************/
+void SceneManager::OnShaderProgramChanged()
+{
+    UploadObjectMaterials();
+    SetupSceneLights();
+
+    // Build the variants the scene draws with before the first frame uses them
+    if (NULL != m_pShaderManager)
+    {
+        m_pShaderManager->PrecompileVariant(GetPermutationKey(true));
+        m_pShaderManager->PrecompileVariant(GetPermutationKey(false));
+        m_pShaderManager->PrecompileVariant(GetPermutationKey(true) | SHADER_PERMUTATION_INSTANCED);
+    }
+}
+
+/***********************************************************
+ *  UploadSceneLights()
+ *
+ *  This method uploads all light sources in one update of the
+ *  std140 LightBlock uniform buffer.  The shader reads lights
+ *  only from the block, so without it there is nothing to set.
+ * Time Complexity: O(L) - Linear in the number of lights
+ ***********************************************************/
+void SceneManager::UploadSceneLights()
+{
+    if (NULL == m_pShaderManager)
+        return;
+
+    int lightCount = (int)m_lights.size();
+    if (lightCount > MAX_LIGHTS)
+    {
+        std::cout << "Only the first " << MAX_LIGHTS << " lights fit in the light buffer" << std::endl;
+        lightCount = MAX_LIGHTS;
+    }
+
+    if (m_lightBuffer == 0)
+    {
+        m_lightBuffer = m_pShaderManager->CreateUniformBuffer(
+            g_LightBlockName, LIGHT_BLOCK_BINDING, sizeof(GPU_LIGHT_BLOCK));
+        if (m_lightBuffer == 0)
+            return;
+    }
+
+    GPU_LIGHT_BLOCK lightBlock = {};
+    lightBlock.lightCount[0] = lightCount;
+    for (int i = 0; i < lightCount; i++)
+    {
+        lightBlock.lights[i].position = glm::vec4(m_lights[i].position, 1.0f);
+        lightBlock.lights[i].ambientColor = glm::vec4(m_lights[i].ambientColor, 0.0f);
+        lightBlock.lights[i].diffuseColor = glm::vec4(m_lights[i].diffuseColor, 0.0f);
+        lightBlock.lights[i].specularColor = glm::vec4(m_lights[i].specularColor, 0.0f);
+        lightBlock.lights[i].params = glm::vec4(m_lights[i].focalStrength, m_lights[i].specularIntensity, 0.0f, 0.0f);
+    }
 
-    // Candlewick Mesh
-    DrawTexturedMesh("wick", glm::vec3(0.1f, 0.50f, 0.1f), 0.0f, 0.0f, 0.0f, glm::vec3(-3.0f, 4.0f, 4.0f));
-    m_basicMeshes->DrawCylinderMesh();
+    // Only the header and the active lights need to be sent
+    GLsizeiptr uploadSize = sizeof(lightBlock.lightCount) + sizeof(GPU_LIGHT) * lightCount;
+    m_pShaderManager->UpdateUniformBuffer(m_lightBuffer, &lightBlock, uploadSize);
 }
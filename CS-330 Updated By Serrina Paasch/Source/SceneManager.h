@@ -10,6 +10,14 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "RenderQueue.h"
+#include "StaticBatcher.h"
+#include "GpuCuller.h"
+#include "TextureArray.h"
+#include "TextureLoader.h"
+#include "TextureStreamer.h"
+#include "SceneFile.h"
+#include "ThreadPool.h"
 
 #include <string>
 #include <vector>
@@ -34,7 +42,7 @@ public:
     struct TEXTURE_INFO
     {
         std::string tag;
-        uint32_t ID;
+        int layer;                       // Layer in the scene texture array
     };
 
     // Structure to hold material properties for objects
@@ -48,71 +56,220 @@ public:
         std::string tag;
     };
 
+    // Structure to hold the properties of a light source
+    struct LIGHT_SOURCE
+    {
+        glm::vec3 position;
+        glm::vec3 ambientColor;
+        glm::vec3 diffuseColor;
+        glm::vec3 specularColor;
+        float focalStrength;
+        float specularIntensity;
+    };
+
+    // Capacity of the light and material uniform buffers
+    // (must match MAX_LIGHTS / MAX_MATERIALS in fragmentShader.glsl)
+    static const int MAX_LIGHTS = 16;
+    static const int MAX_MATERIALS = 256;
+
 private:
+    // std140 layout of one light in the LightBlock uniform buffer
+    struct GPU_LIGHT
+    {
+        glm::vec4 position;
+        glm::vec4 ambientColor;
+        glm::vec4 diffuseColor;
+        glm::vec4 specularColor;
+        glm::vec4 params;            // x: focal strength, y: specular intensity
+    };
+
+    // std140 layout of the LightBlock uniform buffer
+    struct GPU_LIGHT_BLOCK
+    {
+        int lightCount[4];           // ivec4, x: number of active lights
+        GPU_LIGHT lights[MAX_LIGHTS];
+    };
+
+    // std140 layout of one material in the MaterialBlock uniform buffer
+    struct GPU_MATERIAL
+    {
+        glm::vec4 ambientColor;      // a: ambient strength
+        glm::vec4 diffuseColor;
+        glm::vec4 specularColor;     // a: shininess
+    };
+
+    // Structure to hold one object of the scene
+    struct SCENE_OBJECT
+    {
+        ShapeMeshes::MESH_TYPE mesh;     // Mesh type to draw
+        int textureLayer;                // Texture array layer, -1 = solid color
+        int materialIndex;               // Material buffer index, -1 = none
+        glm::mat4 model;                 // Model transform
+        glm::vec2 uvScale;               // Texture coordinate scale
+        bool bStatic;                    // Never moves (merged into a static batch)
+        unsigned int cullIndex;          // Object index in the GPU culler
+    };
+
+    // Structure to hold the pre-resolved uniform handles used per draw
+    struct SHADER_UNIFORMS
+    {
+        UniformHandle<glm::mat4> model;
+        UniformHandle<glm::vec4> objectColor;
+        UniformHandle<int> textureLayer;
+        UniformHandle<bool> useTexture;
+        UniformHandle<bool> useLighting;
+        UniformHandle<glm::vec2> uvScale;
+        UniformHandle<glm::vec3> materialAmbientColor;
+        UniformHandle<float> materialAmbientStrength;
+        UniformHandle<glm::vec3> materialDiffuseColor;
+        UniformHandle<glm::vec3> materialSpecularColor;
+        UniformHandle<float> materialShininess;
+        UniformHandle<int> materialIndex;
+    };
+
     ShaderManager* m_pShaderManager;     // Pointer to shader manager object
     ShapeMeshes* m_basicMeshes;          // Pointer to basic shapes object
-    int m_loadedTextures;                // Total number of loaded textures
-    TEXTURE_INFO m_textureIDs[16];       // Array to hold loaded texture info
+    std::vector<TEXTURE_INFO> m_textures; // Loaded textures, indexed by layer
+    SceneFile m_sceneFile;               // Compiled scene the objects, materials and lights come from
+    const AssetPack* m_pAssetPack;       // Archive read before the asset files (optional)
+    std::vector<int> m_sceneTextureLayers; // Texture array layer per scene texture id (-1 = not loaded)
+    TextureArray m_textureArray;         // Images of all loaded textures, one per layer
     std::vector<OBJECT_MATERIAL> m_objectMaterials; // List of defined object materials
+    SHADER_UNIFORMS m_uniforms;          // Uniform handles resolved once at construction
+    std::vector<LIGHT_SOURCE> m_lights;  // Light sources of the scene
+    GLuint m_lightBuffer;                // LightBlock uniform buffer (0 = not created)
+    GLuint m_materialBuffer;             // MaterialBlock uniform buffer (0 = plain uniforms)
+    bool m_bUseLighting;                 // Render the scene with custom lighting
+    RenderQueue m_renderQueue;           // Draws of the current frame
+    RenderQueue::STATE_CHANGES m_reportedChanges; // State changes last reported
+    unsigned int m_reportedDrawCalls;    // Draw calls last reported
+    GLStateCache::STATE_STATS m_reportedStateStats; // GL state cache counters last reported
+    std::vector<ShapeMeshes::INSTANCE_DATA> m_instanceData; // Instances of the current instanced draws
+    std::vector<ShapeMeshes::DRAW_COMMAND> m_drawCommands;  // Commands of the current indirect draw
+    std::vector<SCENE_OBJECT> m_sceneObjects;  // Objects of the scene
+    StaticBatcher m_staticBatcher;       // Merged geometry of the static objects
+    GpuCuller m_gpuCuller;               // Frustum culling and draw commands on the GPU
+    std::vector<bool> m_cullGroupTextured; // Whether each GPU culling draw group is textured
+    glm::mat4 m_viewProjection;          // View-projection matrix of the frame
+    ThreadPool m_threadPool;             // Workers that record draws and decode textures
+    TextureLoader m_textureLoader;       // Streams decoded textures into m_textureArray
+    TextureStreamer m_textureStreamer;   // Keeps the mip levels visible objects need resident
+    int m_viewportHeight;                // Height of the viewport in pixels
+    bool m_bFrameRendered;               // A frame has been rendered since PrepareScene()
+    std::vector<RenderQueue::DRAW_LIST> m_drawLists;  // Draws recorded per worker range
 
-    // Load texture images and convert them to OpenGL texture data
+    // Get the shader permutation key for a textured or colored draw
+    unsigned int GetPermutationKey(bool bTextured) const;
+
+    // Upload all light sources to the shader (once per change)
+    void UploadSceneLights();
+
+    // Upload all defined materials to the shader (once per change)
+    void UploadObjectMaterials();
+
+    // Resolve the uniform handles used by the scene
+    void ResolveUniformHandles();
+
+    // Queue a texture image for the next layer of the texture array
     bool CreateGLTexture(const char* filename, std::string tag);
 
-    // Bind loaded OpenGL textures to memory slots
+    // Bind the texture array holding the loaded textures
     void BindGLTextures();
 
     // Free the loaded OpenGL textures
     void DestroyGLTextures();
 
-    // Find a loaded texture by tag
-    int FindTextureID(std::string tag);
+    // Set the material with the given buffer index into the shader
+    void SetShaderMaterialIndex(int materialIndex);
+
+    // Sort and issue the queued draws of the frame
+    void FlushRenderQueue();
+
+    // Issue one queued draw with its own draw call
+    void DrawQueuedItem(const RenderQueue::DRAW_ITEM& item);
+
+    // Issue a run of queued draws sharing program and mesh as one
+    // instanced draw call (false if instancing is unavailable)
+    bool DrawQueuedInstances(size_t first, size_t count);
+
+    // Issue the whole queue as one indirect draw per program
+    // (false if indirect drawing is unavailable)
+    bool DrawQueuedIndirect(unsigned int& drawCalls);
+
+    // Build the per-instance record of a queued draw
+    ShapeMeshes::INSTANCE_DATA MakeInstanceData(const RenderQueue::DRAW_ITEM& item) const;
+
+    // Print the state changes of the frame when they differ from the last report
+    void ReportRenderQueueChanges(unsigned int drawCalls);
+
+    // Print the issued / filtered GL state calls of the frame when they differ from the last report
+    void ReportStateCacheStats();
 
-    // Find the slot for a loaded texture by tag
-    int FindTextureSlot(std::string tag);
+    // Build the draw item of a scene object (safe on worker threads)
+    RenderQueue::DRAW_ITEM MakeDrawItem(const SCENE_OBJECT& object) const;
 
-    // Find a defined material by tag
-    bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+    // Record the dynamic scene objects in parallel and queue them
+    void RecordDynamicObjects();
 
-    // Set transformation values into the transformation buffer
-    void SetTransformations(
-        glm::vec3 scaleXYZ,
-        float XrotationDegrees,
-        float YrotationDegrees,
-        float ZrotationDegrees,
-        glm::vec3 positionXYZ);
+    // Merge the static scene objects into batches
+    void BuildStaticBatches();
 
-    // Set the color values in the shader
-    void SetShaderColor(
-        float redColorValue,
-        float greenColorValue,
-        float blueColorValue,
-        float alphaValue);
+    // Draw every static batch with one draw call
+    void DrawStaticBatches();
 
-    // Set the texture data into the shader
-    void SetShaderTexture(
-        std::string textureTag);
+    // Upload every scene object to the GPU culler
+    void BuildGpuCulling();
 
-    // Set the UV scale for texture mapping
-    void SetTextureUVScale(
-        float u, float v);
+    // Cull and draw every scene object on the GPU (false if unavailable)
+    bool DrawGpuCulled();
 
-    // Set the object material data into the shader
-    void SetShaderMaterial(
-        std::string materialTag);
+    // Report the screen size of every textured object to the texture streamer
+    void UpdateTextureStreaming();
+
+    // Generate the shape meshes the scene objects use at the current detail
+    void LoadBasicMeshes();
+
+    // Replace the placeholder meshes of a progressive startup with the full ones
+    void LoadFullDetailMeshes();
 
 public:
-    // Prepare the scene: Create objects, textures, and materials
-    void PrepareScene();
+    // Read textures, and scenes shipped without their text, from an asset pack before their own files (call before LoadScene())
+    void SetAssetPack(const AssetPack* pAssetPack);
+
+    // Map a compiled scene, compiling its text form first when that is newer (call before PrepareScene())
+    bool LoadScene(const std::string& sourcePath);
+
+    // Prepare the scene: Create objects, textures, and materials; a progressive
+    // scene renders at once with placeholders while the assets stream in
+    void PrepareScene(bool bProgressive = true);
+
+    // Check whether every texture and mesh has its final detail
+    bool IsFullyLoaded() const;
 
     // Render the scene: Draw objects using shaders and materials
     void RenderScene();
 
+    // Define the objects of the scene from the loaded scene
+    void DefineSceneObjects();
+
     // Load all required textures for the scene
     void LoadSceneTextures();
 
-    // Define all object materials for the scene
+    // Define all object materials of the loaded scene
     void DefineObjectMaterials();
 
     // Set up and define light sources for the scene
     void SetupSceneLights();
+
+    // Re-apply the per-program shader state after the shader program changed
+    void OnShaderProgramChanged();
+
+    // Set the viewer position used to sort draws by depth
+    void SetViewPosition(const glm::vec3& viewPosition);
+
+    // Set the view-projection matrix used to cull objects
+    void SetViewProjection(const glm::mat4& viewProjection);
+
+    // Set the viewport height in pixels used to pick the resident texture mip levels
+    void SetViewportHeight(int height);
 };
@@ -7,156 +7,1526 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ShaderManager.h"
+#include "GLResources.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MAKE_DIRECTORY(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MAKE_DIRECTORY(path) mkdir(path, 0755)
+#endif
+
+// Declaration of global variables and defines
+namespace
+{
+    // Default location of the program binary cache, relative to the working directory
+    const char* DEFAULT_BINARY_CACHE_DIRECTORY = "shadercache";
+
+    // FNV-1a 64-bit hashing of shader sources and driver strings
+    const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+    unsigned long long HashBytes(unsigned long long hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    // Header of a program binary cache file ("SBIN")
+    const unsigned int PROGRAM_BINARY_MAGIC = 0x4E494253;
+
+    struct PROGRAM_BINARY_HEADER
+    {
+        unsigned int magic;
+        unsigned int binaryFormat;
+        unsigned long long cacheKey;
+        unsigned int length;
+        unsigned int reserved;
+    };
+
+    // Minimal program used while the real shaders compile in the
+    // background - flat shaded objectColor with the same uniform names
+    const char* FALLBACK_VERTEX_SHADER =
+        "#version 330 core\n"
+        "layout (location = 0) in vec3 inVertexPosition;\n"
+        "uniform mat4 model;\n"
+        "uniform mat4 view;\n"
+        "uniform mat4 projection;\n"
+        "void main() { gl_Position = projection * view * model * vec4(inVertexPosition, 1.0); }\n";
+
+    const char* FALLBACK_FRAGMENT_SHADER =
+        "#version 330 core\n"
+        "out vec4 outFragmentColor;\n"
+        "uniform vec4 objectColor;\n"
+        "void main() { outFragmentColor = vec4(mix(vec3(0.5), objectColor.rgb, 0.5), 1.0); }\n";
+}
 
 // Constructor: Initialize member variables
-ShaderManager::ShaderManager()
+ShaderManager::ShaderManager() : m_resources(&m_stateCache)
 {
     m_shaderProgram = 0;
+    m_bProgramLoaded = false;
+    m_binaryCacheDirectory = DEFAULT_BINARY_CACHE_DIRECTORY;
+    m_pAssetPack = NULL;
+    m_pActiveProgram = &m_emptyProgram;
+    m_activePermutation = SHADER_PERMUTATION_BASE;
+    m_slotSerial = 0;
 }
 
 // Destructor: Cleanup the shader program
 ShaderManager::~ShaderManager()
 {
-    if (m_shaderProgram != 0)
+    if (m_pendingProgram.program != 0)
+    {
+        glDeleteShader(m_pendingProgram.vertex);
+        glDeleteShader(m_pendingProgram.fragment);
+        glDeleteProgram(m_pendingProgram.program);
+        m_pendingProgram = PENDING_PROGRAM();
+    }
+
+    for (UNIFORM_BUFFER& uniformBuffer : m_uniformBuffers)
+    {
+        m_resources.Release(uniformBuffer.handle);
+        uniformBuffer.buffer = 0;
+    }
+    m_uniformBuffers.clear();
+
+    DeletePrograms();
+}
+
+/***********************************************************
+ *  DeletePrograms()
+ *
+ *  This method deletes the base program and every variant and
+ *  forgets which variants failed to build.
+ ***********************************************************/
+void ShaderManager::DeletePrograms()
+{
+    // The programs are deleted once the frames that may still use them are done
+    for (auto& entry : m_programs)
     {
-        glDeleteProgram(m_shaderProgram);
-        m_shaderProgram = 0;
+        m_resources.Release(entry.second.handle);
     }
+    m_programs.clear();
+    m_failedVariants.clear();
+
+    m_shaderProgram = 0;
+    m_bProgramLoaded = false;
+    m_pActiveProgram = &m_emptyProgram;
+    m_activePermutation = SHADER_PERMUTATION_BASE;
 }
 
 /***********************************************************
  *  LoadShaders()
  *
- *  This method loads and compiles vertex and fragment shaders
- *  from provided file paths and links them into a shader program.
+ *  This method loads the vertex and fragment shaders from the
+ *  provided file paths and links them into a shader program.
+ *  A cached program binary is used when one exists for this
+ *  source and driver; otherwise the sources are compiled and
+ *  the resulting binary is cached for the next launch.
  ***********************************************************/
 bool ShaderManager::LoadShaders(const char* vertexPath, const char* fragmentPath)
 {
-    // 1. Retrieve the vertex and fragment shader source code from filePath
     std::string vertexCode;
     std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-
-    // Ensure ifstream objects can throw exceptions
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
-    try
+    if (!ReadShaderFile(vertexPath, vertexCode) || !ReadShaderFile(fragmentPath, fragmentCode))
     {
-        // Open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
+        return false;
+    }
 
-        // Read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
+    GLuint program = BuildProgram(vertexCode, fragmentCode);
+    if (program == 0)
+    {
+        return false;
+    }
 
-        // Close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
+    m_vertexSource = vertexCode;
+    m_fragmentSource = fragmentCode;
+    ActivateProgram(program);
+    m_bProgramLoaded = true;
+    return true;
+}
 
-        // Convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+/***********************************************************
+ *  LoadShadersAsync()
+ *
+ *  This method starts loading the vertex and fragment shaders
+ *  without blocking on the shader compiler.  A cached binary is
+ *  activated right away.  Otherwise a minimal fallback program
+ *  is made current, the real program is compiled and linked by
+ *  the driver's background compiler threads
+ *  (GL_KHR_parallel_shader_compile), and PollShaders() swaps it
+ *  in once it is finished.  Without the extension this falls
+ *  back to a blocking LoadShaders().
+ ***********************************************************/
+bool ShaderManager::LoadShadersAsync(const char* vertexPath, const char* fragmentPath)
+{
+    if (!(GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile))
+    {
+        return LoadShaders(vertexPath, fragmentPath);
     }
-    catch (std::ifstream::failure& e)
+
+    std::string vertexCode;
+    std::string fragmentCode;
+
+    if (!ReadShaderFile(vertexPath, vertexCode) || !ReadShaderFile(fragmentPath, fragmentCode))
     {
-        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
         return false;
     }
 
+    // A warm binary cache needs no compiler at all
+    unsigned long long cacheKey = GetProgramCacheKey(vertexCode, fragmentCode);
+    GLuint program = LoadProgramBinary(cacheKey);
+    if (program != 0)
+    {
+        m_vertexSource = vertexCode;
+        m_fragmentSource = fragmentCode;
+        ActivateProgram(program);
+        m_bProgramLoaded = true;
+        return true;
+    }
+
+    // Let the driver use as many compiler threads as it likes
+    if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    else
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+    // Variants are not built from the new sources until they have linked
+    m_vertexSource = vertexCode;
+    m_fragmentSource = fragmentCode;
+    m_bProgramLoaded = false;
+
+    // Render with the fallback program until the real one is ready
+    if (m_shaderProgram == 0)
+    {
+        GLuint fallback = CompileProgram(FALLBACK_VERTEX_SHADER, FALLBACK_FRAGMENT_SHADER);
+        if (fallback != 0)
+        {
+            ActivateProgram(fallback);
+        }
+    }
+
+    // Queue the compile and link - none of these calls wait for the compiler
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
 
-    // 2. Compile shaders
-    unsigned int vertex, fragment;
+    PENDING_PROGRAM pending;
+    pending.cacheKey = cacheKey;
+
+    pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pending.vertex, 1, &vShaderCode, NULL);
+    glCompileShader(pending.vertex);
+
+    pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pending.fragment, 1, &fShaderCode, NULL);
+    glCompileShader(pending.fragment);
+
+    pending.program = glCreateProgram();
+    glAttachShader(pending.program, pending.vertex);
+    glAttachShader(pending.program, pending.fragment);
+    if (IsBinaryCacheSupported())
+    {
+        glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(pending.program);
+
+    if (m_pendingProgram.program != 0)
+    {
+        glDeleteShader(m_pendingProgram.vertex);
+        glDeleteShader(m_pendingProgram.fragment);
+        glDeleteProgram(m_pendingProgram.program);
+    }
+    m_pendingProgram = pending;
+
+    return true;
+}
+
+/***********************************************************
+ *  PollShaders()
+ *
+ *  This method checks, without blocking, whether a program
+ *  started by LoadShadersAsync() has finished linking.  When it
+ *  has, the program replaces the fallback and true is returned;
+ *  the caller must then call UseProgram() and re-apply any
+ *  per-program uniform state.  A program that failed to link
+ *  leaves the fallback current and is never reported ready.
+ ***********************************************************/
+bool ShaderManager::PollShaders()
+{
+    if (m_pendingProgram.program == 0)
+    {
+        return false;
+    }
+
+    GLint bComplete = GL_FALSE;
+    glGetProgramiv(m_pendingProgram.program, GL_COMPLETION_STATUS_KHR, &bComplete);
+    if (!bComplete)
+    {
+        return false;
+    }
+
+    PENDING_PROGRAM pending = m_pendingProgram;
+    m_pendingProgram = PENDING_PROGRAM();
+
     int success;
     char infoLog[512];
 
-    // Vertex Shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-
-    // Print compile errors if any
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
     if (!success)
     {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glGetShaderiv(pending.vertex, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(pending.vertex, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        glGetShaderiv(pending.fragment, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(pending.fragment, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        glGetProgramInfoLog(pending.program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        glDeleteProgram(pending.program);
+        return false;
+    }
+
+    glDeleteShader(pending.vertex);
+    glDeleteShader(pending.fragment);
+
+    SaveProgramBinary(pending.cacheKey, pending.program);
+    ActivateProgram(pending.program);
+    m_bProgramLoaded = true;
+    return true;
+}
+
+/***********************************************************
+ *  IsProgramReady()
+ *
+ *  True when the requested program (not the fallback) is the
+ *  current program.  Stays false after the requested program
+ *  failed to link, while only the fallback is there.
+ ***********************************************************/
+bool ShaderManager::IsProgramReady() const
+{
+    return m_bProgramLoaded && m_pendingProgram.program == 0;
+}
+
+/***********************************************************
+ *  ReadShaderFile()
+ *
+ *  This method reads the full text of a shader source file,
+ *  copied straight out of the asset pack when it holds the
+ *  file.
+ ***********************************************************/
+bool ShaderManager::ReadShaderFile(const char* path, std::string& code)
+{
+    const unsigned char* pData = NULL;
+    size_t size = 0;
+    if (NULL != m_pAssetPack && m_pAssetPack->Find(path, pData, size))
+    {
+        code.assign((const char*)pData, size);
+        return true;
+    }
+
+    std::ifstream shaderFile;
+
+    // Ensure ifstream objects can throw exceptions
+    shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try
+    {
+        shaderFile.open(path);
+        std::stringstream shaderStream;
+        shaderStream << shaderFile.rdbuf();
+        shaderFile.close();
+        code = shaderStream.str();
+    }
+    catch (std::ifstream::failure& e)
+    {
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << " " << e.what() << std::endl;
         return false;
     }
 
-    // Fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
+    return true;
+}
+
+/***********************************************************
+ *  BuildProgram()
+ *
+ *  This method returns a linked program for the given sources,
+ *  from the binary cache when possible and compiled from source
+ *  otherwise.  Returns 0 on failure.
+ ***********************************************************/
+GLuint ShaderManager::BuildProgram(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    unsigned long long cacheKey = GetProgramCacheKey(vertexCode, fragmentCode);
+
+    GLuint program = LoadProgramBinary(cacheKey);
+    if (program != 0)
+    {
+        return program;
+    }
+
+    program = CompileProgram(vertexCode, fragmentCode);
+    if (program != 0)
+    {
+        SaveProgramBinary(cacheKey, program);
+    }
+    return program;
+}
+
+/***********************************************************
+ *  CompileShaderStage()
+ *
+ *  This method compiles one shader stage.  Returns the shader
+ *  ID or 0 when compilation failed.
+ ***********************************************************/
+GLuint ShaderManager::CompileShaderStage(GLenum stage, const std::string& code)
+{
+    const char* shaderCode = code.c_str();
+    int success;
+    char infoLog[512];
+
+    GLuint shader = glCreateShader(stage);
+    glShaderSource(shader, 1, &shaderCode, NULL);
+    glCompileShader(shader);
 
     // Print compile errors if any
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success)
     {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return false;
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        const char* stageName = (stage == GL_VERTEX_SHADER) ? "VERTEX" : (stage == GL_FRAGMENT_SHADER) ? "FRAGMENT" : "COMPUTE";
+        std::cerr << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+/***********************************************************
+ *  CompileProgram()
+ *
+ *  This method compiles the vertex and fragment sources and
+ *  links them into a program.  Returns 0 on failure.
+ ***********************************************************/
+GLuint ShaderManager::CompileProgram(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    int success;
+    char infoLog[512];
+
+    GLuint vertex = CompileShaderStage(GL_VERTEX_SHADER, vertexCode);
+    if (vertex == 0)
+    {
+        return 0;
+    }
+
+    GLuint fragment = CompileShaderStage(GL_FRAGMENT_SHADER, fragmentCode);
+    if (fragment == 0)
+    {
+        glDeleteShader(vertex);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+
+    // Ask the driver to keep the binary around so it can be cached
+    if (IsBinaryCacheSupported())
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program);
+
+    // Delete the shaders as they're linked into our program now and no longer needed
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    // Print linking errors if any
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+/***********************************************************
+ *  LoadComputeProgram()
+ *
+ *  This method compiles and links a compute shader file into
+ *  its own program.  The program is owned by the caller and is
+ *  not part of the permutation variants.  Returns 0 on failure.
+ ***********************************************************/
+GLuint ShaderManager::LoadComputeProgram(const char* computePath)
+{
+    int success;
+    char infoLog[512];
+    std::string computeCode;
+
+    if (!ReadShaderFile(computePath, computeCode))
+    {
+        return 0;
     }
 
-    // Shader Program
-    m_shaderProgram = glCreateProgram();
-    glAttachShader(m_shaderProgram, vertex);
-    glAttachShader(m_shaderProgram, fragment);
-    glLinkProgram(m_shaderProgram);
+    GLuint compute = CompileShaderStage(GL_COMPUTE_SHADER, computeCode);
+    if (compute == 0)
+    {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, compute);
+    glLinkProgram(program);
+    glDeleteShader(compute);
 
     // Print linking errors if any
-    glGetProgramiv(m_shaderProgram, GL_LINK_STATUS, &success);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success)
     {
-        glGetProgramInfoLog(m_shaderProgram, 512, NULL, infoLog);
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
         std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+/***********************************************************
+ *  ActivateProgram()
+ *
+ *  This method makes a linked program the current program of
+ *  the shader manager, replacing any previous one.
+ ***********************************************************/
+void ShaderManager::ActivateProgram(GLuint program)
+{
+    // New base sources invalidate every variant built from the old ones
+    DeletePrograms();
+    m_shaderProgram = program;
+
+    // Reflect the active uniforms once so per-draw setters never
+    // need a driver-side name lookup
+    PROGRAM_INFO& base = m_programs[SHADER_PERMUTATION_BASE];
+    base.programID = m_shaderProgram;
+    base.handle = m_resources.AddProgram("base program", m_shaderProgram);
+    ReflectUniforms(base);
+    BindUniformBlocks(base.programID);
+
+    // Slot values are uploaded with plain glUniform* calls, which
+    // go to the bound program - not to a fallback still in use
+    m_stateCache.UseProgram(base.programID);
+    m_pActiveProgram = &base;
+    m_activePermutation = SHADER_PERMUTATION_BASE;
+    ApplySlotValues(base);
+}
+
+/***********************************************************
+ *  MakePermutationKey()
+ *
+ *  Pack permutation flags and a light count into the key used
+ *  to select a program variant.
+ ***********************************************************/
+unsigned int ShaderManager::MakePermutationKey(unsigned int flags, int lightCount)
+{
+    if (lightCount < 0)
+        lightCount = 0;
+    if (lightCount > 255)
+        lightCount = 255;
+
+    return (flags & SHADER_PERMUTATION_FLAG_MASK) | ((unsigned int)lightCount << SHADER_PERMUTATION_LIGHT_SHIFT);
+}
+
+/***********************************************************
+ *  GetPermutationDefines()
+ *
+ *  Build the #define block that specializes the shader sources
+ *  for a permutation key.
+ ***********************************************************/
+std::string ShaderManager::GetPermutationDefines(unsigned int permutationKey)
+{
+    std::stringstream defines;
+    defines << "#define PERMUTATION 1\n";
+    defines << "#define USE_TEXTURE " << ((permutationKey & SHADER_PERMUTATION_TEXTURE) ? 1 : 0) << "\n";
+    defines << "#define USE_LIGHTING " << ((permutationKey & SHADER_PERMUTATION_LIGHTING) ? 1 : 0) << "\n";
+    defines << "#define USE_INSTANCING " << ((permutationKey & SHADER_PERMUTATION_INSTANCED) ? 1 : 0) << "\n";
+    defines << "#define NUM_LIGHTS " << (permutationKey >> SHADER_PERMUTATION_LIGHT_SHIFT) << "\n";
+    return defines.str();
+}
+
+/***********************************************************
+ *  InjectDefines()
+ *
+ *  Insert a #define block right after the #version line of a
+ *  shader source.  A #line directive keeps compiler messages
+ *  pointing at the original line numbers.
+ ***********************************************************/
+std::string ShaderManager::InjectDefines(const std::string& code, const std::string& defines)
+{
+    size_t versionLine = code.find("#version");
+    if (versionLine == std::string::npos)
+    {
+        return defines + "#line 1\n" + code;
+    }
+
+    size_t lineEnd = code.find('\n', versionLine);
+    if (lineEnd == std::string::npos)
+    {
+        return code + "\n" + defines;
+    }
+
+    // Count the lines up to and including #version for the #line directive
+    int nextLine = 2;
+    for (size_t i = 0; i < versionLine; i++)
+    {
+        if (code[i] == '\n')
+            nextLine++;
+    }
+
+    return code.substr(0, lineEnd + 1) + defines + "#line " + std::to_string(nextLine) + "\n" + code.substr(lineEnd + 1);
+}
+
+/***********************************************************
+ *  UseVariant()
+ *
+ *  This method makes the program variant for a permutation key
+ *  current, building it on first use (through the binary cache
+ *  when possible).  Handle values set earlier are re-applied to
+ *  the variant so all programs see the same uniform state.
+ *  Returns false while the base program is still compiling or
+ *  when the variant fails to build.
+ ***********************************************************/
+bool ShaderManager::UseVariant(unsigned int permutationKey)
+{
+    if (permutationKey == m_activePermutation)
+    {
+        return true;
+    }
+
+    if (!IsProgramReady())
+    {
         return false;
     }
 
-    // Delete the shaders as they're linked into our program now and no longer needed
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    auto found = m_programs.find(permutationKey);
+    if (found == m_programs.end())
+    {
+        if (!BuildVariant(permutationKey))
+        {
+            return false;
+        }
+        found = m_programs.find(permutationKey);
+    }
+
+    PROGRAM_INFO& program = found->second;
+    m_stateCache.UseProgram(program.programID);
+    m_pActiveProgram = &program;
+    m_activePermutation = permutationKey;
+    ApplySlotValues(program);
 
     return true;
 }
 
 /***********************************************************
- *  UseProgram()
+ *  PrecompileVariant()
  *
- *  Use the compiled shader program.
+ *  Build a program variant ahead of its first use, e.g. while
+ *  the scene is being prepared.
  ***********************************************************/
-void ShaderManager::UseProgram()
+bool ShaderManager::PrecompileVariant(unsigned int permutationKey)
 {
-    if (m_shaderProgram != 0)
+    if (m_programs.find(permutationKey) != m_programs.end())
     {
-        glUseProgram(m_shaderProgram);
+        return true;
     }
+
+    return IsProgramReady() && BuildVariant(permutationKey);
 }
 
 /***********************************************************
- *  setMat4Value()
+ *  BuildVariant()
  *
- *  Set a 4x4 matrix uniform in the shader.
+ *  This method compiles (or loads from the binary cache) the
+ *  program variant for a permutation key and reflects it.  A
+ *  key that failed once is not rebuilt until new sources are
+ *  activated, so callers asking for it every frame do not
+ *  recompile it or repeat the error each time.
+ ***********************************************************/
+bool ShaderManager::BuildVariant(unsigned int permutationKey)
+{
+    if (m_vertexSource.empty() || m_fragmentSource.empty() ||
+        m_failedVariants.find(permutationKey) != m_failedVariants.end())
+    {
+        return false;
+    }
+
+    std::string defines = GetPermutationDefines(permutationKey);
+    GLuint program = BuildProgram(
+        InjectDefines(m_vertexSource, defines),
+        InjectDefines(m_fragmentSource, defines));
+    if (program == 0)
+    {
+        std::cerr << "ERROR::SHADER::VARIANT_FAILED: permutation 0x" << std::hex << permutationKey << std::dec << std::endl;
+        m_failedVariants.insert(permutationKey);
+        return false;
+    }
+
+    PROGRAM_INFO& variant = m_programs[permutationKey];
+    variant.programID = program;
+    std::ostringstream label;
+    label << "program variant 0x" << std::hex << permutationKey;
+    variant.handle = m_resources.AddProgram(label.str(), program);
+    ReflectUniforms(variant);
+    BindUniformBlocks(variant.programID);
+
+    return true;
+}
+
+/***********************************************************
+ *  SetBinaryCacheDirectory()
+ *
+ *  Set the directory the program binary cache lives in.  An
+ *  empty path disables the cache.
  ***********************************************************/
-void ShaderManager::setMat4Value(const std::string& name, const glm::mat4& mat) const
+void ShaderManager::SetBinaryCacheDirectory(const std::string& directory)
 {
-    glUniformMatrix4fv(glGetUniformLocation(m_shaderProgram, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    m_binaryCacheDirectory = directory;
 }
 
 /***********************************************************
- *  setVec3Value()
+ *  SetAssetPack()
  *
- *  Set a vec3 uniform in the shader.
+ *  Set the archive shader sources are read from before their
+ *  own files.  The pack must stay open while shaders load.
  ***********************************************************/
-void ShaderManager::setVec3Value(const std::string& name, const glm::vec3& value) const
+void ShaderManager::SetAssetPack(const AssetPack* pAssetPack)
+{
+    m_pAssetPack = pAssetPack;
+}
+
+/***********************************************************
+ *  IsBinaryCacheSupported()
+ *
+ *  The cache needs program binaries and at least one binary
+ *  format from the driver.
+ ***********************************************************/
+bool ShaderManager::IsBinaryCacheSupported() const
+{
+    if (m_binaryCacheDirectory.empty() || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+    {
+        return false;
+    }
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+}
+
+/***********************************************************
+ *  GetProgramCacheKey()
+ *
+ *  This method hashes the shader sources together with the
+ *  driver vendor, renderer and version strings, so a driver
+ *  update or a different GPU never reuses a stale binary.
+ ***********************************************************/
+unsigned long long ShaderManager::GetProgramCacheKey(const std::string& vertexCode, const std::string& fragmentCode) const
+{
+    const char* vendor = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+
+    unsigned long long hash = FNV_OFFSET_BASIS;
+    hash = HashBytes(hash, vertexCode.c_str(), vertexCode.size() + 1);
+    hash = HashBytes(hash, fragmentCode.c_str(), fragmentCode.size() + 1);
+    hash = HashBytes(hash, vendor ? vendor : "", vendor ? strlen(vendor) + 1 : 1);
+    hash = HashBytes(hash, renderer ? renderer : "", renderer ? strlen(renderer) + 1 : 1);
+    hash = HashBytes(hash, version ? version : "", version ? strlen(version) + 1 : 1);
+    return hash;
+}
+
+/***********************************************************
+ *  GetProgramCachePath()
+ *
+ *  Get the cache file path for a program cache key.
+ ***********************************************************/
+std::string ShaderManager::GetProgramCachePath(unsigned long long cacheKey) const
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.bin", cacheKey);
+    return m_binaryCacheDirectory + "/" + fileName;
+}
+
+/***********************************************************
+ *  LoadProgramBinary()
+ *
+ *  This method creates a program from a cached binary.  Returns
+ *  0 when there is no cache entry or the driver rejects it, in
+ *  which case the stale entry is removed.
+ ***********************************************************/
+GLuint ShaderManager::LoadProgramBinary(unsigned long long cacheKey)
+{
+    if (!IsBinaryCacheSupported())
+    {
+        return 0;
+    }
+
+    std::string path = GetProgramCachePath(cacheKey);
+    std::ifstream cacheFile(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!cacheFile)
+    {
+        return 0;
+    }
+
+    // A truncated or corrupted entry must not size the allocation
+    std::streamoff fileSize = cacheFile.tellg();
+    cacheFile.seekg(0);
+
+    PROGRAM_BINARY_HEADER header;
+    std::vector<char> binary;
+    if (fileSize >= (std::streamoff)sizeof(header) &&
+        cacheFile.read((char*)&header, sizeof(header)) &&
+        header.magic == PROGRAM_BINARY_MAGIC &&
+        header.cacheKey == cacheKey &&
+        header.length > 0 &&
+        header.length <= (unsigned long long)(fileSize - (std::streamoff)sizeof(header)))
+    {
+        binary.resize(header.length);
+        cacheFile.read(binary.data(), header.length);
+    }
+    bool bComplete = !binary.empty() && cacheFile.good();
+    cacheFile.close();
+
+    if (!bComplete)
+    {
+        std::remove(path.c_str());
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, (GLenum)header.binaryFormat, binary.data(), (GLsizei)header.length);
+
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        // The driver may reject a binary for any reason - compile from source instead
+        std::cout << "INFO: Cached shader binary rejected, compiling from source" << std::endl;
+        glDeleteProgram(program);
+        std::remove(path.c_str());
+        return 0;
+    }
+
+    return program;
+}
+
+/***********************************************************
+ *  SaveProgramBinary()
+ *
+ *  This method writes the binary of a linked program to the
+ *  cache directory.
+ ***********************************************************/
+void ShaderManager::SaveProgramBinary(unsigned long long cacheKey, GLuint program)
+{
+    if (!IsBinaryCacheSupported())
+    {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, length, NULL, &binaryFormat, binary.data());
+
+    PROGRAM_BINARY_HEADER header;
+    header.magic = PROGRAM_BINARY_MAGIC;
+    header.binaryFormat = binaryFormat;
+    header.cacheKey = cacheKey;
+    header.length = (unsigned int)length;
+    header.reserved = 0;
+
+    MAKE_DIRECTORY(m_binaryCacheDirectory.c_str());
+
+    // Write to a temporary file first so a crash never leaves a torn entry
+    std::string path = GetProgramCachePath(cacheKey);
+    std::string tempPath = path + ".tmp";
+    std::ofstream cacheFile(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!cacheFile)
+    {
+        return;
+    }
+    cacheFile.write((const char*)&header, sizeof(header));
+    cacheFile.write(binary.data(), length);
+    cacheFile.close();
+
+    std::remove(path.c_str());
+    if (!cacheFile || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+    }
+}
+
+/***********************************************************
+ *  ReflectUniforms()
+ *
+ *  This method queries every active uniform of the linked
+ *  program and fills the name -> location cache, then resolves
+ *  the locations of all registered handle slots.
+ ***********************************************************/
+void ShaderManager::ReflectUniforms(PROGRAM_INFO& program)
+{
+    if (GLEW_VERSION_4_3 || GLEW_ARB_program_interface_query)
+    {
+        GLint uniformCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramInterfaceiv(program.programID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+        glGetProgramInterfaceiv(program.programID, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+
+        const GLenum properties[] = { GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX };
+        std::vector<char> nameBuffer(maxNameLength + 1);
+
+        for (GLint i = 0; i < uniformCount; i++)
+        {
+            GLint values[4] = { 0, 0, -1, -1 };
+            glGetProgramResourceiv(program.programID, GL_UNIFORM, i, 4, properties, 4, NULL, values);
+
+            // Members of uniform blocks have no location of their own
+            if (values[3] != -1 || values[2] < 0)
+                continue;
+
+            glGetProgramResourceName(program.programID, GL_UNIFORM, i, (GLsizei)nameBuffer.size(), NULL, nameBuffer.data());
+
+            UNIFORM_INFO info;
+            info.name = nameBuffer.data();
+            info.type = (GLenum)values[0];
+            info.arraySize = values[1];
+            info.location = values[2];
+            AddUniform(program, info);
+        }
+    }
+    else
+    {
+        // Fallback for contexts without program interface queries (e.g. macOS 3.3)
+        GLint uniformCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramiv(program.programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(program.programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+        std::vector<char> nameBuffer(maxNameLength + 1);
+
+        for (GLint i = 0; i < uniformCount; i++)
+        {
+            UNIFORM_INFO info;
+            glGetActiveUniform(program.programID, (GLuint)i, (GLsizei)nameBuffer.size(), NULL, &info.arraySize, &info.type, nameBuffer.data());
+            info.name = nameBuffer.data();
+            info.location = glGetUniformLocation(program.programID, info.name.c_str());
+
+            // Members of uniform blocks have no location of their own
+            if (info.location < 0)
+                continue;
+
+            AddUniform(program, info);
+        }
+    }
+
+    program.slotLocations.assign(m_uniformSlots.size(), -1);
+    program.slotSerials.assign(m_uniformSlots.size(), 0);
+    for (int slot = 0; slot < (int)m_uniformSlots.size(); slot++)
+    {
+        ResolveSlot(program, slot);
+    }
+}
+
+/***********************************************************
+ *  AddUniform()
+ *
+ *  This method records a reflected uniform in the location
+ *  cache.  Arrays are registered under the base name and under
+ *  the name of each element, e.g. "values", "values[1]".
+ ***********************************************************/
+void ShaderManager::AddUniform(PROGRAM_INFO& program, const UNIFORM_INFO& info)
+{
+    program.uniforms.push_back(info);
+    program.locations[info.name] = info.location;
+
+    const std::string arraySuffix = "[0]";
+    if (info.name.size() > arraySuffix.size() &&
+        info.name.compare(info.name.size() - arraySuffix.size(), arraySuffix.size(), arraySuffix) == 0)
+    {
+        std::string baseName = info.name.substr(0, info.name.size() - arraySuffix.size());
+        program.locations[baseName] = info.location;
+
+        for (GLint i = 1; i < info.arraySize; i++)
+        {
+            std::string elementName = baseName + "[" + std::to_string(i) + "]";
+            program.locations[elementName] = glGetUniformLocation(program.programID, elementName.c_str());
+        }
+    }
+}
+
+/***********************************************************
+ *  ResolveSlot()
+ *
+ *  This method looks up the location behind a handle slot in
+ *  the given program and warns when the GLSL type does not
+ *  match the type the handle was requested with.
+ ***********************************************************/
+void ShaderManager::ResolveSlot(PROGRAM_INFO& program, int slot)
+{
+    const UNIFORM_SLOT& uniformSlot = m_uniformSlots[slot];
+
+    if ((int)program.slotLocations.size() <= slot)
+    {
+        program.slotLocations.resize(slot + 1, -1);
+        program.slotSerials.resize(slot + 1, 0);
+    }
+
+    auto found = program.locations.find(uniformSlot.name);
+    if (found == program.locations.end())
+    {
+        program.slotLocations[slot] = -1;
+        return;
+    }
+    program.slotLocations[slot] = found->second;
+
+    for (const UNIFORM_INFO& info : program.uniforms)
+    {
+        if (info.location != found->second)
+            continue;
+
+        // Samplers and bools are set through integer handles
+        bool bCompatible = (info.type == uniformSlot.type) ||
+            (uniformSlot.type == GL_INT && (info.type == GL_BOOL || info.type == GL_SAMPLER_2D || info.type == GL_SAMPLER_2D_ARRAY)) ||
+            (uniformSlot.type == GL_BOOL && info.type == GL_INT);
+        if (!bCompatible)
+        {
+            std::cerr << "WARNING::SHADER::UNIFORM_TYPE_MISMATCH: " << uniformSlot.name << std::endl;
+        }
+        break;
+    }
+}
+
+/***********************************************************
+ *  RegisterUniformSlot()
+ *
+ *  This method registers a uniform name for handle access and
+ *  returns its slot.  Requesting the same name twice returns
+ *  the same slot.
+ ***********************************************************/
+int ShaderManager::RegisterUniformSlot(const std::string& name, GLenum type)
+{
+    auto found = m_slotIndex.find(name);
+    if (found != m_slotIndex.end())
+    {
+        return found->second;
+    }
+
+    int slot = (int)m_uniformSlots.size();
+    m_uniformSlots.push_back({ name, type });
+    m_slotValues.push_back(SLOT_VALUE());
+    m_slotIndex[name] = slot;
+
+    // Handles may be resolved before the program is linked; those
+    // slots are filled in by ReflectUniforms() once it is
+    for (auto& entry : m_programs)
+    {
+        ResolveSlot(entry.second, slot);
+    }
+
+    return slot;
+}
+
+/***********************************************************
+ *  SetSlotValue()
+ *
+ *  This method records the value set through a handle and
+ *  uploads it to the active program.  The recorded value is
+ *  re-applied to any other program variant when it becomes
+ *  active, so per-frame values like the view matrix follow the
+ *  scene across variant switches.
+ ***********************************************************/
+void ShaderManager::SetSlotValue(int slot, const void* data, size_t size)
+{
+    if (slot < 0 || slot >= (int)m_slotValues.size())
+    {
+        return;
+    }
+
+    SLOT_VALUE& value = m_slotValues[slot];
+    if (!value.bSet || memcmp(value.data, data, size) != 0)
+    {
+        memcpy(value.data, data, size);
+        value.bSet = true;
+        value.serial = ++m_slotSerial;
+    }
+
+    ApplySlotValue(*m_pActiveProgram, slot);
+}
+
+/***********************************************************
+ *  ApplySlotValue()
+ *
+ *  Upload the recorded value of one handle slot to a program
+ *  unless that program already has it.
+ ***********************************************************/
+void ShaderManager::ApplySlotValue(PROGRAM_INFO& program, int slot)
+{
+    const SLOT_VALUE& value = m_slotValues[slot];
+    if (!value.bSet || slot >= (int)program.slotSerials.size())
+    {
+        return;
+    }
+
+    if (program.slotSerials[slot] == value.serial)
+    {
+        m_uniformStats.skipped++;
+        return;
+    }
+    program.slotSerials[slot] = value.serial;
+
+    GLint location = program.slotLocations[slot];
+    switch (m_uniformSlots[slot].type)
+    {
+    case GL_BOOL:
+    case GL_INT:
+        UploadInt(location, *(const int*)value.data);
+        break;
+    case GL_FLOAT:
+        UploadFloat(location, value.data[0]);
+        break;
+    case GL_FLOAT_VEC2:
+        UploadVec2(location, glm::vec2(value.data[0], value.data[1]));
+        break;
+    case GL_FLOAT_VEC3:
+        UploadVec3(location, glm::vec3(value.data[0], value.data[1], value.data[2]));
+        break;
+    case GL_FLOAT_VEC4:
+        UploadVec4(location, glm::vec4(value.data[0], value.data[1], value.data[2], value.data[3]));
+        break;
+    case GL_FLOAT_MAT4:
+        UploadMat4(location, *(const glm::mat4*)value.data);
+        break;
+    }
+}
+
+/***********************************************************
+ *  ApplySlotValues()
+ *
+ *  Bring every handle slot of a program up to date after it
+ *  becomes the active program.
+ * Time Complexity: O(S) - Linear in the number of handle slots
+ ***********************************************************/
+void ShaderManager::ApplySlotValues(PROGRAM_INFO& program)
+{
+    for (int slot = 0; slot < (int)m_slotValues.size(); slot++)
+    {
+        if (program.slotLocations[slot] >= 0 && program.slotSerials[slot] != m_slotValues[slot].serial)
+        {
+            ApplySlotValue(program, slot);
+        }
+    }
+}
+
+/***********************************************************
+ *  GetSlotLocation()
+ *
+ *  Get the uniform location behind a handle slot.
+ ***********************************************************/
+GLint ShaderManager::GetSlotLocation(int slot) const
+{
+    if (slot < 0 || slot >= (int)m_pActiveProgram->slotLocations.size())
+    {
+        return -1;
+    }
+    return m_pActiveProgram->slotLocations[slot];
+}
+
+/***********************************************************
+ *  GetUniformLocation()
+ *
+ *  Get the location of a uniform by name.  Names found by
+ *  reflection are served from the hashed cache; any other name
+ *  is queried from the driver once and then cached as well.
+ ***********************************************************/
+GLint ShaderManager::GetUniformLocation(const std::string& name)
+{
+    if (m_pActiveProgram->programID == 0)
+    {
+        return -1;
+    }
+
+    auto found = m_pActiveProgram->locations.find(name);
+    if (found != m_pActiveProgram->locations.end())
+    {
+        return found->second;
+    }
+
+    GLint location = glGetUniformLocation(m_pActiveProgram->programID, name.c_str());
+    m_pActiveProgram->locations[name] = location;
+    return location;
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  Use the compiled shader program (the active variant).
+ ***********************************************************/
+void ShaderManager::UseProgram()
+{
+    if (m_pActiveProgram->programID != 0)
+    {
+        m_stateCache.UseProgram(m_pActiveProgram->programID);
+    }
+}
+
+/***********************************************************
+ *  CreateUniformBuffer()
+ *
+ *  This method creates a uniform buffer of the given size,
+ *  binds it to a binding point and attaches the named std140
+ *  block of the linked program to that point.  Programs linked
+ *  later get the same attachment.  Returns 0 when the program
+ *  does not declare the block so callers can fall back to
+ *  plain uniforms.
+ ***********************************************************/
+GLuint ShaderManager::CreateUniformBuffer(const std::string& blockName, GLuint bindingPoint, GLsizeiptr size)
+{
+    if (!HasUniformBlock(blockName))
+    {
+        return 0;
+    }
+
+    UNIFORM_BUFFER uniformBuffer;
+    uniformBuffer.blockName = blockName;
+    uniformBuffer.bindingPoint = bindingPoint;
+    uniformBuffer.buffer = 0;
+
+    uniformBuffer.handle = m_resources.CreateBuffer(blockName, GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_STORAGE_BIT);
+    uniformBuffer.buffer = m_resources.GetBuffer(uniformBuffer.handle);
+    m_stateCache.BindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, uniformBuffer.buffer);
+
+    m_uniformBuffers.push_back(uniformBuffer);
+    for (auto& entry : m_programs)
+    {
+        BindUniformBlocks(entry.second.programID);
+    }
+
+    return uniformBuffer.buffer;
+}
+
+/***********************************************************
+ *  UpdateUniformBuffer()
+ *
+ *  Replace part or all of the contents of a uniform buffer.
+ ***********************************************************/
+void ShaderManager::UpdateUniformBuffer(GLuint buffer, const void* data, GLsizeiptr size, GLintptr offset)
+{
+    if (buffer == 0)
+        return;
+
+    GLResources::UpdateBuffer(m_stateCache, GL_UNIFORM_BUFFER, buffer, offset, size, data);
+}
+
+/***********************************************************
+ *  HasUniformBlock()
+ *
+ *  Check whether the linked program declares a uniform block.
+ ***********************************************************/
+bool ShaderManager::HasUniformBlock(const std::string& blockName) const
+{
+    if (m_shaderProgram == 0)
+        return false;
+
+    return glGetUniformBlockIndex(m_shaderProgram, blockName.c_str()) != GL_INVALID_INDEX;
+}
+
+/***********************************************************
+ *  BindUniformBlocks()
+ *
+ *  This method attaches the blocks of a program to the binding
+ *  points of the uniform buffers created so far.
+ ***********************************************************/
+void ShaderManager::BindUniformBlocks(GLuint programID)
+{
+    if (programID == 0)
+        return;
+
+    for (const UNIFORM_BUFFER& uniformBuffer : m_uniformBuffers)
+    {
+        GLuint blockIndex = glGetUniformBlockIndex(programID, uniformBuffer.blockName.c_str());
+        if (blockIndex != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(programID, blockIndex, uniformBuffer.bindingPoint);
+        }
+    }
+}
+
+/***********************************************************
+ *  ShadowUniform()
+ *
+ *  This method compares a new uniform value against the CPU
+ *  side shadow copy for the linked program.  It returns true
+ *  (and updates the shadow) when the value changed and must be
+ *  uploaded, or false when the GL call can be skipped.
+ ***********************************************************/
+bool ShaderManager::ShadowUniform(GLint location, const void* data, size_t size)
+{
+    // glUniform* ignores location -1, so there is nothing to upload
+    if (location < 0)
+    {
+        return false;
+    }
+
+    std::vector<UNIFORM_SHADOW>& shadow = m_pActiveProgram->shadow;
+    if ((size_t)location >= shadow.size())
+    {
+        shadow.resize(location + 1);
+    }
+
+    UNIFORM_SHADOW& entry = shadow[location];
+    if (entry.bValid && memcmp(entry.data, data, size) == 0)
+    {
+        m_uniformStats.skipped++;
+        return false;
+    }
+
+    memcpy(entry.data, data, size);
+    entry.bValid = true;
+    m_uniformStats.uploaded++;
+    return true;
+}
+
+/***********************************************************
+ *  InvalidateUniformShadow()
+ *
+ *  Forget every shadowed uniform value so the next set of each
+ *  uniform is uploaded.  Call this after changing uniforms of
+ *  the program outside of ShaderManager.
+ ***********************************************************/
+void ShaderManager::InvalidateUniformShadow()
+{
+    for (auto& entry : m_programs)
+    {
+        entry.second.shadow.clear();
+        std::fill(entry.second.slotSerials.begin(), entry.second.slotSerials.end(), 0);
+    }
+}
+
+/***********************************************************
+ *  GetUniformStats() / ResetUniformStats()
+ *
+ *  Access the counters of uploaded and skipped uniform sets.
+ ***********************************************************/
+ShaderManager::UNIFORM_STATS ShaderManager::GetUniformStats() const
+{
+    return m_uniformStats;
+}
+
+void ShaderManager::ResetUniformStats()
+{
+    m_uniformStats = UNIFORM_STATS();
+}
+
+/***********************************************************
+ *  Uniform upload helpers
+ *
+ *  Every setter funnels through these so redundant values are
+ *  filtered against the shadow copy before reaching GL.
+ ***********************************************************/
+void ShaderManager::UploadInt(GLint location, int value)
+{
+    if (ShadowUniform(location, &value, sizeof(value)))
+        glUniform1i(location, value);
+}
+
+void ShaderManager::UploadFloat(GLint location, float value)
+{
+    if (ShadowUniform(location, &value, sizeof(value)))
+        glUniform1f(location, value);
+}
+
+void ShaderManager::UploadVec2(GLint location, const glm::vec2& value)
+{
+    if (ShadowUniform(location, &value[0], 2 * sizeof(float)))
+        glUniform2fv(location, 1, &value[0]);
+}
+
+void ShaderManager::UploadVec3(GLint location, const glm::vec3& value)
+{
+    if (ShadowUniform(location, &value[0], 3 * sizeof(float)))
+        glUniform3fv(location, 1, &value[0]);
+}
+
+void ShaderManager::UploadVec4(GLint location, const glm::vec4& value)
+{
+    if (ShadowUniform(location, &value[0], 4 * sizeof(float)))
+        glUniform4fv(location, 1, &value[0]);
+}
+
+void ShaderManager::UploadMat4(GLint location, const glm::mat4& mat)
+{
+    if (ShadowUniform(location, &mat[0][0], 16 * sizeof(float)))
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+}
+
+/***********************************************************
+ *  setBoolValue()
+ *
+ *  Set a bool uniform in the shader.
+ ***********************************************************/
+void ShaderManager::setBoolValue(const std::string& name, bool value)
+{
+    UploadInt(GetUniformLocation(name), (int)value);
+}
+
+/***********************************************************
+ *  setIntValue()
+ *
+ *  Set an int uniform in the shader.
+ ***********************************************************/
+void ShaderManager::setIntValue(const std::string& name, int value)
+{
+    UploadInt(GetUniformLocation(name), value);
+}
+
+/***********************************************************
+ *  setFloatValue()
+ *
+ *  Set a float uniform in the shader.
+ ***********************************************************/
+void ShaderManager::setFloatValue(const std::string& name, float value)
+{
+    UploadFloat(GetUniformLocation(name), value);
+}
+
+/***********************************************************
+ *  setVec2Value()
+ *
+ *  Set a vec2 uniform in the shader.
+ ***********************************************************/
+void ShaderManager::setVec2Value(const std::string& name, const glm::vec2& value)
+{
+    UploadVec2(GetUniformLocation(name), value);
+}
+
+/***********************************************************
+ *  setVec3Value()
+ *
+ *  Set a vec3 uniform in the shader.
+ ***********************************************************/
+void ShaderManager::setVec3Value(const std::string& name, const glm::vec3& value)
+{
+    UploadVec3(GetUniformLocation(name), value);
+}
+
+/***********************************************************
+ *  setVec3Value()
+ *
+ *  Set a vec3 uniform in the shader from components.
+ ***********************************************************/
+void ShaderManager::setVec3Value(const std::string& name, float x, float y, float z)
+{
+    UploadVec3(GetUniformLocation(name), glm::vec3(x, y, z));
+}
+
+/***********************************************************
+ *  setVec4Value()
+ *
+ *  Set a vec4 uniform in the shader.
+ ***********************************************************/
+void ShaderManager::setVec4Value(const std::string& name, const glm::vec4& value)
+{
+    UploadVec4(GetUniformLocation(name), value);
+}
+
+/***********************************************************
+ *  setMat4Value()
+ *
+ *  Set a 4x4 matrix uniform in the shader.
+ ***********************************************************/
+void ShaderManager::setMat4Value(const std::string& name, const glm::mat4& mat)
+{
+    UploadMat4(GetUniformLocation(name), mat);
+}
+
+/***********************************************************
+ *  setSampler2DValue()
+ *
+ *  Set a sampler2D uniform to a texture unit.
+ ***********************************************************/
+void ShaderManager::setSampler2DValue(const std::string& name, int value)
+{
+    UploadInt(GetUniformLocation(name), value);
+}
+
+/***********************************************************
+ *  Handle setters
+ *
+ *  Set uniform values through handles resolved once with
+ *  GetUniform<T>() - no string hashing or driver lookup.
+ ***********************************************************/
+void ShaderManager::setBoolValue(UniformHandle<bool> handle, bool value)
+{
+    int intValue = (int)value;
+    SetSlotValue(handle.slot, &intValue, sizeof(intValue));
+}
+
+void ShaderManager::setIntValue(UniformHandle<int> handle, int value)
+{
+    SetSlotValue(handle.slot, &value, sizeof(value));
+}
+
+void ShaderManager::setFloatValue(UniformHandle<float> handle, float value)
+{
+    SetSlotValue(handle.slot, &value, sizeof(value));
+}
+
+void ShaderManager::setVec2Value(UniformHandle<glm::vec2> handle, const glm::vec2& value)
+{
+    SetSlotValue(handle.slot, &value[0], 2 * sizeof(float));
+}
+
+void ShaderManager::setVec3Value(UniformHandle<glm::vec3> handle, const glm::vec3& value)
+{
+    SetSlotValue(handle.slot, &value[0], 3 * sizeof(float));
+}
+
+void ShaderManager::setVec4Value(UniformHandle<glm::vec4> handle, const glm::vec4& value)
+{
+    SetSlotValue(handle.slot, &value[0], 4 * sizeof(float));
+}
+
+void ShaderManager::setMat4Value(UniformHandle<glm::mat4> handle, const glm::mat4& mat)
 {
-    glUniform3fv(glGetUniformLocation(m_shaderProgram, name.c_str()), 1, &value[0]);
+    SetSlotValue(handle.slot, &mat[0][0], 16 * sizeof(float));
 }
@@ -0,0 +1,334 @@
+///////////////////////////////////////////////////////////////////////////////
+// ShaderManager.h
+// ===============
+// Manage the creation, compilation, and linking of shader programs
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GLStateCache.h"
+#include "GpuResourceManager.h"
+#include "AssetPack.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  UniformTypeTraits
+ *
+ *  Maps a C++ uniform value type onto the GLSL type reported
+ *  by uniform reflection, so typed handles can be validated.
+ ***********************************************************/
+template <typename T> struct UniformTypeTraits;
+template <> struct UniformTypeTraits<bool>      { static const GLenum glType = GL_BOOL; };
+template <> struct UniformTypeTraits<int>       { static const GLenum glType = GL_INT; };
+template <> struct UniformTypeTraits<float>     { static const GLenum glType = GL_FLOAT; };
+template <> struct UniformTypeTraits<glm::vec2> { static const GLenum glType = GL_FLOAT_VEC2; };
+template <> struct UniformTypeTraits<glm::vec3> { static const GLenum glType = GL_FLOAT_VEC3; };
+template <> struct UniformTypeTraits<glm::vec4> { static const GLenum glType = GL_FLOAT_VEC4; };
+template <> struct UniformTypeTraits<glm::mat4> { static const GLenum glType = GL_FLOAT_MAT4; };
+
+/***********************************************************
+ *  UniformHandle
+ *
+ *  Typed handle to a shader uniform.  Resolve it once with
+ *  ShaderManager::GetUniform<T>() and reuse it for every
+ *  draw - setting a value through a handle is an array index
+ *  instead of a driver-side name lookup.
+ ***********************************************************/
+template <typename T>
+struct UniformHandle
+{
+    int slot = -1;
+
+    bool IsValid() const { return slot >= 0; }
+};
+
+/***********************************************************
+ *  Shader permutations
+ *
+ *  A permutation key selects a program variant compiled from
+ *  the same sources with a block of #defines.  The low bits
+ *  hold feature flags and bits 8-15 the number of lights, so
+ *  the compiler can drop untextured, unlit and unused-light
+ *  code instead of branching on uniforms per pixel.  The base
+ *  key compiles the sources without any defines (all features
+ *  selected at runtime by uniforms).
+ ***********************************************************/
+const unsigned int SHADER_PERMUTATION_TEXTURE = 1u << 0;
+const unsigned int SHADER_PERMUTATION_LIGHTING = 1u << 1;
+const unsigned int SHADER_PERMUTATION_INSTANCED = 1u << 2;
+const unsigned int SHADER_PERMUTATION_FLAG_MASK = 0xFFu;
+const unsigned int SHADER_PERMUTATION_LIGHT_SHIFT = 8;
+const unsigned int SHADER_PERMUTATION_BASE = 0xFFFFFFFFu;
+
+/***********************************************************
+ *  ShaderManager
+ *
+ *  This class loads, compiles and links the shader programs
+ *  and provides access to the uniforms of the active program.
+ ***********************************************************/
+class ShaderManager
+{
+public:
+    // Constructor: Initialize member variables
+    ShaderManager();
+
+    // Destructor: Cleanup the shader program
+    ~ShaderManager();
+
+    // Structure to hold the reflected description of an active uniform
+    struct UNIFORM_INFO
+    {
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint arraySize;
+    };
+
+    // Structure to hold the counters of the uniform shadow state
+    struct UNIFORM_STATS
+    {
+        unsigned long long uploaded = 0;  // Sets that reached glUniform*
+        unsigned long long skipped = 0;   // Sets filtered as redundant
+    };
+
+    // Load, compile and link the vertex and fragment shaders
+    bool LoadShaders(const char* vertexPath, const char* fragmentPath);
+
+    // Start loading the shaders without blocking on the compiler
+    bool LoadShadersAsync(const char* vertexPath, const char* fragmentPath);
+
+    // Swap in an asynchronously compiled program once it is ready
+    // (returns true on the frame the program changed)
+    bool PollShaders();
+
+    // True once the requested program has replaced the fallback (false after it failed to link)
+    bool IsProgramReady() const;
+
+    // Use the compiled shader program
+    void UseProgram();
+
+    // Get the cache that filters redundant GL state changes
+    GLStateCache& GetStateCache() { return m_stateCache; }
+
+    // Get the owner of the GL textures, buffers and programs of the context
+    GpuResourceManager& GetResources() { return m_resources; }
+
+    // Compile and link a compute shader into a separate program (0 on failure)
+    GLuint LoadComputeProgram(const char* computePath);
+
+    // Set the directory of the on-disk program binary cache ("" disables it)
+    void SetBinaryCacheDirectory(const std::string& directory);
+
+    // Set the asset pack shader sources are read from before their own files (NULL = files only)
+    void SetAssetPack(const AssetPack* pAssetPack);
+
+    // Pack permutation flags and a light count into a permutation key
+    static unsigned int MakePermutationKey(unsigned int flags, int lightCount);
+
+    // Make the program variant for a permutation key current (built on first use)
+    bool UseVariant(unsigned int permutationKey);
+
+    // Build a program variant ahead of its first use
+    bool PrecompileVariant(unsigned int permutationKey);
+
+    // Get the permutation key of the active program variant
+    unsigned int GetActivePermutation() const { return m_activePermutation; }
+
+    // Resolve a typed handle for the named uniform (call once, reuse per draw)
+    template <typename T>
+    UniformHandle<T> GetUniform(const std::string& name)
+    {
+        UniformHandle<T> handle;
+        handle.slot = RegisterUniformSlot(name, UniformTypeTraits<T>::glType);
+        return handle;
+    }
+
+    // Get the location of a uniform by name (hashed cache lookup)
+    GLint GetUniformLocation(const std::string& name);
+
+    // Get the list of active uniforms reflected from the linked program
+    const std::vector<UNIFORM_INFO>& GetActiveUniforms() const { return m_pActiveProgram->uniforms; }
+
+    // Set uniform values by name
+    void setBoolValue(const std::string& name, bool value);
+    void setIntValue(const std::string& name, int value);
+    void setFloatValue(const std::string& name, float value);
+    void setVec2Value(const std::string& name, const glm::vec2& value);
+    void setVec3Value(const std::string& name, const glm::vec3& value);
+    void setVec3Value(const std::string& name, float x, float y, float z);
+    void setVec4Value(const std::string& name, const glm::vec4& value);
+    void setMat4Value(const std::string& name, const glm::mat4& mat);
+    void setSampler2DValue(const std::string& name, int value);
+
+    // Set uniform values through pre-resolved handles
+    void setBoolValue(UniformHandle<bool> handle, bool value);
+    void setIntValue(UniformHandle<int> handle, int value);
+    void setFloatValue(UniformHandle<float> handle, float value);
+    void setVec2Value(UniformHandle<glm::vec2> handle, const glm::vec2& value);
+    void setVec3Value(UniformHandle<glm::vec3> handle, const glm::vec3& value);
+    void setVec4Value(UniformHandle<glm::vec4> handle, const glm::vec4& value);
+    void setMat4Value(UniformHandle<glm::mat4> handle, const glm::mat4& mat);
+
+    // Create a uniform buffer attached to the named std140 block
+    // (returns 0 if the linked program does not declare the block)
+    GLuint CreateUniformBuffer(const std::string& blockName, GLuint bindingPoint, GLsizeiptr size);
+
+    // Replace part or all of the contents of a uniform buffer
+    void UpdateUniformBuffer(GLuint buffer, const void* data, GLsizeiptr size, GLintptr offset = 0);
+
+    // Check whether the linked program declares the named uniform block
+    bool HasUniformBlock(const std::string& blockName) const;
+
+    // Forget all shadowed uniform values so the next sets are uploaded
+    void InvalidateUniformShadow();
+
+    // Get and reset the uploaded / skipped uniform counters
+    UNIFORM_STATS GetUniformStats() const;
+    void ResetUniformStats();
+
+private:
+    // Structure to hold the last value uploaded to one uniform location
+    struct UNIFORM_SHADOW
+    {
+        bool bValid = false;
+        float data[16];
+    };
+
+    // Structure to hold the reflected uniform state of a linked program
+    struct PROGRAM_INFO
+    {
+        GLuint programID = 0;
+        GpuResourceManager::PROGRAM_HANDLE handle;         // Owning handle of programID
+        std::vector<UNIFORM_INFO> uniforms;                // Active uniforms from reflection
+        std::unordered_map<std::string, GLint> locations;  // Uniform name -> location cache
+        std::vector<GLint> slotLocations;                  // Handle slot -> location
+        std::vector<unsigned long long> slotSerials;       // Handle slot -> serial of the applied value
+        std::vector<UNIFORM_SHADOW> shadow;                // Location -> last uploaded value
+    };
+
+    // Structure to hold the last value set through a handle slot
+    struct SLOT_VALUE
+    {
+        bool bSet = false;
+        float data[16];
+        unsigned long long serial = 0;
+    };
+
+    // Structure to hold a program being compiled in the background
+    struct PENDING_PROGRAM
+    {
+        GLuint vertex = 0;
+        GLuint fragment = 0;
+        GLuint program = 0;
+        unsigned long long cacheKey = 0;
+    };
+
+    // Structure to hold a uniform buffer and the block it feeds
+    struct UNIFORM_BUFFER
+    {
+        std::string blockName;
+        GLuint bindingPoint;
+        GLuint buffer;
+        GpuResourceManager::BUFFER_HANDLE handle;          // Owning handle of buffer
+    };
+
+    // Structure to hold a uniform name registered for typed handles
+    struct UNIFORM_SLOT
+    {
+        std::string name;
+        GLenum type;
+    };
+
+    unsigned int m_shaderProgram;        // ID of the linked shader program
+    bool m_bProgramLoaded;               // The requested program (not the fallback) is linked
+    std::string m_binaryCacheDirectory;  // Directory of the program binary cache
+    const AssetPack* m_pAssetPack;       // Archive read before the shader files (optional)
+    PENDING_PROGRAM m_pendingProgram;    // Program compiling in the background
+    std::string m_vertexSource;          // Vertex source the variants are built from
+    std::string m_fragmentSource;        // Fragment source the variants are built from
+    std::unordered_map<unsigned int, PROGRAM_INFO> m_programs;  // Permutation key -> program variant
+    std::unordered_set<unsigned int> m_failedVariants;          // Permutation keys that failed to build from these sources
+    PROGRAM_INFO m_emptyProgram;         // Stand-in while no program is linked
+    PROGRAM_INFO* m_pActiveProgram;      // Variant uniforms are set on
+    unsigned int m_activePermutation;    // Permutation key of the active variant
+    std::vector<SLOT_VALUE> m_slotValues;                // Handle slot -> last set value
+    unsigned long long m_slotSerial;     // Serial of the most recent handle value change
+    std::vector<UNIFORM_SLOT> m_uniformSlots;            // Registered handle slots
+    std::unordered_map<std::string, int> m_slotIndex;    // Uniform name -> handle slot
+    UNIFORM_STATS m_uniformStats;        // Uploaded / skipped uniform counters
+    std::vector<UNIFORM_BUFFER> m_uniformBuffers;        // Uniform buffers and their blocks
+    GLStateCache m_stateCache;           // Bound GL objects and state of the context
+    GpuResourceManager m_resources;      // Owned GL objects (declared after the state cache it uses)
+
+    // Attach every created uniform buffer's block to its binding point
+    void BindUniformBlocks(GLuint programID);
+
+    // Read the full text of a shader source file
+    bool ReadShaderFile(const char* path, std::string& code);
+
+    // Get a linked program for the sources, from the binary cache when possible
+    GLuint BuildProgram(const std::string& vertexCode, const std::string& fragmentCode);
+
+    // Compile one shader stage (0 on failure)
+    GLuint CompileShaderStage(GLenum stage, const std::string& code);
+
+    // Compile and link a program from source (0 on failure)
+    GLuint CompileProgram(const std::string& vertexCode, const std::string& fragmentCode);
+
+    // Make a linked program current and reflect its uniforms
+    void ActivateProgram(GLuint program);
+
+    // Delete the base program and all of its variants
+    void DeletePrograms();
+
+    // Permutation helpers
+    static std::string GetPermutationDefines(unsigned int permutationKey);
+    static std::string InjectDefines(const std::string& code, const std::string& defines);
+    bool BuildVariant(unsigned int permutationKey);
+
+    // Program binary cache helpers
+    bool IsBinaryCacheSupported() const;
+    unsigned long long GetProgramCacheKey(const std::string& vertexCode, const std::string& fragmentCode) const;
+    std::string GetProgramCachePath(unsigned long long cacheKey) const;
+    GLuint LoadProgramBinary(unsigned long long cacheKey);
+    void SaveProgramBinary(unsigned long long cacheKey, GLuint program);
+
+    // Query all active uniforms of a linked program
+    void ReflectUniforms(PROGRAM_INFO& program);
+
+    // Record one reflected uniform (and its array elements) in the cache
+    void AddUniform(PROGRAM_INFO& program, const UNIFORM_INFO& info);
+
+    // Resolve the location of every registered handle slot in a program
+    void ResolveSlot(PROGRAM_INFO& program, int slot);
+
+    // Register a uniform name for handle access and return its slot
+    int RegisterUniformSlot(const std::string& name, GLenum type);
+
+    // Get the location behind a handle slot for the active program
+    GLint GetSlotLocation(int slot) const;
+
+    // Record a handle value and apply it to the active program variant
+    void SetSlotValue(int slot, const void* data, size_t size);
+    void ApplySlotValue(PROGRAM_INFO& program, int slot);
+    void ApplySlotValues(PROGRAM_INFO& program);
+
+    // Compare a value with the shadow copy; true when it must be uploaded
+    bool ShadowUniform(GLint location, const void* data, size_t size);
+
+    // Upload a value to a location unless the shadow copy already holds it
+    void UploadInt(GLint location, int value);
+    void UploadFloat(GLint location, float value);
+    void UploadVec2(GLint location, const glm::vec2& value);
+    void UploadVec3(GLint location, const glm::vec3& value);
+    void UploadVec4(GLint location, const glm::vec4& value);
+    void UploadMat4(GLint location, const glm::mat4& mat);
+};
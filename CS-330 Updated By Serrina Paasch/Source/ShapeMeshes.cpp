@@ -7,82 +7,890 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ShapeMeshes.h"
+#include "GLResources.h"
+
+#include <algorithm>
 #include <iostream>
-#include <glad/glad.h>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+// Declaration of global variables and defines
+namespace
+{
+    const float PI = 3.14159265358979f;
+
+    // Tessellation of the round meshes
+    const int RADIAL_SEGMENTS = 36;
+    const int TORUS_TUBE_SEGMENTS = 18;
+
+    const int SPHERE_STACKS = 18;
+
+    // Tessellation of the placeholder meshes drawn while the scene starts up
+    const int PLACEHOLDER_RADIAL_SEGMENTS = 8;
+    const int PLACEHOLDER_TUBE_SEGMENTS = 6;
+    const int PLACEHOLDER_SPHERE_STACKS = 6;
+
+    // Initial size of the shared instance and indirect buffers
+    const int INITIAL_INSTANCE_CAPACITY = 64;
+    const int INITIAL_COMMAND_CAPACITY = 64;
+
+    // Instance records per frame region of the persistent instance ring
+    const int INSTANCE_RING_CAPACITY = 4096;
+
+    const int VERTEX_FLOATS = ShapeMeshes::VERTEX_FLOATS;
+
+    // Vertex buffer binding indices of the shared vertex array
+    const GLuint VERTEX_BINDING = 0;
+    const GLuint INSTANCE_BINDING = 1;
+
+    // Per-vertex attributes: position, normal, texture coordinates
+    const GLResources::VERTEX_ATTRIBUTE VERTEX_ATTRIBUTES[] =
+    {
+        { 0, 3, 0 },
+        { 1, 3, 3 * sizeof(float) },
+        { 2, 2, 6 * sizeof(float) },
+    };
+
+    // Per-instance attributes: one location per model matrix column, params, color
+    const GLResources::VERTEX_ATTRIBUTE INSTANCE_ATTRIBUTES[] =
+    {
+        { 3, 4, offsetof(ShapeMeshes::INSTANCE_DATA, model) },
+        { 4, 4, offsetof(ShapeMeshes::INSTANCE_DATA, model) + sizeof(glm::vec4) },
+        { 5, 4, offsetof(ShapeMeshes::INSTANCE_DATA, model) + 2 * sizeof(glm::vec4) },
+        { 6, 4, offsetof(ShapeMeshes::INSTANCE_DATA, model) + 3 * sizeof(glm::vec4) },
+        { 7, 4, offsetof(ShapeMeshes::INSTANCE_DATA, params) },
+        { 8, 4, offsetof(ShapeMeshes::INSTANCE_DATA, color) },
+    };
+
+    void AddVertex(std::vector<float>& vertices,
+        float x, float y, float z,
+        float nx, float ny, float nz,
+        float u, float v)
+    {
+        const float vertex[VERTEX_FLOATS] = { x, y, z, nx, ny, nz, u, v };
+        vertices.insert(vertices.end(), vertex, vertex + VERTEX_FLOATS);
+    }
+
+    unsigned int VertexCount(const std::vector<float>& vertices)
+    {
+        return (unsigned int)(vertices.size() / VERTEX_FLOATS);
+    }
+
+    // Side of a (tapered) cylinder around the Y axis from y = 0 to y = height
+    void AddRoundSide(std::vector<float>& vertices, std::vector<unsigned int>& indices,
+        float bottomRadius, float topRadius, float height, int segments)
+    {
+        unsigned int first = VertexCount(vertices);
+
+        // The side normal leans up by the slope of the taper
+        float slope = bottomRadius - topRadius;
+        float normalLength = std::sqrt(height * height + slope * slope);
+        float normalXZ = height / normalLength;
+        float normalY = slope / normalLength;
+
+        for (int i = 0; i <= segments; i++)
+        {
+            float u = (float)i / segments;
+            float c = std::cos(u * 2.0f * PI);
+            float s = std::sin(u * 2.0f * PI);
+
+            AddVertex(vertices, bottomRadius * c, 0.0f, bottomRadius * s, normalXZ * c, normalY, normalXZ * s, u, 0.0f);
+            AddVertex(vertices, topRadius * c, height, topRadius * s, normalXZ * c, normalY, normalXZ * s, u, 1.0f);
+        }
+
+        for (unsigned int i = 0; i < (unsigned int)segments; i++)
+        {
+            unsigned int bottom = first + i * 2;
+            unsigned int top = bottom + 1;
+            unsigned int nextBottom = bottom + 2;
+            unsigned int nextTop = bottom + 3;
+
+            indices.insert(indices.end(), { bottom, top, nextTop, bottom, nextTop, nextBottom });
+        }
+    }
+
+    // Flat disc around the Y axis facing up or down
+    void AddDisc(std::vector<float>& vertices, std::vector<unsigned int>& indices,
+        float radius, float y, bool bFacingUp, int segments)
+    {
+        unsigned int center = VertexCount(vertices);
+        float normalY = bFacingUp ? 1.0f : -1.0f;
+
+        AddVertex(vertices, 0.0f, y, 0.0f, 0.0f, normalY, 0.0f, 0.5f, 0.5f);
+        for (int i = 0; i <= segments; i++)
+        {
+            float angle = (float)i / segments * 2.0f * PI;
+            float c = std::cos(angle);
+            float s = std::sin(angle);
+
+            AddVertex(vertices, radius * c, y, radius * s, 0.0f, normalY, 0.0f, 0.5f + 0.5f * c, 0.5f + 0.5f * s);
+        }
+
+        for (unsigned int i = 0; i < (unsigned int)segments; i++)
+        {
+            unsigned int current = center + 1 + i;
+            if (bFacingUp)
+                indices.insert(indices.end(), { center, current + 1, current });
+            else
+                indices.insert(indices.end(), { center, current, current + 1 });
+        }
+    }
+
+    // One face of the unit box; the u and v axes satisfy u x v = normal
+    void AddBoxFace(std::vector<float>& vertices, std::vector<unsigned int>& indices,
+        const float normal[3], const float uAxis[3], const float vAxis[3])
+    {
+        unsigned int first = VertexCount(vertices);
+        const float corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+
+        for (int i = 0; i < 4; i++)
+        {
+            float position[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                position[axis] = 0.5f * (normal[axis] + corners[i][0] * uAxis[axis] + corners[i][1] * vAxis[axis]);
+            }
+            AddVertex(vertices, position[0], position[1], position[2], normal[0], normal[1], normal[2],
+                0.5f + 0.5f * corners[i][0], 0.5f + 0.5f * corners[i][1]);
+        }
+
+        indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+    }
+}
 
 // Constructor: Initialize member variables
-ShapeMeshes::ShapeMeshes()
+ShapeMeshes::ShapeMeshes(GLStateCache* pStateCache, GpuMemoryTracker* pMemory)
 {
+    m_pStateCache = pStateCache;
+    m_pMemory = pMemory;
     m_VAO = 0;
     m_VBO = 0;
     m_EBO = 0;
+    m_geometryBytes = 0;
+    m_instanceBuffer = 0;
+    m_instanceCapacity = 0;
+    m_indirectBuffer = 0;
+    m_indirectCapacity = 0;
+    m_attributeInstanceBuffer = 0;
+    m_instanceBase = 0;
+    m_bGeometryDirty = false;
+    m_lastCreatedMesh = MESH_BOX;
+    SetDetail(DETAIL_FULL);
 }
 
 // Destructor: Cleanup the mesh data
 ShapeMeshes::~ShapeMeshes()
 {
-    if (m_VAO != 0)
+    TrackMemory(GL_ARRAY_BUFFER, 0, m_geometryBytes);
+    TrackMemory(GL_ARRAY_BUFFER, 0, (m_instanceBuffer != 0) ? (size_t)m_instanceCapacity : 0);
+    TrackMemory(GL_DRAW_INDIRECT_BUFFER, 0, (m_indirectBuffer != 0) ? (size_t)m_indirectCapacity : 0);
+
+    GLResources::DeleteVertexArray(*m_pStateCache, m_VAO);
+    GLResources::DeleteBuffer(*m_pStateCache, m_VBO);
+    GLResources::DeleteBuffer(*m_pStateCache, m_EBO);
+    GLResources::DeleteBuffer(*m_pStateCache, m_instanceBuffer);
+    GLResources::DeleteBuffer(*m_pStateCache, m_indirectBuffer);
+    m_instanceCapacity = 0;
+    m_indirectCapacity = 0;
+}
+
+/***********************************************************
+ *  SetDetail()
+ *
+ *  This method sets the tessellation of the round meshes
+ *  generated from now on.  Meshes already loaded keep theirs
+ *  until they are loaded again.
+ ***********************************************************/
+void ShapeMeshes::SetDetail(MESH_DETAIL detail)
+{
+    m_detail = detail;
+    bool bPlaceholder = (detail == DETAIL_PLACEHOLDER);
+    m_radialSegments = bPlaceholder ? PLACEHOLDER_RADIAL_SEGMENTS : RADIAL_SEGMENTS;
+    m_tubeSegments = bPlaceholder ? PLACEHOLDER_TUBE_SEGMENTS : TORUS_TUBE_SEGMENTS;
+    m_sphereStacks = bPlaceholder ? PLACEHOLDER_SPHERE_STACKS : SPHERE_STACKS;
+}
+
+/***********************************************************
+ *  LoadPlaneMesh()
+ *
+ *  This method generates a flat plane from -1 to 1 on the X
+ *  and Z axes, facing up.
+ ***********************************************************/
+void ShapeMeshes::LoadPlaneMesh()
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices = { 0, 3, 2, 0, 2, 1 };
+
+    AddVertex(vertices, -1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+    AddVertex(vertices, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f);
+    AddVertex(vertices, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f);
+    AddVertex(vertices, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+
+    StoreMesh(MESH_PLANE, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadBoxMesh()
+ *
+ *  This method generates a unit box centered on the origin
+ *  with separate vertices (normals and UVs) per face.
+ ***********************************************************/
+void ShapeMeshes::LoadBoxMesh()
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    const float faces[6][3][3] = {
+        // normal                  u axis                    v axis
+        { { 1.0f, 0.0f, 0.0f },  { 0.0f, 0.0f, -1.0f },  { 0.0f, 1.0f, 0.0f } },
+        { { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f },   { 0.0f, 1.0f, 0.0f } },
+        { { 0.0f, 1.0f, 0.0f },  { 1.0f, 0.0f, 0.0f },   { 0.0f, 0.0f, -1.0f } },
+        { { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f },   { 0.0f, 0.0f, 1.0f } },
+        { { 0.0f, 0.0f, 1.0f },  { 1.0f, 0.0f, 0.0f },   { 0.0f, 1.0f, 0.0f } },
+        { { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f },  { 0.0f, 1.0f, 0.0f } }
+    };
+
+    for (int i = 0; i < 6; i++)
     {
-        glDeleteVertexArrays(1, &m_VAO);
-        m_VAO = 0;
+        AddBoxFace(vertices, indices, faces[i][0], faces[i][1], faces[i][2]);
     }
-    if (m_VBO != 0)
+
+    StoreMesh(MESH_BOX, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadCylinderMesh()
+ *
+ *  This method generates a closed cylinder of radius 1 that
+ *  stands on the origin and is 1 unit tall.
+ ***********************************************************/
+void ShapeMeshes::LoadCylinderMesh()
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    AddRoundSide(vertices, indices, 1.0f, 1.0f, 1.0f, m_radialSegments);
+    AddDisc(vertices, indices, 1.0f, 1.0f, true, m_radialSegments);
+    AddDisc(vertices, indices, 1.0f, 0.0f, false, m_radialSegments);
+
+    StoreMesh(MESH_CYLINDER, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadConeMesh()
+ *
+ *  This method generates a cone of radius 1 that stands on
+ *  the origin and is 1 unit tall.
+ ***********************************************************/
+void ShapeMeshes::LoadConeMesh()
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    AddRoundSide(vertices, indices, 1.0f, 0.0f, 1.0f, m_radialSegments);
+    AddDisc(vertices, indices, 1.0f, 0.0f, false, m_radialSegments);
+
+    StoreMesh(MESH_CONE, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadTorusMesh()
+ *
+ *  This method generates a torus of radius 1 in the XY plane
+ *  with a tube of the given thickness.
+ ***********************************************************/
+void ShapeMeshes::LoadTorusMesh(float thickness)
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    for (int i = 0; i <= m_radialSegments; i++)
     {
-        glDeleteBuffers(1, &m_VBO);
-        m_VBO = 0;
+        float u = (float)i / m_radialSegments;
+        float cu = std::cos(u * 2.0f * PI);
+        float su = std::sin(u * 2.0f * PI);
+
+        for (int j = 0; j <= m_tubeSegments; j++)
+        {
+            float v = (float)j / m_tubeSegments;
+            float cv = std::cos(v * 2.0f * PI);
+            float sv = std::sin(v * 2.0f * PI);
+
+            float nx = cv * cu;
+            float ny = cv * su;
+            float nz = sv;
+            AddVertex(vertices, cu + thickness * nx, su + thickness * ny, thickness * nz, nx, ny, nz, u, v);
+        }
     }
-    if (m_EBO != 0)
+
+    const unsigned int ring = m_tubeSegments + 1;
+    for (unsigned int i = 0; i < (unsigned int)m_radialSegments; i++)
     {
-        glDeleteBuffers(1, &m_EBO);
-        m_EBO = 0;
+        for (unsigned int j = 0; j < (unsigned int)m_tubeSegments; j++)
+        {
+            unsigned int a = i * ring + j;
+            unsigned int b = (i + 1) * ring + j;
+            unsigned int c = b + 1;
+            unsigned int d = a + 1;
+
+            indices.insert(indices.end(), { a, b, c, a, c, d });
+        }
     }
+
+    StoreMesh(MESH_TORUS, vertices, indices);
 }
 
 /***********************************************************
- *  CreateCube()
+ *  LoadTaperedCylinderMesh()
  *
- *  This method generates and stores the vertex data for a cube.
+ *  This method generates a closed cylinder that narrows from
+ *  radius 1 at the base to radius 0.5 at the top, 1 unit tall.
  ***********************************************************/
-void ShapeMeshes::CreateCube()
+void ShapeMeshes::LoadTaperedCylinderMesh()
 {
-    // Define vertices and indices for a cube
-    float vertices[] = {
-        // Positions          // Normals           // Texture Coords
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
-        // Other faces...
-    };
-    unsigned int indices[] = {
-        0, 1, 2, 2, 3, 0, // Back face
-        // Other face indices...
-    };
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
 
-    // Generate and bind VAO, VBO, EBO
-    glGenVertexArrays(1, &m_VAO);
-    glGenBuffers(1, &m_VBO);
-    glGenBuffers(1, &m_EBO);
+    AddRoundSide(vertices, indices, 1.0f, 0.5f, 1.0f, m_radialSegments);
+    AddDisc(vertices, indices, 0.5f, 1.0f, true, m_radialSegments);
+    AddDisc(vertices, indices, 1.0f, 0.0f, false, m_radialSegments);
 
-    glBindVertexArray(m_VAO);
+    StoreMesh(MESH_TAPERED_CYLINDER, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadSphereMesh()
+ *
+ *  This method generates a UV sphere of radius 1 centered on
+ *  the origin.
+ ***********************************************************/
+void ShapeMeshes::LoadSphereMesh()
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    for (int stack = 0; stack <= m_sphereStacks; stack++)
+    {
+        float v = (float)stack / m_sphereStacks;
+        float polar = v * PI;
+        float y = std::cos(polar);
+        float ring = std::sin(polar);
+
+        for (int i = 0; i <= m_radialSegments; i++)
+        {
+            float u = (float)i / m_radialSegments;
+            float x = ring * std::cos(u * 2.0f * PI);
+            float z = ring * std::sin(u * 2.0f * PI);
+
+            AddVertex(vertices, x, y, z, x, y, z, u, 1.0f - v);
+        }
+    }
 
-    // Bind and set vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    const unsigned int ringVertices = m_radialSegments + 1;
+    for (unsigned int stack = 0; stack < (unsigned int)m_sphereStacks; stack++)
+    {
+        for (unsigned int i = 0; i < (unsigned int)m_radialSegments; i++)
+        {
+            unsigned int upper = stack * ringVertices + i;
+            unsigned int lower = upper + ringVertices;
 
-    // Bind and set index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+            indices.insert(indices.end(), { upper, upper + 1, lower + 1, upper, lower + 1, lower });
+        }
+    }
 
-    // Define the vertex attribute layout (position, normals, texture coords)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    StoreMesh(MESH_SPHERE, vertices, indices);
+}
 
-    glBindVertexArray(0); // Unbind VAO
+/***********************************************************
+ *  StoreMesh()
+ *
+ *  This method keeps the generated geometry of a mesh until
+ *  the shared buffers are (re)built on the next draw.
+ ***********************************************************/
+void ShapeMeshes::StoreMesh(MESH_TYPE mesh, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+    m_meshData[mesh].vertices.swap(vertices);
+    m_meshData[mesh].indices.swap(indices);
+    m_lastCreatedMesh = mesh;
+    m_bGeometryDirty = true;
+}
+
+/***********************************************************
+ *  UploadGeometry()
+ *
+ *  This method packs every loaded mesh back to back into the
+ *  shared vertex and index buffers and fills the descriptor
+ *  table.  Indices stay relative to their mesh; draws add the
+ *  base vertex of the descriptor.  The buffers get immutable
+ *  storage, so a change of the loaded meshes replaces them.
+ * Time Complexity: O(V + I) - Linear in the vertices and indices of all meshes
+ ***********************************************************/
+void ShapeMeshes::UploadGeometry()
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    GLint baseVertex = 0;
+    GLuint firstIndex = 0;
+    for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+    {
+        const MESH_DATA& data = m_meshData[mesh];
+        MESH_DESCRIPTOR& descriptor = m_descriptors[mesh];
+
+        descriptor.baseVertex = baseVertex;
+        descriptor.firstIndex = firstIndex;
+        descriptor.vertexCount = (GLsizei)VertexCount(data.vertices);
+        descriptor.indexCount = (GLsizei)data.indices.size();
+
+        vertices.insert(vertices.end(), data.vertices.begin(), data.vertices.end());
+        indices.insert(indices.end(), data.indices.begin(), data.indices.end());
+
+        baseVertex += descriptor.vertexCount;
+        firstIndex += descriptor.indexCount;
+    }
+
+    m_bGeometryDirty = false;
+
+    GLResources::DeleteBuffer(*m_pStateCache, m_VBO);
+    GLResources::DeleteBuffer(*m_pStateCache, m_EBO);
+    TrackMemory(GL_ARRAY_BUFFER, 0, m_geometryBytes);
+    m_geometryBytes = 0;
+    if (indices.empty())
+        return;
+
+    m_VBO = GLResources::CreateBuffer(*m_pStateCache, GL_ARRAY_BUFFER,
+        vertices.size() * sizeof(float), vertices.data(), 0);
+    m_EBO = GLResources::CreateBuffer(*m_pStateCache, GL_ELEMENT_ARRAY_BUFFER,
+        indices.size() * sizeof(unsigned int), indices.data(), 0);
+    m_geometryBytes = vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned int);
+    TrackMemory(GL_ARRAY_BUFFER, m_geometryBytes, 0);
+    SetupVertexAttributes();
+}
+
+/***********************************************************
+ *  SetupVertexAttributes()
+ *
+ *  This method points the vertex attributes of the shared
+ *  vertex array at the shared vertex buffer and the instance
+ *  buffer.  Shaders that do not declare the per-instance
+ *  attributes ignore them.
+ ***********************************************************/
+void ShapeMeshes::SetupVertexAttributes()
+{
+    if (m_VAO == 0)
+    {
+        m_VAO = GLResources::CreateVertexArray(*m_pStateCache);
+    }
+
+    GLResources::SetElementBuffer(*m_pStateCache, m_VAO, m_EBO);
+    GLResources::SetVertexBuffer(*m_pStateCache, m_VAO, VERTEX_BINDING, m_VBO, VERTEX_FLOATS * sizeof(float), 0,
+        VERTEX_ATTRIBUTES, sizeof(VERTEX_ATTRIBUTES) / sizeof(VERTEX_ATTRIBUTES[0]));
+
+    if (m_instanceBuffer == 0)
+    {
+        m_instanceCapacity = INITIAL_INSTANCE_CAPACITY * sizeof(INSTANCE_DATA);
+        GrowBuffer(GL_ARRAY_BUFFER, m_instanceBuffer, m_instanceCapacity, m_instanceCapacity);
+    }
+
+    m_attributeInstanceBuffer = 0;
+    PointInstanceAttributes(m_instanceBuffer);
+}
+
+/***********************************************************
+ *  PointInstanceAttributes()
+ *
+ *  This method points the per-instance attributes of the
+ *  shared vertex array at an instance buffer.  Nothing is
+ *  changed when they already read from that buffer.
+ ***********************************************************/
+void ShapeMeshes::PointInstanceAttributes(GLuint buffer)
+{
+    if (m_VAO == 0 || buffer == 0 || buffer == m_attributeInstanceBuffer)
+        return;
+
+    GLResources::SetVertexBuffer(*m_pStateCache, m_VAO, INSTANCE_BINDING, buffer, sizeof(INSTANCE_DATA), 1,
+        INSTANCE_ATTRIBUTES, sizeof(INSTANCE_ATTRIBUTES) / sizeof(INSTANCE_ATTRIBUTES[0]));
+
+    m_attributeInstanceBuffer = buffer;
+}
+
+/***********************************************************
+ *  GrowBuffer()
+ *
+ *  This method makes sure a dynamic buffer holds size bytes.
+ *  Immutable storage cannot be resized, so a buffer that is
+ *  too small is replaced by one of twice the capacity (or
+ *  more).  Returns true when the buffer was replaced.
+ ***********************************************************/
+bool ShapeMeshes::GrowBuffer(GLenum target, GLuint& buffer, GLsizeiptr& capacity, GLsizeiptr size)
+{
+    if (buffer != 0 && capacity >= size)
+        return false;
+
+    size_t oldCapacity = (buffer != 0) ? (size_t)capacity : 0;
+    while (capacity < size)
+    {
+        capacity *= 2;
+    }
+
+    GLResources::DeleteBuffer(*m_pStateCache, buffer);
+    buffer = GLResources::CreateBuffer(*m_pStateCache, target, capacity, NULL, GL_DYNAMIC_STORAGE_BIT);
+    TrackMemory(target, (buffer != 0) ? (size_t)capacity : 0, oldCapacity);
+    return true;
+}
+
+/***********************************************************
+ *  TrackMemory()
+ *
+ *  This method records buffer memory created and released in
+ *  the memory tracker, when there is one.
+ ***********************************************************/
+void ShapeMeshes::TrackMemory(GLenum target, size_t allocated, size_t freed)
+{
+    if (NULL == m_pMemory)
+        return;
+
+    GpuMemoryTracker::MEMORY_CATEGORY category = GpuMemoryTracker::GetBufferCategory(target);
+    m_pMemory->Free(category, freed);
+    m_pMemory->Allocate(category, allocated);
+}
+
+/***********************************************************
+ *  BindGeometry()
+ *
+ *  This method binds the shared vertex array for a draw,
+ *  uploading meshes loaded since the last draw first.  The
+ *  vertex array stays bound; every mesh draws from it.
+ ***********************************************************/
+bool ShapeMeshes::BindGeometry()
+{
+    if (m_bGeometryDirty)
+    {
+        UploadGeometry();
+    }
+
+    if (m_VAO == 0)
+        return false;
+
+    m_pStateCache->BindVertexArray(m_VAO);
+    return true;
+}
+
+/***********************************************************
+ *  GetMeshDescriptor()
+ *
+ *  This method gets the location of a mesh in the shared
+ *  buffers (an index count of 0 means it is not loaded).
+ ***********************************************************/
+const ShapeMeshes::MESH_DESCRIPTOR& ShapeMeshes::GetMeshDescriptor(MESH_TYPE mesh)
+{
+    if (m_bGeometryDirty)
+    {
+        UploadGeometry();
+    }
+    return m_descriptors[mesh];
+}
+
+/***********************************************************
+ *  MakeDrawCommand()
+ *
+ *  This method builds the indirect draw command for instances
+ *  of a mesh starting at an offset into the instance data.
+ ***********************************************************/
+ShapeMeshes::DRAW_COMMAND ShapeMeshes::MakeDrawCommand(MESH_TYPE mesh, int instanceCount, int baseInstance)
+{
+    const MESH_DESCRIPTOR& descriptor = GetMeshDescriptor(mesh);
+
+    DRAW_COMMAND command;
+    command.count = (GLuint)descriptor.indexCount;
+    command.instanceCount = (GLuint)instanceCount;
+    command.firstIndex = descriptor.firstIndex;
+    command.baseVertex = descriptor.baseVertex;
+    command.baseInstance = m_instanceBase + (GLuint)baseInstance;
+    return command;
+}
+
+/***********************************************************
+ *  SetInstanceData()
+ *
+ *  This method uploads the per-instance data for the next
+ *  instanced draws.  The buffer is invalidated on every upload
+ *  so the driver never waits for draws still reading the
+ *  previous contents.
+ ***********************************************************/
+void ShapeMeshes::SetInstanceData(const INSTANCE_DATA* instances, int count)
+{
+    if (m_instanceBuffer == 0 || count <= 0)
+        return;
+
+    GLsizeiptr size = count * sizeof(INSTANCE_DATA);
+
+    // Written straight into this frame's region of the persistent ring
+    GLintptr offset = 0;
+    void* pRecords = m_instanceRing.Allocate(size, sizeof(INSTANCE_DATA), offset);
+    if (pRecords != NULL)
+    {
+        memcpy(pRecords, instances, size);
+        m_instanceBase = (GLuint)(offset / sizeof(INSTANCE_DATA));
+        PointInstanceAttributes(m_instanceRing.GetBuffer());
+        return;
+    }
+
+    m_instanceBase = 0;
+    if (GrowBuffer(GL_ARRAY_BUFFER, m_instanceBuffer, m_instanceCapacity, size))
+    {
+        m_attributeInstanceBuffer = 0;
+    }
+    PointInstanceAttributes(m_instanceBuffer);
+
+    GLResources::InvalidateBuffer(m_instanceBuffer);
+    GLResources::UpdateBuffer(*m_pStateCache, GL_ARRAY_BUFFER, m_instanceBuffer, 0, size, instances);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method draws one object of a mesh from the shared
+ *  buffers with the index count of its descriptor.
+ ***********************************************************/
+void ShapeMeshes::DrawMesh(MESH_TYPE mesh)
+{
+    if (!BindGeometry())
+        return;
+
+    const MESH_DESCRIPTOR& descriptor = m_descriptors[mesh];
+    if (descriptor.indexCount == 0)
+        return;
+
+    glDrawElementsBaseVertex(GL_TRIANGLES, descriptor.indexCount, GL_UNSIGNED_INT,
+        (void*)(descriptor.firstIndex * sizeof(unsigned int)), descriptor.baseVertex);
+}
+
+/***********************************************************
+ *  DrawMeshInstanced()
+ *
+ *  This method draws count instances of a mesh in one draw
+ *  call, reading per-instance data from the instance buffer.
+ ***********************************************************/
+void ShapeMeshes::DrawMeshInstanced(MESH_TYPE mesh, int count)
+{
+    if (count <= 0 || !BindGeometry())
+        return;
+
+    const MESH_DESCRIPTOR& descriptor = m_descriptors[mesh];
+    if (descriptor.indexCount == 0)
+        return;
+
+    if (m_instanceBase != 0)
+    {
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, descriptor.indexCount, GL_UNSIGNED_INT,
+            (void*)(descriptor.firstIndex * sizeof(unsigned int)), count, descriptor.baseVertex, m_instanceBase);
+    }
+    else
+    {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, descriptor.indexCount, GL_UNSIGNED_INT,
+            (void*)(descriptor.firstIndex * sizeof(unsigned int)), count, descriptor.baseVertex);
+    }
+}
+
+/***********************************************************
+ *  IsMultiDrawIndirectSupported()
+ *
+ *  Indirect commands select their per-instance data through
+ *  baseInstance, which needs OpenGL 4.3 (or the equivalent
+ *  extensions); GL 3.3 drivers use the per-draw paths.
+ ***********************************************************/
+bool ShapeMeshes::IsMultiDrawIndirectSupported() const
+{
+    return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+}
+
+/***********************************************************
+ *  MultiDrawIndirect()
+ *
+ *  This method submits a list of draw commands against the
+ *  shared buffers with a single glMultiDrawElementsIndirect
+ *  call.  Each command picks its mesh through firstIndex and
+ *  baseVertex and its instances through baseInstance.
+ * Time Complexity: O(n) - Upload of n commands, one draw call
+ ***********************************************************/
+bool ShapeMeshes::MultiDrawIndirect(const DRAW_COMMAND* commands, int count)
+{
+    if (count <= 0)
+        return true;
+
+    if (!IsMultiDrawIndirectSupported() || !BindGeometry())
+        return false;
+
+    if (m_indirectBuffer == 0)
+    {
+        m_indirectCapacity = INITIAL_COMMAND_CAPACITY * sizeof(DRAW_COMMAND);
+    }
+
+    GLsizeiptr size = count * sizeof(DRAW_COMMAND);
+    GrowBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer, m_indirectCapacity, size);
+
+    GLResources::InvalidateBuffer(m_indirectBuffer);
+    GLResources::UpdateBuffer(*m_pStateCache, GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer, 0, size, commands);
+    m_pStateCache->BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, count, 0);
+
+    return true;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method starts a frame of instance data.  The
+ *  persistent instance ring is created on the first frame
+ *  when buffer storage and base instances are available and
+ *  moves on to its next region every frame.
+ ***********************************************************/
+void ShapeMeshes::BeginFrame()
+{
+    if (!m_instanceRing.IsCreated() && PersistentRingBuffer::IsSupported() && (GLEW_VERSION_4_2 || GLEW_ARB_base_instance))
+    {
+        m_instanceRing.Create(m_pStateCache, GL_ARRAY_BUFFER, INSTANCE_RING_CAPACITY * sizeof(INSTANCE_DATA), m_pMemory);
+    }
+
+    m_instanceRing.BeginFrame();
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method ends a frame of instance data so its ring
+ *  region is not overwritten while the GPU still reads it.
+ ***********************************************************/
+void ShapeMeshes::EndFrame()
+{
+    m_instanceRing.EndFrame();
+}
+
+/***********************************************************
+ *  IsMultiDrawIndirectCountSupported()
+ *
+ *  This method checks whether the number of indirect draws
+ *  can be read from a buffer (GL 4.6 or ARB_indirect_parameters).
+ ***********************************************************/
+bool ShapeMeshes::IsMultiDrawIndirectCountSupported() const
+{
+    return IsMultiDrawIndirectSupported() && (GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters);
+}
+
+/***********************************************************
+ *  MultiDrawIndirectCount()
+ *
+ *  This method draws commands that were written on the GPU.
+ *  The commands are read from commandBuffer at commandOffset
+ *  and the number of commands from countBuffer at countOffset,
+ *  so the CPU never learns how many draws were issued.
+ * Time Complexity: O(1) - One draw call, independent of the command count
+ ***********************************************************/
+bool ShapeMeshes::MultiDrawIndirectCount(GLuint commandBuffer, GLintptr commandOffset, GLuint countBuffer, GLintptr countOffset, int maxCount)
+{
+    if (maxCount <= 0)
+        return true;
+
+    if (!IsMultiDrawIndirectCountSupported() || !BindGeometry())
+        return false;
+
+    m_pStateCache->BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    m_pStateCache->BindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer);
+
+    if (GLEW_VERSION_4_6)
+        glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandOffset, countOffset, maxCount, 0);
+    else
+        glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandOffset, countOffset, maxCount, 0);
+
+    return true;
+}
+
+/***********************************************************
+ *  ReserveInstanceBuffer()
+ *
+ *  This method grows the instance buffer to hold count
+ *  records without uploading any, for instance data that is
+ *  written on the GPU.  Returns the buffer (0 on failure).
+ ***********************************************************/
+GLuint ShapeMeshes::ReserveInstanceBuffer(int count)
+{
+    if (!BindGeometry() || m_instanceBuffer == 0)
+        return 0;
+
+    // GPU-written records start at instance 0 of the plain instance buffer
+    m_instanceBase = 0;
+    if (GrowBuffer(GL_ARRAY_BUFFER, m_instanceBuffer, m_instanceCapacity, count * sizeof(INSTANCE_DATA)))
+    {
+        m_attributeInstanceBuffer = 0;
+    }
+    PointInstanceAttributes(m_instanceBuffer);
+
+    return m_instanceBuffer;
+}
+
+/***********************************************************
+ *  GetMeshBounds()
+ *
+ *  This method gets the bounding sphere of a mesh in model
+ *  space (xyz: center, w: radius), centered on the middle of
+ *  the mesh's axis-aligned bounds.
+ * Time Complexity: O(V) - Where V is the number of vertices of the mesh
+ ***********************************************************/
+glm::vec4 ShapeMeshes::GetMeshBounds(MESH_TYPE mesh) const
+{
+    const std::vector<float>& vertices = m_meshData[mesh].vertices;
+    if (vertices.empty())
+        return glm::vec4(0.0f);
+
+    glm::vec3 minimum(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 maximum = minimum;
+    for (size_t i = 0; i + VERTEX_FLOATS <= vertices.size(); i += VERTEX_FLOATS)
+    {
+        glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+        minimum = glm::min(minimum, position);
+        maximum = glm::max(maximum, position);
+    }
+
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    float radius = 0.0f;
+    for (size_t i = 0; i + VERTEX_FLOATS <= vertices.size(); i += VERTEX_FLOATS)
+    {
+        glm::vec3 offset = glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]) - center;
+        radius = std::max(radius, glm::length(offset));
+    }
+
+    return glm::vec4(center, radius);
+}
+
+// Draw one object of a basic shape
+void ShapeMeshes::DrawPlaneMesh() { DrawMesh(MESH_PLANE); }
+void ShapeMeshes::DrawBoxMesh() { DrawMesh(MESH_BOX); }
+void ShapeMeshes::DrawCylinderMesh() { DrawMesh(MESH_CYLINDER); }
+void ShapeMeshes::DrawConeMesh() { DrawMesh(MESH_CONE); }
+void ShapeMeshes::DrawTorusMesh() { DrawMesh(MESH_TORUS); }
+void ShapeMeshes::DrawTaperedCylinderMesh() { DrawMesh(MESH_TAPERED_CYLINDER); }
+void ShapeMeshes::DrawSphereMesh() { DrawMesh(MESH_SPHERE); }
+
+// Draw instances of a basic shape
+void ShapeMeshes::DrawPlaneMeshInstanced(int count) { DrawMeshInstanced(MESH_PLANE, count); }
+void ShapeMeshes::DrawBoxMeshInstanced(int count) { DrawMeshInstanced(MESH_BOX, count); }
+void ShapeMeshes::DrawCylinderMeshInstanced(int count) { DrawMeshInstanced(MESH_CYLINDER, count); }
+void ShapeMeshes::DrawConeMeshInstanced(int count) { DrawMeshInstanced(MESH_CONE, count); }
+void ShapeMeshes::DrawTorusMeshInstanced(int count) { DrawMeshInstanced(MESH_TORUS, count); }
+void ShapeMeshes::DrawTaperedCylinderMeshInstanced(int count) { DrawMeshInstanced(MESH_TAPERED_CYLINDER, count); }
+void ShapeMeshes::DrawSphereMeshInstanced(int count) { DrawMeshInstanced(MESH_SPHERE, count); }
+
+/***********************************************************
+ *  CreateCube()
+ *
+ *  This method generates and stores the vertex data for a cube.
+ ***********************************************************/
+void ShapeMeshes::CreateCube()
+{
+    LoadBoxMesh();
 }
 
 /***********************************************************
@@ -92,21 +900,16 @@ void ShapeMeshes::CreateCube()
  ***********************************************************/
 void ShapeMeshes::CreateSphere()
 {
-    // Implementation of sphere generation using appropriate algorithm (e.g., UV sphere)
-    // Similar setup to CreateCube() but different vertex data
+    LoadSphereMesh();
 }
 
 /***********************************************************
  *  RenderMesh()
  *
- *  Renders the currently stored shape mesh.
+ *  Renders the most recently created shape mesh, using the
+ *  index count recorded for it in the descriptor table.
  ***********************************************************/
 void ShapeMeshes::RenderMesh()
 {
-    if (m_VAO != 0)
-    {
-        glBindVertexArray(m_VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0); // 36 is for a cube; adjust accordingly for other shapes
-        glBindVertexArray(0);
-    }
+    DrawMesh(m_lastCreatedMesh);
 }
@@ -0,0 +1,238 @@
+///////////////////////////////////////////////////////////////////////////////
+// ShapeMeshes.h
+// =============
+// Manage the creation and rendering of different 3D shape meshes
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GLStateCache.h"
+#include "GLResources.h"
+#include "PersistentRingBuffer.h"
+#include "GpuMemoryTracker.h"
+
+#include <vector>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  ShapeMeshes
+ *
+ *  This class generates the basic 3D shape meshes and draws
+ *  them.  All meshes are suballocated from one shared vertex
+ *  buffer and one shared index buffer behind a single vertex
+ *  array; a descriptor table records where each mesh lives,
+ *  so any mix of meshes can be drawn without rebinding and a
+ *  whole list of draws can be submitted as one indirect call.
+ *
+ *  Per-instance records are written into a persistently
+ *  mapped ring buffer with one fenced region per frame in
+ *  flight; draws select their records through baseInstance.
+ *
+ *  Vertex attribute locations:
+ *    0      position
+ *    1      normal
+ *    2      texture coordinate
+ *    3-6    instance model matrix (one column per location)
+ *    7      instance parameters (xy: UV scale, z: material index, w: texture layer)
+ *    8      instance color
+ ***********************************************************/
+class ShapeMeshes
+{
+public:
+    // Constructor: Initialize member variables (binds go through pStateCache,
+    // buffer sizes are recorded in pMemory when given)
+    ShapeMeshes(GLStateCache* pStateCache, GpuMemoryTracker* pMemory = NULL);
+
+    // Destructor: Cleanup the mesh data
+    ~ShapeMeshes();
+
+    // Floats per interleaved vertex: position, normal, texture coordinate
+    static const int VERTEX_FLOATS = 8;
+
+    // Basic meshes held in the shared geometry buffer
+    enum MESH_TYPE
+    {
+        MESH_PLANE = 0,
+        MESH_CYLINDER,
+        MESH_CONE,
+        MESH_BOX,
+        MESH_TORUS,
+        MESH_TAPERED_CYLINDER,
+        MESH_SPHERE,
+        MESH_COUNT
+    };
+
+    // Structure to hold where a mesh lives in the shared buffers
+    struct MESH_DESCRIPTOR
+    {
+        GLint baseVertex = 0;        // First vertex of the mesh in the vertex buffer
+        GLuint firstIndex = 0;       // First index of the mesh in the index buffer
+        GLsizei indexCount = 0;      // Number of indices (0 = not loaded)
+        GLsizei vertexCount = 0;     // Number of vertices
+    };
+
+    // Layout of one glMultiDrawElementsIndirect command
+    struct DRAW_COMMAND
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Structure to hold the per-instance data of an instanced draw
+    struct INSTANCE_DATA
+    {
+        glm::mat4 model;             // Model transform
+        glm::vec4 params;            // xy: UV scale, z: material index, w: texture layer
+        glm::vec4 color;             // Solid color (untextured draws)
+    };
+
+    // Tessellation of the round meshes
+    enum MESH_DETAIL
+    {
+        DETAIL_PLACEHOLDER = 0,          // Few segments, drawn while the scene starts up
+        DETAIL_FULL
+    };
+
+    // Set the tessellation of the meshes loaded from now on
+    void SetDetail(MESH_DETAIL detail);
+    MESH_DETAIL GetDetail() const { return m_detail; }
+
+    // Generate the basic shape meshes
+    void LoadPlaneMesh();
+    void LoadBoxMesh();
+    void LoadCylinderMesh();
+    void LoadConeMesh();
+    void LoadTorusMesh(float thickness = 0.1f);
+    void LoadTaperedCylinderMesh();
+    void LoadSphereMesh();
+
+    // Get the location of a mesh in the shared buffers
+    const MESH_DESCRIPTOR& GetMeshDescriptor(MESH_TYPE mesh);
+
+    // Get the generated geometry of a mesh (indices relative to the mesh)
+    const std::vector<float>& GetMeshVertices(MESH_TYPE mesh) const { return m_meshData[mesh].vertices; }
+    const std::vector<unsigned int>& GetMeshIndices(MESH_TYPE mesh) const { return m_meshData[mesh].indices; }
+
+    // Build the indirect command that draws instances of a mesh
+    // (baseInstance counts from the records of the last SetInstanceData())
+    DRAW_COMMAND MakeDrawCommand(MESH_TYPE mesh, int instanceCount, int baseInstance);
+
+    // Draw one object of a mesh with the current model transform
+    void DrawMesh(MESH_TYPE mesh);
+
+    // Draw the first count instances of the current instance data
+    void DrawMeshInstanced(MESH_TYPE mesh, int count);
+
+    // True when draws can start at an instance offset (baseInstance)
+    bool IsMultiDrawIndirectSupported() const;
+
+    // Submit a list of draw commands with one glMultiDrawElementsIndirect call
+    bool MultiDrawIndirect(const DRAW_COMMAND* commands, int count);
+
+    // True when the draw count of indirect draws can come from a buffer
+    bool IsMultiDrawIndirectCountSupported() const;
+
+    // Draw GPU-written commands whose count is read from countBuffer
+    bool MultiDrawIndirectCount(GLuint commandBuffer, GLintptr commandOffset, GLuint countBuffer, GLintptr countOffset, int maxCount);
+
+    // Grow the instance buffer for GPU-written instance data
+    GLuint ReserveInstanceBuffer(int count);
+
+    // Get the model-space bounding sphere of a mesh (xyz: center, w: radius)
+    glm::vec4 GetMeshBounds(MESH_TYPE mesh) const;
+
+    // Upload the per-instance data for the next instanced draws
+    void SetInstanceData(const INSTANCE_DATA* instances, int count);
+
+    // Start and end a frame of instance data (fences the persistent ring)
+    void BeginFrame();
+    void EndFrame();
+
+    // True when instance data is written into the persistent ring
+    bool HasPersistentInstanceData() const { return m_instanceRing.IsCreated(); }
+
+    // Draw one object of a basic shape
+    void DrawPlaneMesh();
+    void DrawBoxMesh();
+    void DrawCylinderMesh();
+    void DrawConeMesh();
+    void DrawTorusMesh();
+    void DrawTaperedCylinderMesh();
+    void DrawSphereMesh();
+
+    // Draw instances of a basic shape
+    void DrawPlaneMeshInstanced(int count);
+    void DrawBoxMeshInstanced(int count);
+    void DrawCylinderMeshInstanced(int count);
+    void DrawConeMeshInstanced(int count);
+    void DrawTorusMeshInstanced(int count);
+    void DrawTaperedCylinderMeshInstanced(int count);
+    void DrawSphereMeshInstanced(int count);
+
+    // Generates and stores the vertex data for a cube
+    void CreateCube();
+
+    // Generates and stores the vertex data for a sphere
+    void CreateSphere();
+
+    // Renders the most recently created shape mesh
+    void RenderMesh();
+
+private:
+    // Structure to hold the generated geometry of one mesh
+    struct MESH_DATA
+    {
+        std::vector<float> vertices;         // Interleaved position, normal, texture coordinate
+        std::vector<unsigned int> indices;   // Triangle indices relative to the mesh
+    };
+
+    GLStateCache* m_pStateCache;         // Filters redundant binds
+    GpuMemoryTracker* m_pMemory;         // Records the buffer sizes (optional)
+    GLuint m_VAO;                        // Vertex array shared by all meshes
+    GLuint m_VBO;                        // Shared vertex buffer
+    GLuint m_EBO;                        // Shared index buffer
+    size_t m_geometryBytes;              // Size of the vertex and index buffers
+    GLuint m_instanceBuffer;             // Per-instance data shared by all meshes
+    GLsizeiptr m_instanceCapacity;       // Size of the instance buffer in bytes
+    GLuint m_indirectBuffer;             // Draw commands of MultiDrawIndirect()
+    GLsizeiptr m_indirectCapacity;       // Size of the indirect buffer in bytes
+    PersistentRingBuffer m_instanceRing; // Per-frame instance records, persistently mapped
+    GLuint m_attributeInstanceBuffer;    // Buffer the instance attributes read from
+    GLuint m_instanceBase;               // First record of the last SetInstanceData()
+
+    MESH_DATA m_meshData[MESH_COUNT];            // Generated geometry per mesh
+    MESH_DESCRIPTOR m_descriptors[MESH_COUNT];   // Location of each mesh in the shared buffers
+    bool m_bGeometryDirty;               // Meshes changed since the last upload
+    MESH_DETAIL m_detail;                // Tessellation of the meshes loaded next
+    int m_radialSegments;                // Segments around round meshes
+    int m_tubeSegments;                  // Segments around the tube of the torus
+    int m_sphereStacks;                  // Stacks from pole to pole of the sphere
+    MESH_TYPE m_lastCreatedMesh;         // Mesh drawn by RenderMesh()
+
+    // Keep the generated geometry of a mesh for the shared buffers
+    void StoreMesh(MESH_TYPE mesh, std::vector<float>& vertices, std::vector<unsigned int>& indices);
+
+    // Pack every loaded mesh into the shared buffers (once per change)
+    void UploadGeometry();
+
+    // Bind the shared vertex array, uploading pending geometry first
+    bool BindGeometry();
+
+    // Point the vertex attributes of the shared vertex array at the buffers
+    void SetupVertexAttributes();
+
+    // Point the per-instance attributes at an instance buffer
+    void PointInstanceAttributes(GLuint buffer);
+
+    // Record buffer memory created or released
+    void TrackMemory(GLenum target, size_t allocated, size_t freed);
+
+    // Replace a dynamic buffer by a larger one when size bytes do not fit
+    bool GrowBuffer(GLenum target, GLuint& buffer, GLsizeiptr& capacity, GLsizeiptr size);
+};
@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////
+// StaticBatcher.cpp
+// =================
+// Merge static objects that share a texture and material into batches
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StaticBatcher.h"
+#include "ShapeMeshes.h"
+#include "GLResources.h"
+
+#include <cmath>
+
+/***********************************************************
+ *  StaticBatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StaticBatcher::StaticBatcher()
+{
+    m_pResources = NULL;
+    m_VAO = 0;
+}
+
+/***********************************************************
+ *  ~StaticBatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StaticBatcher::~StaticBatcher()
+{
+    DestroyBuffers();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method removes all objects and batches.
+ ***********************************************************/
+void StaticBatcher::Clear()
+{
+    m_batchData.clear();
+    m_batchIndex.clear();
+    m_batches.clear();
+    DestroyBuffers();
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method transforms the geometry of one static object
+ *  into world space and appends it to the batch of its
+ *  texture and material.  Normals go through the inverse
+ *  transpose of the model matrix, as in the vertex shader.
+ * Time Complexity: O(V + I) - Linear in the vertices and indices of the mesh
+ ***********************************************************/
+void StaticBatcher::AddObject(
+    const std::vector<float>& vertices,
+    const std::vector<unsigned int>& indices,
+    const glm::mat4& model,
+    const glm::vec2& uvScale,
+    int textureLayer,
+    int materialIndex)
+{
+    std::pair<int, int> key(textureLayer, materialIndex);
+    auto found = m_batchIndex.find(key);
+    if (found == m_batchIndex.end())
+    {
+        BATCH_DATA batch;
+        batch.textureLayer = textureLayer;
+        batch.materialIndex = materialIndex;
+        batch.objectCount = 0;
+        m_batchData.push_back(batch);
+        found = m_batchIndex.insert(std::make_pair(key, m_batchData.size() - 1)).first;
+    }
+
+    BATCH_DATA& batch = m_batchData[found->second];
+    const int stride = ShapeMeshes::VERTEX_FLOATS;
+    unsigned int baseVertex = (unsigned int)(batch.vertices.size() / stride);
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+    batch.vertices.reserve(batch.vertices.size() + vertices.size());
+    for (size_t i = 0; i + stride <= vertices.size(); i += stride)
+    {
+        glm::vec4 position = model * glm::vec4(vertices[i], vertices[i + 1], vertices[i + 2], 1.0f);
+        glm::vec3 normal = normalMatrix * glm::vec3(vertices[i + 3], vertices[i + 4], vertices[i + 5]);
+
+        float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length > 0.0f)
+        {
+            normal = normal / length;
+        }
+
+        const float vertex[] = {
+            position.x, position.y, position.z,
+            normal.x, normal.y, normal.z,
+            vertices[i + 6] * uvScale.x, vertices[i + 7] * uvScale.y
+        };
+        batch.vertices.insert(batch.vertices.end(), vertex, vertex + stride);
+    }
+
+    batch.indices.reserve(batch.indices.size() + indices.size());
+    for (unsigned int index : indices)
+    {
+        batch.indices.push_back(baseVertex + index);
+    }
+
+    batch.objectCount++;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method packs all batches back to back into one vertex
+ *  and one index buffer.  Indices are made absolute so each
+ *  batch is a plain glDrawElements range.  The CPU copies are
+ *  released once uploaded.
+ * Time Complexity: O(V + I) - Linear in the merged vertices and indices
+ ***********************************************************/
+void StaticBatcher::Build(GpuResourceManager* pResources)
+{
+    DestroyBuffers();
+    m_pResources = pResources;
+    m_batches.clear();
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    const int stride = ShapeMeshes::VERTEX_FLOATS;
+
+    for (BATCH_DATA& data : m_batchData)
+    {
+        unsigned int baseVertex = (unsigned int)(vertices.size() / stride);
+
+        BATCH batch;
+        batch.textureLayer = data.textureLayer;
+        batch.materialIndex = data.materialIndex;
+        batch.firstIndex = (GLuint)indices.size();
+        batch.indexCount = (GLsizei)data.indices.size();
+        batch.objectCount = data.objectCount;
+        m_batches.push_back(batch);
+
+        vertices.insert(vertices.end(), data.vertices.begin(), data.vertices.end());
+        for (unsigned int index : data.indices)
+        {
+            indices.push_back(baseVertex + index);
+        }
+    }
+
+    m_batchData.clear();
+    m_batchIndex.clear();
+
+    if (indices.empty())
+        return;
+
+    // Immutable storage: the merged geometry never changes after the build
+    m_vertexBuffer = m_pResources->CreateBuffer("static batch vertices", GL_ARRAY_BUFFER,
+        vertices.size() * sizeof(float), vertices.data(), 0);
+    m_indexBuffer = m_pResources->CreateBuffer("static batch indices", GL_ELEMENT_ARRAY_BUFFER,
+        indices.size() * sizeof(unsigned int), indices.data(), 0);
+
+    const GLResources::VERTEX_ATTRIBUTE attributes[] =
+    {
+        { 0, 3, 0 },
+        { 1, 3, 3 * sizeof(float) },
+        { 2, 2, 6 * sizeof(float) },
+    };
+
+    GLStateCache& stateCache = m_pResources->GetStateCache();
+    m_VAO = GLResources::CreateVertexArray(stateCache);
+    GLResources::SetElementBuffer(stateCache, m_VAO, m_pResources->GetBuffer(m_indexBuffer));
+    GLResources::SetVertexBuffer(stateCache, m_VAO, 0, m_pResources->GetBuffer(m_vertexBuffer), stride * sizeof(float), 0, attributes, 3);
+}
+
+/***********************************************************
+ *  GetObjectCount()
+ *
+ *  This method gets the number of objects merged into all of
+ *  the built batches.
+ ***********************************************************/
+unsigned int StaticBatcher::GetObjectCount() const
+{
+    unsigned int objectCount = 0;
+    for (const BATCH& batch : m_batches)
+    {
+        objectCount += batch.objectCount;
+    }
+    return objectCount;
+}
+
+/***********************************************************
+ *  DrawBatch()
+ *
+ *  This method draws one batch.  The caller sets the texture
+ *  and material of the batch and an identity model transform.
+ ***********************************************************/
+void StaticBatcher::DrawBatch(size_t index)
+{
+    if (m_VAO == 0 || index >= m_batches.size())
+        return;
+
+    const BATCH& batch = m_batches[index];
+    m_pResources->GetStateCache().BindVertexArray(m_VAO);
+    glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT, (void*)(batch.firstIndex * sizeof(unsigned int)));
+}
+
+/***********************************************************
+ *  DestroyBuffers()
+ *
+ *  This method frees the GL objects of the merged geometry.
+ ***********************************************************/
+void StaticBatcher::DestroyBuffers()
+{
+    if (NULL == m_pResources)
+        return;
+
+    GLResources::DeleteVertexArray(m_pResources->GetStateCache(), m_VAO);
+    m_pResources->Release(m_vertexBuffer);
+    m_pResources->Release(m_indexBuffer);
+}
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// StaticBatcher.h
+// ===============
+// Merge static objects that share a texture and material into batches
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GpuResourceManager.h"
+
+#include <vector>
+#include <map>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  StaticBatcher
+ *
+ *  This class pre-transforms the vertices of static objects
+ *  into world space once and merges the objects that share a
+ *  texture and material into one batch.  Every batch is drawn
+ *  with a single draw call and an identity model transform;
+ *  the UV scale of each object is baked into its texture
+ *  coordinates.
+ *
+ *  Vertices use the ShapeMeshes layout (position, normal,
+ *  texture coordinate at attribute locations 0, 1 and 2).
+ ***********************************************************/
+class StaticBatcher
+{
+public:
+    // Constructor: Initialize member variables
+    StaticBatcher();
+
+    // Destructor: Cleanup the batch buffers
+    ~StaticBatcher();
+
+    // Structure to hold the draw range and shader state of one batch
+    struct BATCH
+    {
+        int textureLayer;            // Texture array layer, -1 = solid color
+        int materialIndex;           // Material buffer index, -1 = none
+        GLuint firstIndex;           // First index of the batch in the index buffer
+        GLsizei indexCount;          // Number of indices of the batch
+        unsigned int objectCount;    // Number of objects merged into the batch
+    };
+
+    // Remove all objects and batches
+    void Clear();
+
+    // Add one static object from its mesh geometry and world transform
+    void AddObject(
+        const std::vector<float>& vertices,
+        const std::vector<unsigned int>& indices,
+        const glm::mat4& model,
+        const glm::vec2& uvScale,
+        int textureLayer,
+        int materialIndex);
+
+    // Upload the merged geometry of all batches into buffers owned by pResources
+    void Build(GpuResourceManager* pResources);
+
+    // Access the built batches
+    size_t GetBatchCount() const { return m_batches.size(); }
+    const BATCH& GetBatch(size_t index) const { return m_batches[index]; }
+
+    // Get the number of objects merged into all batches
+    unsigned int GetObjectCount() const;
+
+    // Draw one batch with a single draw call
+    void DrawBatch(size_t index);
+
+private:
+    // Structure to hold the world-space geometry of a batch being built
+    struct BATCH_DATA
+    {
+        int textureLayer;
+        int materialIndex;
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        unsigned int objectCount;
+    };
+
+    GpuResourceManager* m_pResources;    // Owner of the merged buffers
+    GLuint m_VAO;                        // Vertex array of the merged geometry
+    GpuResourceManager::BUFFER_HANDLE m_vertexBuffer;  // Merged vertex buffer
+    GpuResourceManager::BUFFER_HANDLE m_indexBuffer;   // Merged index buffer
+    std::vector<BATCH_DATA> m_batchData;                 // Batches being built
+    std::map<std::pair<int, int>, size_t> m_batchIndex;  // (texture, material) -> batch
+    std::vector<BATCH> m_batches;        // Built batches
+
+    // Free the GL objects of the merged geometry
+    void DestroyBuffers();
+};
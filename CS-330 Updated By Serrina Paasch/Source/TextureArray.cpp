@@ -0,0 +1,611 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureArray.cpp
+// ================
+// Pack same-sized textures into the layers of one 2D texture array
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureArray.h"
+#include "GLResources.h"
+#include "BlockCompressor.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Channels of every layer (RGBA8)
+    const int LAYER_CHANNELS = 4;
+
+    // One source texel contributing to a resampled texel
+    struct TAP
+    {
+        int index;
+        float weight;
+    };
+
+    /***********************************************************
+     *  MakeTaps()
+     *
+     *  Build the filter taps that resample one axis of
+     *  sourceLength texels to targetLength texels.  The tent
+     *  filter widens with the reduction, so shrinking averages
+     *  every source texel and enlarging interpolates linearly.
+     *  Indices wrap around because the layers are sampled with
+     *  GL_REPEAT.
+     ***********************************************************/
+    std::vector<std::vector<TAP> > MakeTaps(int sourceLength, int targetLength)
+    {
+        std::vector<std::vector<TAP> > taps(targetLength);
+        float scale = (float)sourceLength / (float)targetLength;
+        float radius = (scale > 1.0f) ? scale : 1.0f;
+
+        for (int i = 0; i < targetLength; i++)
+        {
+            float center = ((float)i + 0.5f) * scale - 0.5f;
+            int first = (int)std::ceil(center - radius);
+            int last = (int)std::floor(center + radius);
+            float total = 0.0f;
+
+            for (int s = first; s <= last; s++)
+            {
+                float weight = 1.0f - std::fabs((float)s - center) / radius;
+                if (weight <= 0.0f)
+                    continue;
+
+                TAP tap;
+                tap.index = ((s % sourceLength) + sourceLength) % sourceLength;
+                tap.weight = weight;
+                taps[i].push_back(tap);
+                total += weight;
+            }
+
+            for (TAP& tap : taps[i])
+            {
+                tap.weight /= total;
+            }
+        }
+
+        return taps;
+    }
+
+    // Expand one texel of a 1 to 4 channel image to RGBA
+    void ReadTexel(const unsigned char* pTexel, int channels, float rgba[LAYER_CHANNELS])
+    {
+        switch (channels)
+        {
+        case 1:
+            rgba[0] = rgba[1] = rgba[2] = pTexel[0];
+            rgba[3] = 255.0f;
+            break;
+        case 2:
+            rgba[0] = rgba[1] = rgba[2] = pTexel[0];
+            rgba[3] = pTexel[1];
+            break;
+        case 3:
+            rgba[0] = pTexel[0];
+            rgba[1] = pTexel[1];
+            rgba[2] = pTexel[2];
+            rgba[3] = 255.0f;
+            break;
+        default:
+            rgba[0] = pTexel[0];
+            rgba[1] = pTexel[1];
+            rgba[2] = pTexel[2];
+            rgba[3] = pTexel[3];
+            break;
+        }
+    }
+
+    // Neutral grey shown by layers whose pixels have not arrived yet
+    const unsigned char PENDING_LAYER_COLOR[LAYER_CHANNELS] = { 128, 128, 128, 255 };
+}
+
+/***********************************************************
+ *  TextureArray()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureArray::TextureArray()
+{
+    m_pResources = NULL;
+    m_width = 0;
+    m_height = 0;
+    m_capacity = 0;
+    m_layerCount = 0;
+    m_levelCount = 0;
+    m_internalFormat = GL_RGBA8;
+    m_residentBaseLevel = 0;
+    m_sampledBaseLevel = -1;
+}
+
+/***********************************************************
+ *  ~TextureArray()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureArray::~TextureArray()
+{
+    Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method creates immutable storage for layerCount
+ *  layers of width x height texels, holding the mip levels
+ *  from residentBaseLevel down to 1x1.  The size and the
+ *  number of layers are clamped to the limits of the driver.
+ ***********************************************************/
+bool TextureArray::Create(GpuResourceManager* pResources, const std::string& label, GLsizei width, GLsizei height, GLsizei layerCount,
+    GLenum internalFormat, GLint residentBaseLevel)
+{
+    Destroy();
+
+    if (NULL == pResources || width <= 0 || height <= 0 || layerCount <= 0)
+        return false;
+
+    GLint maxSize = 0;
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    if (maxSize > 0)
+    {
+        width = (width < maxSize) ? width : maxSize;
+        height = (height < maxSize) ? height : maxSize;
+    }
+    if (maxLayers > 0 && layerCount > maxLayers)
+    {
+        std::cerr << "ERROR::TEXTURE::TOO_MANY_LAYERS: " << label << " (" << layerCount
+            << " requested, " << maxLayers << " supported)" << std::endl;
+        layerCount = maxLayers;
+    }
+
+    m_pResources = pResources;
+    m_width = width;
+    m_height = height;
+    m_capacity = layerCount;
+    m_layerCount = 0;
+    m_levelCount = GLResources::GetMipLevelCount(width, height);
+    m_internalFormat = internalFormat;
+    m_label = label;
+
+    residentBaseLevel = (residentBaseLevel < 0) ? 0 : residentBaseLevel;
+    residentBaseLevel = (residentBaseLevel < m_levelCount) ? residentBaseLevel : m_levelCount - 1;
+    m_texture = CreateStorage(residentBaseLevel);
+    m_residentBaseLevel = residentBaseLevel;
+    m_sampledBaseLevel = -1;
+
+    if (GetTexture() == 0)
+    {
+        Destroy();
+        return false;
+    }
+    return true;
+}
+
+/***********************************************************
+ *  Reallocate()
+ *
+ *  This method replaces the storage of the array with one
+ *  holding the levels from residentBaseLevel down.  Where
+ *  images can be copied on the GPU the levels both storages
+ *  hold move over; the loader fills the rest.  The old
+ *  storage is released once the GPU is done with it.
+ *  Returns false when the storage was not replaced.
+ ***********************************************************/
+bool TextureArray::Reallocate(GLint residentBaseLevel, bool& bKeptLevels)
+{
+    bKeptLevels = false;
+    if (GetTexture() == 0)
+        return false;
+
+    residentBaseLevel = (residentBaseLevel < 0) ? 0 : residentBaseLevel;
+    residentBaseLevel = (residentBaseLevel < m_levelCount) ? residentBaseLevel : m_levelCount - 1;
+    if (residentBaseLevel == m_residentBaseLevel)
+        return false;
+
+    GpuResourceManager::TEXTURE_HANDLE storage = CreateStorage(residentBaseLevel);
+    GLuint texture = m_pResources->GetTexture(storage);
+    if (texture == 0)
+        return false;
+
+    if ((GLEW_VERSION_4_3 || GLEW_ARB_copy_image) && m_layerCount > 0)
+    {
+        GLint firstLevel = (residentBaseLevel > m_residentBaseLevel) ? residentBaseLevel : m_residentBaseLevel;
+        for (GLint level = firstLevel; level < m_levelCount; level++)
+        {
+            GLsizei width = 0;
+            GLsizei height = 0;
+            size_t offset = 0;
+            GetLevelLayout(m_width, m_height, level, width, height, offset);
+            glCopyImageSubData(GetTexture(), GL_TEXTURE_2D_ARRAY, level - m_residentBaseLevel, 0, 0, 0,
+                texture, GL_TEXTURE_2D_ARRAY, level - residentBaseLevel, 0, 0, 0, width, height, m_layerCount);
+        }
+        bKeptLevels = true;
+    }
+
+    m_pResources->Release(m_texture);
+    m_texture = storage;
+    m_residentBaseLevel = residentBaseLevel;
+    m_sampledBaseLevel = -1;
+
+    GLsizei width = 0;
+    GLsizei height = 0;
+    size_t offset = 0;
+    GetLevelLayout(m_width, m_height, residentBaseLevel, width, height, offset);
+    std::cout << "Texture streaming: " << m_label << " resident from mip " << residentBaseLevel << " (" << width << "x" << height
+        << ", " << (double)GetResidentSize() / (1024.0 * 1024.0) << " MB)" << std::endl;
+    return true;
+}
+
+/***********************************************************
+ *  SetSampledBaseLevel()
+ *
+ *  This method sets GL_TEXTURE_BASE_LEVEL so sampling never
+ *  reaches levels finer than level, which are not uploaded
+ *  for every layer yet.
+ ***********************************************************/
+void TextureArray::SetSampledBaseLevel(GLint level)
+{
+    if (GetTexture() == 0)
+        return;
+
+    level = (level > m_residentBaseLevel) ? level : m_residentBaseLevel;
+    level = (level < m_levelCount) ? level : m_levelCount - 1;
+    if (level == m_sampledBaseLevel)
+        return;
+
+    GLResources::SetTextureParameter(m_pResources->GetStateCache(), GL_TEXTURE_2D_ARRAY, GetTexture(),
+        GL_TEXTURE_BASE_LEVEL, level - m_residentBaseLevel);
+    m_sampledBaseLevel = level;
+}
+
+/***********************************************************
+ *  GetResidentSize()
+ *
+ *  These methods get the bytes of every resident level of
+ *  every layer of the storage, either the current one or one
+ *  holding the levels from residentBaseLevel down.
+ ***********************************************************/
+size_t TextureArray::GetResidentSize() const
+{
+    return GetResidentSize(m_residentBaseLevel);
+}
+
+size_t TextureArray::GetResidentSize(GLint residentBaseLevel) const
+{
+    size_t size = 0;
+    for (GLint level = residentBaseLevel; level < m_levelCount; level++)
+    {
+        size += GetLevelSize(m_internalFormat, m_width, m_height, level);
+    }
+    return size * (size_t)m_capacity;
+}
+
+/***********************************************************
+ *  ReserveLayer()
+ *
+ *  This method hands out the next free layer.  Its pixels are
+ *  uploaded later with UploadLayerLevel().
+ ***********************************************************/
+int TextureArray::ReserveLayer()
+{
+    if (GetTexture() == 0)
+        return -1;
+
+    if (m_layerCount >= m_capacity)
+    {
+        std::cerr << "ERROR::TEXTURE::NO_FREE_LAYER: " << m_capacity << " layers in use" << std::endl;
+        return -1;
+    }
+
+    return (int)m_layerCount++;
+}
+
+/***********************************************************
+ *  UploadLayerLevel()
+ *
+ *  This method writes one whole mip level of a layer, either
+ *  RGBA8 pixels laid out as by MakeLayerImage() or the blocks
+ *  of the compressed format.
+ ***********************************************************/
+void TextureArray::UploadLayerLevel(int layer, GLint level, const void* pData)
+{
+    if (GetTexture() == 0 || layer < 0 || layer >= (int)m_layerCount || level < m_residentBaseLevel || level >= (GLint)m_levelCount)
+        return;
+
+    GLsizei width = 0;
+    GLsizei height = 0;
+    size_t offset = 0;
+    GetLevelLayout(m_width, m_height, level, width, height, offset);
+
+    if (IsCompressedFormat(m_internalFormat))
+    {
+        GLResources::UploadCompressedTextureLayer(m_pResources->GetStateCache(), GetTexture(), level - m_residentBaseLevel, layer, width, height,
+            m_internalFormat, (GLsizei)GetLevelSize(m_internalFormat, m_width, m_height, level), pData);
+        return;
+    }
+
+    GLResources::UploadTextureLayer(m_pResources->GetStateCache(), GetTexture(), level - m_residentBaseLevel, layer, width, height,
+        GL_RGBA, GL_UNSIGNED_BYTE, pData);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method binds the array to a texture unit.
+ ***********************************************************/
+void TextureArray::Bind(GLuint unit) const
+{
+    if (NULL != m_pResources)
+    {
+        m_pResources->GetStateCache().BindTextureUnit(unit, GL_TEXTURE_2D_ARRAY, GetTexture());
+    }
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method releases the texture.
+ ***********************************************************/
+void TextureArray::Destroy()
+{
+    if (NULL != m_pResources)
+    {
+        m_pResources->Release(m_texture);
+    }
+
+    m_pResources = NULL;
+    m_width = 0;
+    m_height = 0;
+    m_capacity = 0;
+    m_layerCount = 0;
+    m_levelCount = 0;
+    m_internalFormat = GL_RGBA8;
+    m_residentBaseLevel = 0;
+    m_sampledBaseLevel = -1;
+    m_label.clear();
+}
+
+/***********************************************************
+ *  CreateStorage()
+ *
+ *  This method creates immutable storage for the levels from
+ *  residentBaseLevel down and sets its wrapping and filtering.
+ *  Where textures can be cleared every uncompressed level
+ *  starts out grey until its pixels are uploaded.  Otherwise
+ *  only the 1x1 level gets a grey placeholder per layer: it
+ *  is the only level sampled until every layer has arrived.
+ ***********************************************************/
+GpuResourceManager::TEXTURE_HANDLE TextureArray::CreateStorage(GLint residentBaseLevel)
+{
+    GLsizei width = 0;
+    GLsizei height = 0;
+    size_t offset = 0;
+    GetLevelLayout(m_width, m_height, residentBaseLevel, width, height, offset);
+    GLsizei levelCount = m_levelCount - residentBaseLevel;
+
+    GpuResourceManager::TEXTURE_HANDLE storage = m_pResources->CreateTexture2DArray(m_label, levelCount, m_internalFormat,
+        width, height, m_capacity);
+    GLuint texture = m_pResources->GetTexture(storage);
+    if (texture == 0)
+        return storage;
+
+    // Set the texture wrapping and filtering parameters
+    GLStateCache& stateCache = m_pResources->GetStateCache();
+    GLResources::SetTextureParameter(stateCache, GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    GLResources::SetTextureParameter(stateCache, GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    GLResources::SetTextureParameter(stateCache, GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    GLResources::SetTextureParameter(stateCache, GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GLResources::SetTextureParameter(stateCache, GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+    if ((GLEW_VERSION_4_4 || GLEW_ARB_clear_texture) && !IsCompressedFormat(m_internalFormat))
+    {
+        for (GLint level = 0; level < levelCount; level++)
+        {
+            glClearTexImage(texture, level, GL_RGBA, GL_UNSIGNED_BYTE, PENDING_LAYER_COLOR);
+        }
+        return storage;
+    }
+
+    // The placeholder is read from client memory
+    stateCache.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    std::vector<unsigned char> placeholder;
+    if (IsCompressedFormat(m_internalFormat))
+    {
+        unsigned char block[16][LAYER_CHANNELS];
+        for (int texel = 0; texel < 16; texel++)
+        {
+            memcpy(block[texel], PENDING_LAYER_COLOR, LAYER_CHANNELS);
+        }
+        BlockCompressor::Compress(m_internalFormat, &block[0][0], 4, 4, placeholder);
+    }
+    else
+    {
+        placeholder.assign(PENDING_LAYER_COLOR, PENDING_LAYER_COLOR + LAYER_CHANNELS);
+    }
+
+    for (GLsizei layer = 0; layer < m_capacity; layer++)
+    {
+        if (IsCompressedFormat(m_internalFormat))
+        {
+            GLResources::UploadCompressedTextureLayer(stateCache, texture, levelCount - 1, layer, 1, 1,
+                m_internalFormat, (GLsizei)placeholder.size(), placeholder.data());
+        }
+        else
+        {
+            GLResources::UploadTextureLayer(stateCache, texture, levelCount - 1, layer, 1, 1,
+                GL_RGBA, GL_UNSIGNED_BYTE, placeholder.data());
+        }
+    }
+
+    return storage;
+}
+
+/***********************************************************
+ *  GetTexture()
+ *
+ *  This method gets the GL texture of the array.
+ ***********************************************************/
+GLuint TextureArray::GetTexture() const
+{
+    return (NULL != m_pResources) ? m_pResources->GetTexture(m_texture) : 0;
+}
+
+/***********************************************************
+ *  MakeLayerImage()
+ *
+ *  This method resamples an image to the layer size in two
+ *  passes, rows first and then columns, and appends every
+ *  lower mip level, each a 2x2 box filter of the one above.
+ * Time Complexity: O(w * h + W * H) - Source and layer texels
+ ***********************************************************/
+bool TextureArray::MakeLayerImage(const unsigned char* pPixels, int width, int height, int channels,
+    GLsizei layerWidth, GLsizei layerHeight, std::vector<unsigned char>& levels)
+{
+    if (NULL == pPixels || width <= 0 || height <= 0 || channels < 1 || channels > 4 || layerWidth <= 0 || layerHeight <= 0)
+        return false;
+
+    std::vector<std::vector<TAP> > columnTaps = MakeTaps(width, (int)layerWidth);
+    std::vector<std::vector<TAP> > rowTaps = MakeTaps(height, (int)layerHeight);
+
+    // Rows: width x height source texels -> layerWidth x height
+    std::vector<float> resampledRows((size_t)layerWidth * height * LAYER_CHANNELS, 0.0f);
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* pRow = pPixels + (size_t)y * width * channels;
+        float* pTarget = &resampledRows[(size_t)y * layerWidth * LAYER_CHANNELS];
+
+        for (int x = 0; x < (int)layerWidth; x++)
+        {
+            float* pTexel = pTarget + (size_t)x * LAYER_CHANNELS;
+            for (const TAP& tap : columnTaps[x])
+            {
+                float rgba[LAYER_CHANNELS];
+                ReadTexel(pRow + (size_t)tap.index * channels, channels, rgba);
+                for (int c = 0; c < LAYER_CHANNELS; c++)
+                {
+                    pTexel[c] += rgba[c] * tap.weight;
+                }
+            }
+        }
+    }
+
+    // Size the whole mip chain up front
+    GLsizei levelWidth = layerWidth;
+    GLsizei levelHeight = layerHeight;
+    size_t totalSize = 0;
+    GLint levelCount = GLResources::GetMipLevelCount(layerWidth, layerHeight);
+    for (GLint level = 0; level < levelCount; level++)
+    {
+        GetLevelLayout(layerWidth, layerHeight, level, levelWidth, levelHeight, totalSize);
+    }
+    totalSize += (size_t)levelWidth * levelHeight * LAYER_CHANNELS;
+    levels.resize(totalSize);
+
+    // Columns: layerWidth x height -> layerWidth x layerHeight (level 0)
+    for (int y = 0; y < (int)layerHeight; y++)
+    {
+        unsigned char* pTarget = &levels[(size_t)y * layerWidth * LAYER_CHANNELS];
+
+        for (int x = 0; x < (int)layerWidth * LAYER_CHANNELS; x++)
+        {
+            float value = 0.0f;
+            for (const TAP& tap : rowTaps[y])
+            {
+                value += resampledRows[(size_t)tap.index * layerWidth * LAYER_CHANNELS + x] * tap.weight;
+            }
+            value = (value < 0.0f) ? 0.0f : ((value > 255.0f) ? 255.0f : value);
+            pTarget[x] = (unsigned char)(value + 0.5f);
+        }
+    }
+
+    // Lower levels: average 2x2 texels of the level above
+    for (GLint level = 1; level < levelCount; level++)
+    {
+        GLsizei sourceWidth, sourceHeight, targetWidth, targetHeight;
+        size_t sourceOffset, targetOffset;
+        GetLevelLayout(layerWidth, layerHeight, level - 1, sourceWidth, sourceHeight, sourceOffset);
+        GetLevelLayout(layerWidth, layerHeight, level, targetWidth, targetHeight, targetOffset);
+
+        const unsigned char* pSource = &levels[sourceOffset];
+        unsigned char* pTarget = &levels[targetOffset];
+        for (int y = 0; y < (int)targetHeight; y++)
+        {
+            int y0 = (2 * y < (int)sourceHeight) ? 2 * y : (int)sourceHeight - 1;
+            int y1 = (2 * y + 1 < (int)sourceHeight) ? 2 * y + 1 : y0;
+            for (int x = 0; x < (int)targetWidth; x++)
+            {
+                int x0 = (2 * x < (int)sourceWidth) ? 2 * x : (int)sourceWidth - 1;
+                int x1 = (2 * x + 1 < (int)sourceWidth) ? 2 * x + 1 : x0;
+                for (int c = 0; c < LAYER_CHANNELS; c++)
+                {
+                    int sum = pSource[((size_t)y0 * sourceWidth + x0) * LAYER_CHANNELS + c] +
+                        pSource[((size_t)y0 * sourceWidth + x1) * LAYER_CHANNELS + c] +
+                        pSource[((size_t)y1 * sourceWidth + x0) * LAYER_CHANNELS + c] +
+                        pSource[((size_t)y1 * sourceWidth + x1) * LAYER_CHANNELS + c];
+                    pTarget[((size_t)y * targetWidth + x) * LAYER_CHANNELS + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/***********************************************************
+ *  GetLevelLayout()
+ *
+ *  This method gets the size of a mip level of a layer and
+ *  where it starts in an image made by MakeLayerImage().
+ ***********************************************************/
+void TextureArray::GetLevelLayout(GLsizei layerWidth, GLsizei layerHeight, GLint level,
+    GLsizei& width, GLsizei& height, size_t& offset)
+{
+    width = layerWidth;
+    height = layerHeight;
+    offset = 0;
+
+    for (GLint i = 0; i < level; i++)
+    {
+        offset += (size_t)width * height * LAYER_CHANNELS;
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+}
+
+/***********************************************************
+ *  GetLevelSize()
+ *
+ *  This method gets the bytes of one mip level of a layer,
+ *  whole 4x4 blocks for the compressed formats.
+ ***********************************************************/
+size_t TextureArray::GetLevelSize(GLenum internalFormat, GLsizei layerWidth, GLsizei layerHeight, GLint level)
+{
+    GLsizei width = 0;
+    GLsizei height = 0;
+    size_t offset = 0;
+    GetLevelLayout(layerWidth, layerHeight, level, width, height, offset);
+
+    if (IsCompressedFormat(internalFormat))
+        return BlockCompressor::GetCompressedSize(internalFormat, width, height);
+
+    return (size_t)width * height * LAYER_CHANNELS;
+}
+
+/***********************************************************
+ *  IsCompressedFormat()
+ *
+ *  This method checks whether an internal format stores
+ *  blocks rather than texels.
+ ***********************************************************/
+bool TextureArray::IsCompressedFormat(GLenum internalFormat)
+{
+    return BlockCompressor::IsSupportedFormat(internalFormat);
+}
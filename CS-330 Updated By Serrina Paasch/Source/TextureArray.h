@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureArray.h
+// ==============
+// Pack same-sized textures into the layers of one 2D texture array
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GpuResourceManager.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureArray
+ *
+ *  This class keeps many textures in the layers of a single
+ *  GL_TEXTURE_2D_ARRAY, so the scene binds one texture once
+ *  and every draw selects its image by layer index instead of
+ *  by texture unit.  Draws with different textures can then
+ *  share one instanced or indirect draw call.
+ *
+ *  Every layer has the same size and internal format, RGBA8
+ *  or a block-compressed format (BC1 / BC3) that takes 4 to
+ *  8 times less memory and bandwidth.  Images of another size
+ *  are resampled to the layer size on the CPU and images with
+ *  1 to 3 channels are expanded to RGBA.  The number of
+ *  layers is fixed when the array is created.
+ *
+ *  Layers are reserved first and filled later, one mip level
+ *  at a time, so the pixels can be prepared on worker threads
+ *  with MakeLayerImage() and uploaded as they arrive.
+ *
+ *  Mip levels are always numbered from the full layer size,
+ *  but the storage only holds the levels from the resident
+ *  base level down.  Reallocate() moves that base to grow or
+ *  shrink the memory of the array, and SetSampledBaseLevel()
+ *  keeps sampling on levels that hold pixels already.
+ ***********************************************************/
+class TextureArray
+{
+public:
+    // Constructor: Initialize member variables
+    TextureArray();
+
+    // Destructor: Release the texture
+    ~TextureArray();
+
+    // Create storage for layerCount layers of width x height texels with a full mip chain
+    bool Create(GpuResourceManager* pResources, const std::string& label, GLsizei width, GLsizei height, GLsizei layerCount,
+        GLenum internalFormat = GL_RGBA8, GLint residentBaseLevel = 0);
+
+    // Replace the storage with one holding the levels from residentBaseLevel down;
+    // bKeptLevels tells whether the levels both storages hold were copied over
+    bool Reallocate(GLint residentBaseLevel, bool& bKeptLevels);
+
+    // Sample no level finer than level (levels above it are not uploaded yet)
+    void SetSampledBaseLevel(GLint level);
+
+    // Reserve the next free layer; returns the layer, or -1 when the array is full
+    int ReserveLayer();
+
+    // Upload one mip level of a layer, GetLevelSize() bytes of RGBA8 texels or compressed
+    // blocks (pData is an offset while a pixel unpack buffer is bound); levels
+    // finer than the resident base level are skipped
+    void UploadLayerLevel(int layer, GLint level, const void* pData);
+
+    // Resample an image to the layer size in RGBA8 and append its lower mip levels,
+    // largest first (touches no GL state, so worker threads may call it)
+    static bool MakeLayerImage(const unsigned char* pPixels, int width, int height, int channels,
+        GLsizei layerWidth, GLsizei layerHeight, std::vector<unsigned char>& levels);
+
+    // Get the size of one mip level and its byte offset in an image from MakeLayerImage()
+    static void GetLevelLayout(GLsizei layerWidth, GLsizei layerHeight, GLint level,
+        GLsizei& width, GLsizei& height, size_t& offset);
+
+    // Get the bytes of one mip level of a layer in an internal format
+    static size_t GetLevelSize(GLenum internalFormat, GLsizei layerWidth, GLsizei layerHeight, GLint level);
+
+    // Check whether an internal format is block-compressed
+    static bool IsCompressedFormat(GLenum internalFormat);
+
+    // Bind the array to a texture unit
+    void Bind(GLuint unit) const;
+
+    // Release the texture
+    void Destroy();
+
+    // Get the GL texture (0 before Create())
+    GLuint GetTexture() const;
+
+    // Get the layer size, the number of layers in use and the number of layers
+    GLsizei GetWidth() const { return m_width; }
+    GLsizei GetHeight() const { return m_height; }
+    GLsizei GetLayerCount() const { return m_layerCount; }
+    GLsizei GetCapacity() const { return m_capacity; }
+    GLsizei GetLevelCount() const { return m_levelCount; }
+    GLenum GetInternalFormat() const { return m_internalFormat; }
+    GLint GetResidentBaseLevel() const { return m_residentBaseLevel; }
+
+    // Get the bytes of the resident storage, or of a storage holding the levels from residentBaseLevel down
+    size_t GetResidentSize() const;
+    size_t GetResidentSize(GLint residentBaseLevel) const;
+
+private:
+    GpuResourceManager* m_pResources;    // Owner of the texture
+    GpuResourceManager::TEXTURE_HANDLE m_texture;  // The texture array
+    GLsizei m_width;                     // Width of every layer
+    GLsizei m_height;                    // Height of every layer
+    GLsizei m_capacity;                  // Number of layers of the storage
+    GLsizei m_layerCount;                // Number of layers reserved
+    GLsizei m_levelCount;                // Number of mip levels of every layer
+    GLenum m_internalFormat;             // Format of every layer
+    GLint m_residentBaseLevel;           // Finest level the storage holds
+    GLint m_sampledBaseLevel;            // Finest level sampled (-1 = not set yet)
+    std::string m_label;                 // Debug label of the texture
+
+    // Create storage for the levels from residentBaseLevel down and set its sampling parameters
+    GpuResourceManager::TEXTURE_HANDLE CreateStorage(GLint residentBaseLevel);
+};
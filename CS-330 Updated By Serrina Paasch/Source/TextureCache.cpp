@@ -0,0 +1,287 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureCache.cpp
+// ================
+// Keep transcoded texture layers with their mip chains on disk
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+#include "TextureArray.h"
+#include "GLResources.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MAKE_DIRECTORY(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MAKE_DIRECTORY(path) mkdir(path, 0755)
+#endif
+
+// Declaration of global variables and defines
+namespace
+{
+    // Bump when the resampling, mipping or block encoding changes output
+    const unsigned int ENCODER_VERSION = 1;
+
+    // FNV-1a 64-bit hashing of the source files
+    const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+    unsigned long long HashBytes(unsigned long long hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    // KTX2 file layout
+    const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    const size_t KTX2_HEADER_SIZE = 80;
+    const size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+    const size_t KTX2_LEVEL_ALIGNMENT = 16;
+
+    // Vulkan formats of the GL internal formats the cache stores
+    const unsigned int VK_FORMAT_R8G8B8A8_UNORM = 37;
+    const unsigned int VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+    const unsigned int VK_FORMAT_BC3_UNORM_BLOCK = 137;
+
+    unsigned int GetVulkanFormat(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_RGBA8: return VK_FORMAT_R8G8B8A8_UNORM;
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return VK_FORMAT_BC3_UNORM_BLOCK;
+        default: return 0;
+        }
+    }
+
+    // KTX2 stores every field little-endian
+    void WriteU32(unsigned char* pTarget, unsigned int value)
+    {
+        for (int b = 0; b < 4; b++)
+        {
+            pTarget[b] = (unsigned char)((value >> (8 * b)) & 0xFF);
+        }
+    }
+
+    void WriteU64(unsigned char* pTarget, unsigned long long value)
+    {
+        for (int b = 0; b < 8; b++)
+        {
+            pTarget[b] = (unsigned char)((value >> (8 * b)) & 0xFF);
+        }
+    }
+
+    unsigned int ReadU32(const unsigned char* pSource)
+    {
+        unsigned int value = 0;
+        for (int b = 3; b >= 0; b--)
+        {
+            value = (value << 8) | pSource[b];
+        }
+        return value;
+    }
+
+    unsigned long long ReadU64(const unsigned char* pSource)
+    {
+        unsigned long long value = 0;
+        for (int b = 7; b >= 0; b--)
+        {
+            value = (value << 8) | pSource[b];
+        }
+        return value;
+    }
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache()
+{
+}
+
+/***********************************************************
+ *  SetDirectory()
+ *
+ *  This method sets the directory of the cache files and
+ *  creates it when missing.  An empty directory disables the
+ *  cache.
+ ***********************************************************/
+void TextureCache::SetDirectory(const std::string& directory)
+{
+    m_directory = directory;
+    if (!m_directory.empty())
+    {
+        MAKE_DIRECTORY(m_directory.c_str());
+    }
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method hashes the bytes of a source file together
+ *  with what the cached image depends on besides them.
+ * Time Complexity: O(n) - Where n is the size of the source file
+ ***********************************************************/
+unsigned long long TextureCache::MakeKey(const unsigned char* pSource, size_t size, GLsizei width, GLsizei height, GLenum internalFormat)
+{
+    return MakeKey(HashBytes(FNV_OFFSET_BASIS, pSource, size), width, height, internalFormat);
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method continues the FNV-1a hash of a source file's
+ *  bytes with the parameters, so a hash computed elsewhere
+ *  gives the key of the overload above without reading the
+ *  bytes again.
+ ***********************************************************/
+unsigned long long TextureCache::MakeKey(unsigned long long sourceHash, GLsizei width, GLsizei height, GLenum internalFormat)
+{
+    unsigned int parameters[4] = { ENCODER_VERSION, (unsigned int)width, (unsigned int)height, (unsigned int)internalFormat };
+    return HashBytes(sourceHash, parameters, sizeof(parameters));
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method maps the cache file of a key and checks that
+ *  it holds a full mip chain of width x height layers in the
+ *  internal format, with every level inside the file.
+ *  Returns false, with the file closed, on a miss.
+ ***********************************************************/
+bool TextureCache::Load(unsigned long long key, GLsizei width, GLsizei height, GLenum internalFormat,
+    MappedFile& file, std::vector<size_t>& levelOffsets) const
+{
+    levelOffsets.clear();
+    if (!IsEnabled() || GetVulkanFormat(internalFormat) == 0 || !file.Open(GetPath(key)))
+        return false;
+
+    const unsigned char* pData = file.GetData();
+    size_t fileSize = file.GetSize();
+    GLsizei levelCount = GLResources::GetMipLevelCount(width, height);
+
+    bool bValid = fileSize >= KTX2_HEADER_SIZE + (size_t)levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE &&
+        memcmp(pData, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0 &&
+        ReadU32(pData + 12) == GetVulkanFormat(internalFormat) &&
+        ReadU32(pData + 20) == (unsigned int)width &&
+        ReadU32(pData + 24) == (unsigned int)height &&
+        ReadU32(pData + 40) == (unsigned int)levelCount &&
+        ReadU32(pData + 44) == 0;
+
+    for (GLint level = 0; bValid && level < levelCount; level++)
+    {
+        const unsigned char* pEntry = pData + KTX2_HEADER_SIZE + (size_t)level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        unsigned long long offset = ReadU64(pEntry);
+        unsigned long long length = ReadU64(pEntry + 8);
+
+        bValid = length == TextureArray::GetLevelSize(internalFormat, width, height, level) &&
+            offset <= fileSize && length <= fileSize - offset;
+        levelOffsets.push_back((size_t)offset);
+    }
+
+    if (!bValid)
+    {
+        levelOffsets.clear();
+        file.Close();
+    }
+    return bValid;
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method writes the cache file of a key.  The file is
+ *  written under a temporary name first and then renamed, so
+ *  a crash or a concurrent reader never sees a torn file.
+ ***********************************************************/
+bool TextureCache::Save(unsigned long long key, GLsizei width, GLsizei height, GLenum internalFormat,
+    const std::vector<unsigned char>& data, const std::vector<size_t>& levelOffsets) const
+{
+    GLsizei levelCount = GLResources::GetMipLevelCount(width, height);
+    if (!IsEnabled() || GetVulkanFormat(internalFormat) == 0 || (GLsizei)levelOffsets.size() != levelCount)
+        return false;
+
+    // Place the levels after the index, smallest first
+    std::vector<size_t> fileOffsets(levelCount);
+    size_t fileSize = KTX2_HEADER_SIZE + (size_t)levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+    for (GLint level = levelCount - 1; level >= 0; level--)
+    {
+        size_t length = TextureArray::GetLevelSize(internalFormat, width, height, level);
+        if (levelOffsets[level] > data.size() || length > data.size() - levelOffsets[level])
+            return false;
+
+        fileSize = ((fileSize + KTX2_LEVEL_ALIGNMENT - 1) / KTX2_LEVEL_ALIGNMENT) * KTX2_LEVEL_ALIGNMENT;
+        fileOffsets[level] = fileSize;
+        fileSize += length;
+    }
+
+    std::vector<unsigned char> contents(fileSize, 0);
+    unsigned char* pHeader = contents.data();
+    memcpy(pHeader, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    WriteU32(pHeader + 12, GetVulkanFormat(internalFormat));
+    WriteU32(pHeader + 16, 1);                      // typeSize
+    WriteU32(pHeader + 20, (unsigned int)width);
+    WriteU32(pHeader + 24, (unsigned int)height);
+    WriteU32(pHeader + 28, 0);                      // pixelDepth
+    WriteU32(pHeader + 32, 0);                      // layerCount (not an array)
+    WriteU32(pHeader + 36, 1);                      // faceCount
+    WriteU32(pHeader + 40, (unsigned int)levelCount);
+    WriteU32(pHeader + 44, 0);                      // supercompressionScheme
+
+    for (GLint level = 0; level < levelCount; level++)
+    {
+        size_t length = TextureArray::GetLevelSize(internalFormat, width, height, level);
+        unsigned char* pEntry = pHeader + KTX2_HEADER_SIZE + (size_t)level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        WriteU64(pEntry, fileOffsets[level]);
+        WriteU64(pEntry + 8, length);
+        WriteU64(pEntry + 16, length);
+        memcpy(&contents[fileOffsets[level]], &data[levelOffsets[level]], length);
+    }
+
+    // Workers may save the same image at once, so each writes its own temporary file
+    std::ostringstream tempPath;
+    tempPath << GetPath(key) << "." << std::this_thread::get_id() << ".tmp";
+
+    std::ofstream cacheFile(tempPath.str().c_str(), std::ios::binary | std::ios::trunc);
+    if (!cacheFile)
+        return false;
+
+    cacheFile.write((const char*)contents.data(), (std::streamsize)contents.size());
+    cacheFile.close();
+
+    std::string path = GetPath(key);
+    std::remove(path.c_str());
+    if (!cacheFile || std::rename(tempPath.str().c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.str().c_str());
+        return false;
+    }
+    return true;
+}
+
+/***********************************************************
+ *  GetPath()
+ *
+ *  Get the cache file path for a key.
+ ***********************************************************/
+std::string TextureCache::GetPath(unsigned long long key) const
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.ktx2", key);
+    return m_directory + "/" + fileName;
+}
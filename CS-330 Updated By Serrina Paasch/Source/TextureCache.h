@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureCache.h
+// ==============
+// Keep transcoded texture layers with their mip chains on disk
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class stores images that were already decoded,
+ *  resampled, mipped and (optionally) block-compressed for a
+ *  texture array layer, so later runs skip all of that work
+ *  and upload the file contents as they are.
+ *
+ *  Each image is one file in a KTX2 layout: the 80-byte KTX2
+ *  header, the level index and the levels, smallest first and
+ *  16-byte aligned.  The data format descriptor and key/value
+ *  data are left empty.  The file name is a hash of the
+ *  source file bytes, the layer size, the internal format and
+ *  the encoder version, so edited sources, new formats and
+ *  encoder changes simply miss the cache.
+ *
+ *  Cached files are read by mapping them, and the levels are
+ *  handed out as offsets into the mapping.  Load() and Save()
+ *  only read members, so worker threads may call them.
+ ***********************************************************/
+class TextureCache
+{
+public:
+    // Constructor: Initialize member variables
+    TextureCache();
+
+    // Set the directory of the cache files (created when missing); empty disables the cache
+    void SetDirectory(const std::string& directory);
+
+    // Check whether a directory is set
+    bool IsEnabled() const { return !m_directory.empty(); }
+
+    // Make the cache key of a source file for a layer size and internal format
+    static unsigned long long MakeKey(const unsigned char* pSource, size_t size, GLsizei width, GLsizei height, GLenum internalFormat);
+
+    // Make the same key from the 64-bit FNV-1a hash of the source bytes, such as an asset pack stores
+    static unsigned long long MakeKey(unsigned long long sourceHash, GLsizei width, GLsizei height, GLenum internalFormat);
+
+    // Map a cached image; fills the byte offset of every level in the mapping
+    bool Load(unsigned long long key, GLsizei width, GLsizei height, GLenum internalFormat,
+        MappedFile& file, std::vector<size_t>& levelOffsets) const;
+
+    // Write an image whose levels (largest first) start at levelOffsets in data
+    bool Save(unsigned long long key, GLsizei width, GLsizei height, GLenum internalFormat,
+        const std::vector<unsigned char>& data, const std::vector<size_t>& levelOffsets) const;
+
+private:
+    std::string m_directory;             // Directory of the cache files
+
+    // Get the cache file path for a key
+    std::string GetPath(unsigned long long key) const;
+};
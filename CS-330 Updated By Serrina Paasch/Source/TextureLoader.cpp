@@ -0,0 +1,735 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureLoader.cpp
+// =================
+// Decode texture images on worker threads and stream them into a
+// texture array under a per-frame time budget
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+#include "GLResources.h"
+#include "BlockCompressor.h"
+#include "ImageDecoder.h"
+
+#include <cstring>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+#include <iostream>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Layers (with all their mip levels) staged per Update()
+    const size_t STAGING_LAYERS = 2;
+
+    // Staged levels start at multiples of the default GL_UNPACK_ALIGNMENT
+    const size_t STAGING_ALIGNMENT = 4;
+
+    // Default location of the transcoded image cache, relative to the working directory
+    const char* DEFAULT_CACHE_DIRECTORY = "texturecache";
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader()
+{
+    m_pThreadPool = NULL;
+    m_pTextureArray = NULL;
+    m_pResources = NULL;
+    m_pAssetPack = NULL;
+    m_stagingSize = 0;
+    m_pStaging = NULL;
+    m_stagingUsed = 0;
+    m_pendingCount = 0;
+    m_inFlight = 0;
+    m_bCancelled = false;
+    m_loadedCount = 0;
+    m_cache.SetDirectory(DEFAULT_CACHE_DIRECTORY);
+}
+
+/***********************************************************
+ *  REQUEST()
+ *
+ *  The constructor for a queued image
+ ***********************************************************/
+TextureLoader::REQUEST::REQUEST()
+{
+    layer = -1;
+    layerWidth = 0;
+    layerHeight = 0;
+    internalFormat = GL_RGBA8;
+    width = 0;
+    height = 0;
+    channels = 0;
+    bFailed = false;
+    bCached = false;
+    bDecoded = false;
+    bQueued = false;
+    bLoaded = false;
+    pLevels = NULL;
+    finestLevel = 0;
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+    Cancel();
+
+    m_stagingRing.Destroy();
+    if (NULL != m_pResources)
+    {
+        m_pResources->Release(m_stagingBuffer);
+    }
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method sets the thread pool that decodes the images,
+ *  the texture array that receives them and the owner of the
+ *  staging buffer.
+ ***********************************************************/
+void TextureLoader::Initialize(ThreadPool* pThreadPool, TextureArray* pTextureArray, GpuResourceManager* pResources)
+{
+    m_pThreadPool = pThreadPool;
+    m_pTextureArray = pTextureArray;
+    m_pResources = pResources;
+}
+
+/***********************************************************
+ *  SetCacheDirectory()
+ *
+ *  This method sets the directory of the transcoded image
+ *  cache.  An empty directory disables the cache, so every
+ *  image is decoded again.
+ ***********************************************************/
+void TextureLoader::SetCacheDirectory(const std::string& directory)
+{
+    m_cache.SetDirectory(directory);
+}
+
+/***********************************************************
+ *  SetAssetPack()
+ *
+ *  This method sets the archive images are read from before
+ *  their own files.  Images queued from then on use it; the
+ *  pack must stay open until the loader is destroyed.
+ ***********************************************************/
+void TextureLoader::SetAssetPack(const AssetPack* pAssetPack)
+{
+    m_pAssetPack = pAssetPack;
+}
+
+/***********************************************************
+ *  Queue()
+ *
+ *  This method reserves the next layer of the texture array
+ *  for an image file and queues its decode; Update() hands it
+ *  to the thread pool by priority.  The layer shows its pixels
+ *  once Update() has uploaded them.
+ ***********************************************************/
+int TextureLoader::Queue(const std::string& filename)
+{
+    if (NULL == m_pThreadPool || NULL == m_pTextureArray)
+        return -1;
+
+    int layer = m_pTextureArray->ReserveLayer();
+    if (layer < 0)
+        return -1;
+
+    if (m_pendingCount == 0)
+    {
+        m_startTime = CLOCK::now();
+        m_loadedCount = 0;
+    }
+
+    // Requests own file mappings, so they are built in place
+    m_requests.emplace_back();
+    REQUEST* pRequest = &m_requests.back();
+    pRequest->filename = filename;
+    pRequest->layer = layer;
+    pRequest->layerWidth = m_pTextureArray->GetWidth();
+    pRequest->layerHeight = m_pTextureArray->GetHeight();
+    pRequest->internalFormat = m_pTextureArray->GetInternalFormat();
+    pRequest->finestLevel = m_pTextureArray->GetLevelCount();
+    m_pendingCount++;
+    m_decodeQueue.push_back(pRequest);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bCancelled = false;
+    }
+
+    return layer;
+}
+
+/***********************************************************
+ *  SetLayerPriority()
+ *
+ *  This method sets the loading order of a layer: layers in
+ *  view load before the others, nearer ones first.  Layers
+ *  without a priority load last, in queue order.
+ ***********************************************************/
+void TextureLoader::SetLayerPriority(int layer, bool bInView, float distance)
+{
+    if (layer < 0)
+        return;
+
+    if ((size_t)layer >= m_layerPriorities.size())
+    {
+        m_layerPriorities.resize((size_t)layer + 1, LAYER_PRIORITY{ false, FLT_MAX });
+    }
+    m_layerPriorities[layer].bInView = bInView;
+    m_layerPriorities[layer].distance = distance;
+}
+
+/***********************************************************
+ *  IsSooner()
+ *
+ *  This method checks whether a request loads before another
+ *  from the priorities of their layers.
+ ***********************************************************/
+bool TextureLoader::IsSooner(const REQUEST* pFirst, const REQUEST* pSecond) const
+{
+    LAYER_PRIORITY first = { false, FLT_MAX };
+    LAYER_PRIORITY second = { false, FLT_MAX };
+    if ((size_t)pFirst->layer < m_layerPriorities.size())
+        first = m_layerPriorities[pFirst->layer];
+    if ((size_t)pSecond->layer < m_layerPriorities.size())
+        second = m_layerPriorities[pSecond->layer];
+
+    if (first.bInView != second.bInView)
+        return first.bInView;
+    return first.distance < second.distance;
+}
+
+/***********************************************************
+ *  SubmitDecodes()
+ *
+ *  This method hands the most urgent queued images to the
+ *  thread pool, keeping at most one decode per worker in
+ *  flight so later priorities still reorder the rest.
+ * Time Complexity: O(n) per submitted image - Where n is the number of images not submitted yet
+ ***********************************************************/
+void TextureLoader::SubmitDecodes()
+{
+    size_t maxInFlight = (m_pThreadPool->GetThreadCount() > 1) ? m_pThreadPool->GetThreadCount() - 1 : 1;
+
+    for (size_t submitted = 0; submitted < maxInFlight && !m_decodeQueue.empty(); submitted++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_inFlight >= maxInFlight)
+                return;
+            m_inFlight++;
+        }
+
+        std::vector<REQUEST*>::iterator next = m_decodeQueue.begin();
+        for (std::vector<REQUEST*>::iterator it = m_decodeQueue.begin() + 1; it != m_decodeQueue.end(); ++it)
+        {
+            if (IsSooner(*it, *next))
+                next = it;
+        }
+
+        REQUEST* pRequest = *next;
+        m_decodeQueue.erase(next);
+        m_pThreadPool->Submit([this, pRequest]() { Decode(pRequest); });
+    }
+}
+
+/***********************************************************
+ *  Decode()
+ *
+ *  This method finds one image in the asset pack, or maps
+ *  its file, and looks its contents up in the texture cache.  On a miss the image is decoded from
+ *  the mapping into a scratch buffer kept by the worker
+ *  thread, transcoded and saved to the cache for the next
+ *  run.  It runs on a worker thread and touches no GL state.
+ ***********************************************************/
+void TextureLoader::Decode(REQUEST* pRequest)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_bCancelled)
+        {
+            if (--m_inFlight == 0)
+                m_idleCondition.notify_all();
+            return;
+        }
+    }
+
+    // Read the image in place from the asset pack, or map its own file
+    MappedFile source;
+    const unsigned char* pSource = NULL;
+    size_t sourceSize = 0;
+    unsigned long long sourceHash = 0;
+    bool bPacked = NULL != m_pAssetPack && m_pAssetPack->Find(pRequest->filename, pSource, sourceSize, sourceHash);
+    if (!bPacked && source.Open(pRequest->filename))
+    {
+        pSource = source.GetData();
+        sourceSize = source.GetSize();
+    }
+    pRequest->bFailed = (NULL == pSource);
+
+    unsigned long long cacheKey = 0;
+    if (!pRequest->bFailed && m_cache.IsEnabled())
+    {
+        cacheKey = bPacked ?
+            TextureCache::MakeKey(sourceHash, pRequest->layerWidth, pRequest->layerHeight, pRequest->internalFormat) :
+            TextureCache::MakeKey(pSource, sourceSize, pRequest->layerWidth, pRequest->layerHeight, pRequest->internalFormat);
+        pRequest->bCached = m_cache.Load(cacheKey, pRequest->layerWidth, pRequest->layerHeight,
+            pRequest->internalFormat, pRequest->cacheFile, pRequest->levelOffsets);
+    }
+
+    if (pRequest->bCached)
+    {
+        pRequest->pLevels = pRequest->cacheFile.GetData();
+    }
+    else if (!pRequest->bFailed)
+    {
+        // Multi-megapixel images would otherwise cost an allocation each
+        thread_local std::vector<unsigned char> decodeBuffer;
+
+        ImageDecoder::IMAGE_INFO info;
+        pRequest->bFailed = !ImageDecoder::DecodeImage(pSource, sourceSize, info, decodeBuffer);
+        if (!pRequest->bFailed)
+        {
+            pRequest->width = info.width;
+            pRequest->height = info.height;
+            pRequest->channels = info.channels;
+            pRequest->bFailed = !Transcode(pRequest, decodeBuffer.data());
+        }
+
+        // Stream from the saved file from now on, so the levels kept for
+        // streaming live in the page cache rather than on the heap
+        std::vector<size_t> cachedOffsets;
+        if (!pRequest->bFailed && m_cache.IsEnabled() &&
+            m_cache.Save(cacheKey, pRequest->layerWidth, pRequest->layerHeight, pRequest->internalFormat,
+                pRequest->levels, pRequest->levelOffsets) &&
+            m_cache.Load(cacheKey, pRequest->layerWidth, pRequest->layerHeight, pRequest->internalFormat,
+                pRequest->cacheFile, cachedOffsets))
+        {
+            std::vector<unsigned char>().swap(pRequest->levels);
+            pRequest->levelOffsets.swap(cachedOffsets);
+            pRequest->pLevels = pRequest->cacheFile.GetData();
+        }
+    }
+    source.Close();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_bCancelled)
+    {
+        m_decoded.push_back(pRequest);
+    }
+    if (--m_inFlight == 0)
+    {
+        m_idleCondition.notify_all();
+    }
+}
+
+/***********************************************************
+ *  Transcode()
+ *
+ *  This method resamples a decoded image to the layer size,
+ *  builds its mip chain and, for a compressed array, encodes
+ *  every level into blocks.  The levels replace the request's
+ *  pixels and their offsets are recorded.
+ ***********************************************************/
+bool TextureLoader::Transcode(REQUEST* pRequest, const unsigned char* pImage)
+{
+    std::vector<unsigned char> pixels;
+    if (!TextureArray::MakeLayerImage(pImage, pRequest->width, pRequest->height, pRequest->channels,
+        pRequest->layerWidth, pRequest->layerHeight, pixels))
+        return false;
+
+    GLint levelCount = GLResources::GetMipLevelCount(pRequest->layerWidth, pRequest->layerHeight);
+    bool bCompressed = TextureArray::IsCompressedFormat(pRequest->internalFormat);
+    pRequest->levels.clear();
+    pRequest->levelOffsets.clear();
+
+    for (GLint level = 0; level < levelCount; level++)
+    {
+        GLsizei width = 0;
+        GLsizei height = 0;
+        size_t offset = 0;
+        TextureArray::GetLevelLayout(pRequest->layerWidth, pRequest->layerHeight, level, width, height, offset);
+
+        if (!bCompressed)
+        {
+            pRequest->levelOffsets.push_back(offset);
+            continue;
+        }
+
+        pRequest->levelOffsets.push_back(pRequest->levels.size());
+        if (!BlockCompressor::Compress(pRequest->internalFormat, &pixels[offset], width, height, pRequest->levels))
+            return false;
+    }
+
+    if (!bCompressed)
+    {
+        pRequest->levels.swap(pixels);
+    }
+    pRequest->pLevels = pRequest->levels.data();
+    return true;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method uploads the mip levels of decoded images,
+ *  coarsest missing level first, until budgetMilliseconds
+ *  have passed or the staging buffer is full.  At least one
+ *  level is uploaded per call so loading always progresses.
+ *  Returns false once every image has its resident levels.
+ * Time Complexity: O(b) - Where b is the number of bytes staged within the budget
+ ***********************************************************/
+bool TextureLoader::Update(double budgetMilliseconds)
+{
+    if (m_pendingCount == 0 && m_uploadQueue.empty())
+        return false;
+
+    CLOCK::time_point start = CLOCK::now();
+    SubmitDecodes();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (REQUEST* pRequest : m_decoded)
+        {
+            pRequest->bDecoded = true;
+            pRequest->bQueued = true;
+            m_uploadQueue.push_back(pRequest);
+        }
+        m_decoded.clear();
+    }
+
+    if (m_uploadQueue.empty())
+        return true;
+
+    // Requests keep their order among equals, so each one finishes before the next starts
+    std::stable_sort(m_uploadQueue.begin(), m_uploadQueue.end(),
+        [this](const REQUEST* pFirst, const REQUEST* pSecond) { return IsSooner(pFirst, pSecond); });
+
+    bool bStaging = BeginStaging();
+    GLint residentLevel = m_pTextureArray->GetResidentBaseLevel();
+    size_t pendingCount = m_pendingCount;
+    unsigned int uploadCount = 0;
+
+    while (!m_uploadQueue.empty())
+    {
+        REQUEST* pRequest = m_uploadQueue.front();
+        if (pRequest->bFailed)
+        {
+            std::cout << "Could not load image:" << pRequest->filename << std::endl;
+            pRequest->bQueued = false;
+            m_uploadQueue.pop_front();
+            m_pendingCount--;
+            continue;
+        }
+
+        if (pRequest->finestLevel > residentLevel)
+        {
+            if (uploadCount > 0 && MillisecondsSince(start) >= budgetMilliseconds)
+                break;
+
+            GLint level = pRequest->finestLevel - 1;
+            size_t size = TextureArray::GetLevelSize(pRequest->internalFormat, pRequest->layerWidth, pRequest->layerHeight, level);
+            const unsigned char* pPixels = pRequest->pLevels + pRequest->levelOffsets[level];
+
+            if (bStaging)
+            {
+                size_t stagingOffset = 0;
+                void* pTarget = AllocateStaging(size, stagingOffset);
+                if (NULL == pTarget)
+                    break;
+
+                memcpy(pTarget, pPixels, size);
+
+                STAGED_UPLOAD upload;
+                upload.layer = pRequest->layer;
+                upload.level = level;
+                upload.offset = stagingOffset;
+                m_stagedUploads.push_back(upload);
+            }
+            else
+            {
+                m_pTextureArray->UploadLayerLevel(pRequest->layer, level, pPixels);
+            }
+            uploadCount++;
+            pRequest->finestLevel = level;
+        }
+
+        if (pRequest->finestLevel <= residentLevel)
+        {
+            if (!pRequest->bLoaded)
+            {
+                if (pRequest->bCached)
+                {
+                    std::cout << "Successfully loaded cached image:" << pRequest->filename << std::endl;
+                }
+                else
+                {
+                    std::cout << "Successfully loaded image:" << pRequest->filename << ", width:" << pRequest->width
+                        << ", height:" << pRequest->height << ", channels:" << pRequest->channels << std::endl;
+                }
+
+                pRequest->bLoaded = true;
+                m_pendingCount--;
+                m_loadedCount++;
+            }
+
+            pRequest->bQueued = false;
+            m_uploadQueue.pop_front();
+        }
+    }
+
+    if (bStaging)
+    {
+        EndStaging();
+    }
+
+    if (pendingCount > 0 && m_pendingCount == 0)
+    {
+        std::cout << "Texture loading: " << m_loadedCount << " images streamed in "
+            << MillisecondsSince(m_startTime) << " ms" << std::endl;
+    }
+
+    return m_pendingCount > 0 || !m_uploadQueue.empty();
+}
+
+/***********************************************************
+ *  OnTextureArrayReallocated()
+ *
+ *  This method follows a reallocation of the texture array.
+ *  Levels finer than the old base are missing from the new
+ *  storage, as are all levels when they were not copied over,
+ *  so those images are queued to upload them again.
+ ***********************************************************/
+void TextureLoader::OnTextureArrayReallocated(bool bKeptLevels)
+{
+    if (NULL == m_pTextureArray)
+        return;
+
+    GLint baseLevel = m_pTextureArray->GetResidentBaseLevel();
+    GLint levelCount = m_pTextureArray->GetLevelCount();
+
+    for (REQUEST& request : m_requests)
+    {
+        if (!request.bDecoded || request.bFailed)
+            continue;
+
+        if (!bKeptLevels)
+        {
+            request.finestLevel = levelCount;
+        }
+        else if (request.finestLevel < baseLevel)
+        {
+            request.finestLevel = baseLevel;
+        }
+
+        if (request.finestLevel > baseLevel && !request.bQueued)
+        {
+            request.bQueued = true;
+            m_uploadQueue.push_back(&request);
+        }
+    }
+}
+
+/***********************************************************
+ *  GetCompleteLevel()
+ *
+ *  This method gets the finest mip level that every image
+ *  has uploaded, so sampling can be limited to levels that
+ *  hold pixels in every layer.
+ ***********************************************************/
+GLint TextureLoader::GetCompleteLevel() const
+{
+    if (NULL == m_pTextureArray)
+        return 0;
+
+    GLint levelCount = m_pTextureArray->GetLevelCount();
+    GLint completeLevel = m_pTextureArray->GetResidentBaseLevel();
+
+    for (const REQUEST& request : m_requests)
+    {
+        // Workers may still write undecoded requests, so only bDecoded is read for them
+        GLint finestLevel = levelCount;
+        if (request.bDecoded)
+        {
+            if (request.bFailed)
+                continue;
+            finestLevel = request.finestLevel;
+        }
+        completeLevel = (finestLevel > completeLevel) ? finestLevel : completeLevel;
+    }
+
+    return completeLevel;
+}
+
+/***********************************************************
+ *  Cancel()
+ *
+ *  This method drops every image not uploaded yet.  Decodes
+ *  already running finish first, since they write into the
+ *  queued requests.
+ ***********************************************************/
+void TextureLoader::Cancel()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_bCancelled = true;
+        m_idleCondition.wait(lock, [this]() { return m_inFlight == 0; });
+        m_decoded.clear();
+    }
+
+    m_uploadQueue.clear();
+    m_decodeQueue.clear();
+    m_requests.clear();
+    m_pendingCount = 0;
+}
+
+/***********************************************************
+ *  GetPendingCount()
+ *
+ *  This method gets the number of queued images that are not
+ *  fully uploaded yet.
+ ***********************************************************/
+size_t TextureLoader::GetPendingCount() const
+{
+    return m_pendingCount;
+}
+
+/***********************************************************
+ *  BeginStaging()
+ *
+ *  This method creates the staging buffer on first use, room
+ *  for STAGING_LAYERS whole layers, and opens it for writing.
+ *  Returns false when no staging buffer is available; the
+ *  levels are then uploaded straight from client memory.
+ ***********************************************************/
+bool TextureLoader::BeginStaging()
+{
+    if (NULL == m_pResources)
+        return false;
+
+    GLStateCache& stateCache = m_pResources->GetStateCache();
+    m_stagedUploads.clear();
+
+    if (m_stagingSize == 0)
+    {
+        size_t layerSize = 0;
+        for (GLint level = 0; level < m_pTextureArray->GetLevelCount(); level++)
+        {
+            layerSize += TextureArray::GetLevelSize(m_pTextureArray->GetInternalFormat(),
+                m_pTextureArray->GetWidth(), m_pTextureArray->GetHeight(), level) + STAGING_ALIGNMENT;
+        }
+        m_stagingSize = STAGING_LAYERS * layerSize;
+
+        if (PersistentRingBuffer::IsSupported())
+        {
+            m_stagingRing.Create(&stateCache, GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)m_stagingSize, &m_pResources->GetMemoryTracker());
+        }
+        if (!m_stagingRing.IsCreated())
+        {
+            m_stagingBuffer = m_pResources->CreateBuffer("texture staging", GL_PIXEL_UNPACK_BUFFER,
+                (GLsizeiptr)m_stagingSize, NULL, GL_MAP_WRITE_BIT);
+        }
+
+        // Client-memory uploads must not read from a bound unpack buffer
+        stateCache.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (m_stagingRing.IsCreated())
+    {
+        m_stagingRing.BeginFrame();
+        return true;
+    }
+
+    GLuint buffer = m_pResources->GetBuffer(m_stagingBuffer);
+    if (buffer == 0)
+        return false;
+
+    m_pStaging = (unsigned char*)GLResources::MapBuffer(stateCache, GL_PIXEL_UNPACK_BUFFER, buffer, 0,
+        (GLsizeiptr)m_stagingSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    m_stagingUsed = 0;
+    if (NULL == m_pStaging)
+    {
+        stateCache.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+    return true;
+}
+
+/***********************************************************
+ *  AllocateStaging()
+ *
+ *  This method reserves size bytes of the staging buffer for
+ *  the current Update().  Returns NULL when it is full.
+ ***********************************************************/
+void* TextureLoader::AllocateStaging(size_t size, size_t& offset)
+{
+    if (m_stagingRing.IsCreated())
+    {
+        GLintptr ringOffset = 0;
+        void* pTarget = m_stagingRing.Allocate((GLsizeiptr)size, (GLsizeiptr)STAGING_ALIGNMENT, ringOffset);
+        offset = (size_t)ringOffset;
+        return pTarget;
+    }
+
+    size_t start = ((m_stagingUsed + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT) * STAGING_ALIGNMENT;
+    if (NULL == m_pStaging || start + size > m_stagingSize)
+        return NULL;
+
+    m_stagingUsed = start + size;
+    offset = start;
+    return m_pStaging + start;
+}
+
+/***********************************************************
+ *  EndStaging()
+ *
+ *  This method issues the uploads of every level staged by
+ *  the current Update() from the pixel unpack buffer and
+ *  unbinds it again.
+ ***********************************************************/
+void TextureLoader::EndStaging()
+{
+    GLStateCache& stateCache = m_pResources->GetStateCache();
+    GLuint buffer = 0;
+
+    if (m_stagingRing.IsCreated())
+    {
+        buffer = m_stagingRing.GetBuffer();
+    }
+    else
+    {
+        buffer = m_pResources->GetBuffer(m_stagingBuffer);
+        GLResources::UnmapBuffer(stateCache, GL_PIXEL_UNPACK_BUFFER, buffer);
+        m_pStaging = NULL;
+    }
+
+    stateCache.BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    for (const STAGED_UPLOAD& upload : m_stagedUploads)
+    {
+        m_pTextureArray->UploadLayerLevel(upload.layer, upload.level, (const void*)(uintptr_t)upload.offset);
+    }
+    stateCache.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_stagedUploads.clear();
+
+    if (m_stagingRing.IsCreated())
+    {
+        m_stagingRing.EndFrame();
+    }
+}
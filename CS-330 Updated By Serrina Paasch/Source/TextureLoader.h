@@ -0,0 +1,192 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureLoader.h
+// ===============
+// Decode texture images on worker threads and stream them into a
+// texture array under a per-frame time budget
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>        // GLEW library
+#include "GpuResourceManager.h"
+#include "TextureArray.h"
+#include "PersistentRingBuffer.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+#include "MappedFile.h"
+#include "AssetPack.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class loads image files into the layers of a texture
+ *  array without blocking the GL thread on decoding.
+ *
+ *  Queue() reserves the layer of an image right away and
+ *  queues the file for the thread pool, where it is decoded,
+ *  resampled to the layer size and reduced to a full mip
+ *  chain.  Decodes are handed to the pool a few at a time,
+ *  and decoded images are uploaded, in order of priority:
+ *  layers shown by objects in view first, nearest to the
+ *  viewer first (SetLayerPriority()), then the rest in queue
+ *  order.  Update(), called once per frame on the GL thread,
+ *  copies finished mip levels into a pixel unpack buffer and
+ *  issues the texture uploads from it, stopping once its time
+ *  budget is spent; the copies from the buffer into the
+ *  texture run asynchronously on the GPU.  Levels go up
+ *  coarse to fine, so an image shows blurred first and
+ *  sharpens, and only down to the resident base level of the
+ *  array.  The images stay available after their upload, so
+ *  levels the array drops can be streamed in again.
+ *
+ *  Finished images are kept in a TextureCache in the format
+ *  of the array (block-compressed where it is).  A worker
+ *  first hashes the mapped source file and, on a cache hit,
+ *  maps the cached file and hands its levels to Update() with
+ *  no decoding, resampling or compression at all.  Images in
+ *  an asset pack are read in place from its mapping, keyed by
+ *  the content hash the pack stores, so they are not hashed.
+ *
+ *  The staging buffer is a persistently mapped ring where
+ *  supported, so a frame never writes memory the GPU is still
+ *  reading.  Otherwise one buffer is mapped per Update() with
+ *  GL_MAP_INVALIDATE_BUFFER_BIT and the driver renames it.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+    // Constructor: Initialize member variables
+    TextureLoader();
+
+    // Destructor: Cancel the outstanding work and free the staging buffer
+    ~TextureLoader();
+
+    // Set the pool that decodes, the array that receives the layers and the
+    // owner of the staging buffer
+    void Initialize(ThreadPool* pThreadPool, TextureArray* pTextureArray, GpuResourceManager* pResources);
+
+    // Set the directory of the transcoded image cache; empty disables it
+    void SetCacheDirectory(const std::string& directory);
+
+    // Set the asset pack images are read from before their own files (NULL = files only)
+    void SetAssetPack(const AssetPack* pAssetPack);
+
+    // Start loading an image file; returns its layer, or -1 when the array is full
+    int Queue(const std::string& filename);
+
+    // Upload decoded mip levels for up to budgetMilliseconds; false once nothing is left
+    bool Update(double budgetMilliseconds);
+
+    // Order the loading of a layer by whether it is in view and its distance to the viewer
+    void SetLayerPriority(int layer, bool bInView, float distance);
+
+    // Follow a reallocation of the array; bKeptLevels tells whether the levels
+    // uploaded before survived it
+    void OnTextureArrayReallocated(bool bKeptLevels);
+
+    // Get the finest mip level uploaded for every image (level count while one has none)
+    GLint GetCompleteLevel() const;
+
+    // Drop the images not decoded yet and wait for the running decodes
+    void Cancel();
+
+    // Get the number of queued images not fully uploaded yet
+    size_t GetPendingCount() const;
+
+private:
+    // Structure to hold one queued image
+    struct REQUEST
+    {
+        std::string filename;            // Image file
+        int layer;                       // Reserved texture array layer
+        GLsizei layerWidth;              // Size of every layer of the array
+        GLsizei layerHeight;
+        GLenum internalFormat;           // Format of every layer of the array
+        int width;                       // Size of the decoded image
+        int height;
+        int channels;                    // Channels of the decoded image
+        bool bFailed;                    // The image could not be decoded
+        bool bCached;                    // The levels come from the texture cache
+        bool bDecoded;                   // Taken from the workers by Update()
+        bool bQueued;                    // In m_uploadQueue
+        bool bLoaded;                    // Every resident level was uploaded once
+        std::vector<unsigned char> levels;  // All mip levels, largest first (when decoded)
+        MappedFile cacheFile;            // Mapping of the cached image (when cached)
+        const unsigned char* pLevels;    // Start of the levels in levels or cacheFile
+        std::vector<size_t> levelOffsets;   // Byte offset of every mip level from pLevels
+        GLint finestLevel;               // Finest mip level uploaded (level count when none)
+
+        REQUEST();
+    };
+
+    // Structure to hold the loading order of one layer
+    struct LAYER_PRIORITY
+    {
+        bool bInView;                    // Shown by an object in view
+        float distance;                  // Distance of its nearest object to the viewer
+    };
+
+    // Structure to hold one upload issued from the staging buffer
+    struct STAGED_UPLOAD
+    {
+        int layer;
+        GLint level;
+        size_t offset;                   // Byte offset in the staging buffer
+    };
+
+    typedef std::chrono::steady_clock CLOCK;
+
+    ThreadPool* m_pThreadPool;           // Workers that decode the images
+    TextureArray* m_pTextureArray;       // Array receiving the layers
+    GpuResourceManager* m_pResources;    // Owner of the mapped staging buffer
+    const AssetPack* m_pAssetPack;       // Archive read before the image files (optional)
+    TextureCache m_cache;                // Transcoded images from earlier runs
+    PersistentRingBuffer m_stagingRing;  // Persistently mapped staging ring
+    GpuResourceManager::BUFFER_HANDLE m_stagingBuffer;  // Staging buffer mapped per Update()
+    size_t m_stagingSize;                // Staging bytes available per Update()
+    unsigned char* m_pStaging;           // Mapping of m_stagingBuffer during Update()
+    size_t m_stagingUsed;                // Bytes of m_stagingBuffer written during Update()
+    std::deque<REQUEST> m_requests;      // Queued images (addresses stay valid until Cancel())
+    std::vector<REQUEST*> m_decodeQueue; // Queued images not handed to the pool yet
+    std::vector<LAYER_PRIORITY> m_layerPriorities;  // Loading order per layer
+    std::deque<REQUEST*> m_decoded;      // Decoded by the workers, not taken by Update() yet
+    std::deque<REQUEST*> m_uploadQueue;  // Decoded images with resident levels missing, most urgent first
+    std::vector<STAGED_UPLOAD> m_stagedUploads;  // Uploads of the current Update()
+    size_t m_pendingCount;               // Queued images not fully uploaded once
+    std::mutex m_mutex;                  // Guards m_decoded, m_inFlight and m_bCancelled
+    std::condition_variable m_idleCondition;  // Signals the last finished decode
+    size_t m_inFlight;                   // Decodes submitted but not finished
+    bool m_bCancelled;                   // Submitted decodes return without work
+    CLOCK::time_point m_startTime;       // When the first image of the batch was queued
+    unsigned int m_loadedCount;          // Images uploaded since the batch started
+
+    // Check whether a request loads before another
+    bool IsSooner(const REQUEST* pFirst, const REQUEST* pSecond) const;
+
+    // Hand the most urgent queued images to the pool while workers are free
+    void SubmitDecodes();
+
+    // Load one image from the cache, or decode, resample, mip and compress it (runs on a worker thread)
+    void Decode(REQUEST* pRequest);
+
+    // Turn a decoded image into the levels of the layer format
+    bool Transcode(REQUEST* pRequest, const unsigned char* pImage);
+
+    // Create the staging buffer on first use and start writing to it
+    bool BeginStaging();
+
+    // Reserve size bytes of staging memory (NULL when it is full)
+    void* AllocateStaging(size_t size, size_t& offset);
+
+    // Issue the uploads of the staged mip levels
+    void EndStaging();
+};
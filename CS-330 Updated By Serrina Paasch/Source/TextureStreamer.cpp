@@ -0,0 +1,263 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureStreamer.cpp
+// ===================
+// Keep only the texture mip levels the visible objects need resident
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureStreamer.h"
+
+#include <cmath>
+#include <cfloat>
+
+// Declaration of global variables and defines
+namespace
+{
+    // Frames the finer levels must go unused before their memory is freed
+    const unsigned int DROP_DELAY_FRAMES = 300;
+
+    // Distance below which an object counts as touching the viewer
+    const float MIN_VIEW_DISTANCE = 0.01f;
+}
+
+/***********************************************************
+ *  TextureStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureStreamer::TextureStreamer()
+{
+    m_pTextureArray = NULL;
+    m_pTextureLoader = NULL;
+    m_pMemory = NULL;
+    m_evictableId = 0;
+    m_bEvicted = false;
+    m_viewProjection = glm::mat4(1.0f);
+    m_pixelsPerUnit = 0.0f;
+    m_clipScale = glm::vec2(0.0f);
+    m_coarserFrames = 0;
+}
+
+/***********************************************************
+ *  ~TextureStreamer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureStreamer::~TextureStreamer()
+{
+    if (NULL != m_pMemory && m_evictableId != 0)
+    {
+        m_pMemory->RemoveEvictable(m_evictableId);
+    }
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method sets the texture array whose residency is
+ *  managed and the loader that streams levels into it, and
+ *  registers the array as evictable with the tracker.
+ ***********************************************************/
+void TextureStreamer::Initialize(TextureArray* pTextureArray, TextureLoader* pTextureLoader, GpuMemoryTracker* pMemory)
+{
+    if (NULL != m_pMemory && m_evictableId != 0)
+    {
+        m_pMemory->RemoveEvictable(m_evictableId);
+        m_evictableId = 0;
+    }
+
+    m_pTextureArray = pTextureArray;
+    m_pTextureLoader = pTextureLoader;
+    m_pMemory = pMemory;
+
+    if (NULL != m_pMemory)
+    {
+        m_evictableId = m_pMemory->AddEvictable("texture array", [this]() { return Evict(); });
+    }
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method starts collecting the levels needed by the
+ *  objects of a frame.  The vertical projection scale is the
+ *  length of the y row of the view-projection, since the
+ *  rows of a rigid view matrix have unit length.
+ ***********************************************************/
+void TextureStreamer::BeginFrame(const glm::mat4& viewProjection, int viewportHeight)
+{
+    m_viewProjection = viewProjection;
+
+    glm::vec3 xRow(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0]);
+    glm::vec3 yRow(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]);
+    m_clipScale = glm::vec2(glm::length(xRow), glm::length(yRow));
+    m_pixelsPerUnit = m_clipScale.y * 0.5f * (float)viewportHeight;
+
+    GLint levelCount = (NULL != m_pTextureArray) ? m_pTextureArray->GetLevelCount() : 0;
+    GLsizei layerCount = (NULL != m_pTextureArray) ? m_pTextureArray->GetLayerCount() : 0;
+    m_requiredLevels.assign((size_t)layerCount, levelCount);
+    m_layerDistances.assign((size_t)layerCount, FLT_MAX);
+    m_layersInView.assign((size_t)layerCount, false);
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method estimates the finest mip level an object can
+ *  show.  Its texture spans about layer size x UV scale texels
+ *  across the object, which covers the projected diameter of
+ *  its bounding sphere in pixels; each halving of texels per
+ *  pixel is one level coarser.  Objects behind the viewer are
+ *  ignored.  The nearest distance of each layer, and whether
+ *  any of its objects is inside the view frustum, set the
+ *  loading order.
+ ***********************************************************/
+void TextureStreamer::AddObject(int layer, const glm::vec3& center, float radius, const glm::vec2& uvScale)
+{
+    if (layer < 0 || layer >= (int)m_requiredLevels.size() || m_pixelsPerUnit <= 0.0f)
+        return;
+
+    glm::vec4 clip = m_viewProjection * glm::vec4(center, 1.0f);
+    float distance = clip.w;
+    float nearest = (distance > radius) ? distance - radius : 0.0f;
+    m_layerDistances[layer] = (nearest < m_layerDistances[layer]) ? nearest : m_layerDistances[layer];
+
+    if (distance + radius <= 0.0f)
+        return;
+
+    // The sphere reaches inside the clip volume sideways and vertically
+    if (std::fabs(clip.x) <= distance + radius * m_clipScale.x && std::fabs(clip.y) <= distance + radius * m_clipScale.y)
+    {
+        m_layersInView[layer] = true;
+    }
+
+    GLint level = 0;
+    if (distance > radius + MIN_VIEW_DISTANCE)
+    {
+        float pixels = 2.0f * radius * m_pixelsPerUnit / distance;
+        float uvRepeat = std::fabs(uvScale.x) > std::fabs(uvScale.y) ? std::fabs(uvScale.x) : std::fabs(uvScale.y);
+        float layerSize = (float)((m_pTextureArray->GetWidth() > m_pTextureArray->GetHeight()) ?
+            m_pTextureArray->GetWidth() : m_pTextureArray->GetHeight());
+        float texels = layerSize * ((uvRepeat > 0.0f) ? uvRepeat : 1.0f);
+
+        if (pixels < 1.0f)
+            pixels = 1.0f;
+        if (texels > pixels)
+            level = (GLint)std::floor(std::log2(texels / pixels));
+    }
+
+    if (level < m_requiredLevels[layer])
+    {
+        m_requiredLevels[layer] = level;
+    }
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method hands the loading order of the frame to the
+ *  loader and moves the resident levels of the array toward
+ *  the finest level needed this frame that fits the budget,
+ *  then limits sampling to the levels every layer has
+ *  received.  Returns true when the array storage was
+ *  replaced, here or by an eviction, and must be bound again.
+ ***********************************************************/
+bool TextureStreamer::EndFrame()
+{
+    bool bReplaced = m_bEvicted;
+    m_bEvicted = false;
+
+    if (NULL == m_pTextureArray || NULL == m_pTextureLoader || m_pTextureArray->GetTexture() == 0)
+        return bReplaced;
+
+    for (size_t layer = 0; layer < m_layerDistances.size(); layer++)
+    {
+        m_pTextureLoader->SetLayerPriority((int)layer, m_layersInView[layer], m_layerDistances[layer]);
+    }
+
+    GLint levelCount = m_pTextureArray->GetLevelCount();
+    GLint residentLevel = m_pTextureArray->GetResidentBaseLevel();
+
+    GLint neededLevel = levelCount;
+    for (GLint level : m_requiredLevels)
+    {
+        neededLevel = (level < neededLevel) ? level : neededLevel;
+    }
+
+    // Nothing textured in view: keep what is resident
+    if (neededLevel < levelCount && NULL != m_pMemory)
+    {
+        m_pMemory->Touch(m_evictableId);
+        neededLevel = FitBudget(neededLevel);
+    }
+
+    if (neededLevel >= levelCount || neededLevel == residentLevel)
+    {
+        m_coarserFrames = 0;
+    }
+    else if (neededLevel < residentLevel || ++m_coarserFrames >= DROP_DELAY_FRAMES)
+    {
+        bool bKeptLevels = false;
+        if (m_pTextureArray->Reallocate(neededLevel, bKeptLevels))
+        {
+            m_pTextureLoader->OnTextureArrayReallocated(bKeptLevels);
+            bReplaced = true;
+        }
+        m_coarserFrames = 0;
+    }
+
+    m_pTextureArray->SetSampledBaseLevel(m_pTextureLoader->GetCompleteLevel());
+    return bReplaced;
+}
+
+/***********************************************************
+ *  Evict()
+ *
+ *  This method is the eviction callback of the array: the
+ *  storage is replaced by one without the finest resident
+ *  level and the loader refills the layers from the cache.
+ *  Returns the bytes freed, or 0 when only the 1x1 level is
+ *  left.
+ ***********************************************************/
+size_t TextureStreamer::Evict()
+{
+    if (NULL == m_pTextureArray || NULL == m_pTextureLoader || m_pTextureArray->GetTexture() == 0)
+        return 0;
+
+    size_t residentSize = m_pTextureArray->GetResidentSize();
+    bool bKeptLevels = false;
+    if (!m_pTextureArray->Reallocate(m_pTextureArray->GetResidentBaseLevel() + 1, bKeptLevels))
+        return 0;
+
+    m_pTextureLoader->OnTextureArrayReallocated(bKeptLevels);
+    m_bEvicted = true;
+    m_coarserFrames = 0;
+
+    size_t newSize = m_pTextureArray->GetResidentSize();
+    return (residentSize > newSize) ? residentSize - newSize : 0;
+}
+
+/***********************************************************
+ *  FitBudget()
+ *
+ *  This method gets the finest level, from neededLevel down
+ *  to the resident base level, that the array can hold next
+ *  to everything else in the tracker without going over the
+ *  budget.  Shrinking always fits.
+ ***********************************************************/
+GLint TextureStreamer::FitBudget(GLint neededLevel) const
+{
+    GLint residentLevel = m_pTextureArray->GetResidentBaseLevel();
+    size_t budget = m_pMemory->GetBudget();
+    if (budget == 0 || neededLevel >= residentLevel)
+        return neededLevel;
+
+    size_t residentSize = m_pTextureArray->GetResidentSize();
+    size_t otherSize = (m_pMemory->GetCurrent() > residentSize) ? m_pMemory->GetCurrent() - residentSize : 0;
+    while (neededLevel < residentLevel && otherSize + m_pTextureArray->GetResidentSize(neededLevel) > budget)
+    {
+        neededLevel++;
+    }
+    return neededLevel;
+}
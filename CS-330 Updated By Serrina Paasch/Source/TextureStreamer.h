@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureStreamer.h
+// =================
+// Keep only the texture mip levels the visible objects need resident
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureArray.h"
+#include "TextureLoader.h"
+#include "GpuMemoryTracker.h"
+
+#include <vector>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  TextureStreamer
+ *
+ *  This class decides which mip levels of the texture array
+ *  are resident on the GPU from how large the textured
+ *  objects appear on screen.
+ *
+ *  Every frame each textured object reports its bounding
+ *  sphere and UV scale.  The projected diameter of the sphere
+ *  in pixels against the texels the texture spans across it
+ *  gives the finest mip level the object can show; each layer
+ *  needs the finest level of any of its objects in view.
+ *
+ *  All layers of a texture array share one mip chain, so the
+ *  array keeps the finest level needed by any layer:
+ *  - Finer levels are needed: the array storage grows right
+ *    away and the loader streams the new levels in, coarse to
+ *    fine.
+ *  - Finer levels stay unused for DROP_DELAY_FRAMES: the
+ *    storage shrinks and their memory is freed.
+ *  GL_TEXTURE_BASE_LEVEL keeps sampling on levels that every
+ *  layer has received.
+ *
+ *  The same spheres order the loading of the layers: layers
+ *  of objects in view first, nearest to the viewer first.
+ *
+ *  With a memory tracker the array is registered as evictable
+ *  and marked as drawn while any layer is in view.  Over
+ *  budget, it gives up its finest resident level per
+ *  eviction, down to 1x1 per layer, which then shows the
+ *  average color of the image as a placeholder.  Growth stops
+ *  at the finest level that fits the budget, so evicted
+ *  levels do not come straight back.
+ ***********************************************************/
+class TextureStreamer
+{
+public:
+    // Constructor: Initialize member variables
+    TextureStreamer();
+
+    // Destructor: Unregister from the memory tracker
+    ~TextureStreamer();
+
+    // Set the array whose residency is managed, the loader that fills it and
+    // the tracker whose budget limits it (optional)
+    void Initialize(TextureArray* pTextureArray, TextureLoader* pTextureLoader, GpuMemoryTracker* pMemory = NULL);
+
+    // Start a frame seen through viewProjection on a viewport viewportHeight pixels high
+    void BeginFrame(const glm::mat4& viewProjection, int viewportHeight);
+
+    // Report a textured object (world-space bounding sphere) seen this frame
+    void AddObject(int layer, const glm::vec3& center, float radius, const glm::vec2& uvScale);
+
+    // Apply the levels needed this frame; true when the array texture was replaced,
+    // here or by an eviction since the last call
+    bool EndFrame();
+
+private:
+    TextureArray* m_pTextureArray;       // Array whose residency is managed
+    TextureLoader* m_pTextureLoader;     // Streams the resident levels into the array
+    GpuMemoryTracker* m_pMemory;         // Budget and eviction order (optional)
+    int m_evictableId;                   // Id of the array in the tracker (0 = not registered)
+    bool m_bEvicted;                     // Array replaced by an eviction since the last EndFrame()
+    glm::mat4 m_viewProjection;          // View-projection of the frame
+    float m_pixelsPerUnit;               // Projected pixels per world unit at distance 1
+    glm::vec2 m_clipScale;               // Clip-space x / y extent of one world unit
+    std::vector<GLint> m_requiredLevels; // Finest level needed per layer this frame
+    std::vector<float> m_layerDistances; // Distance of the nearest object per layer this frame
+    std::vector<bool> m_layersInView;    // Whether an object of each layer is in view this frame
+    unsigned int m_coarserFrames;        // Frames in a row that needed only coarser levels
+
+    // Drop the finest resident level; returns the bytes freed
+    size_t Evict();
+
+    // Get the finest level from neededLevel down whose storage fits the budget
+    GLint FitBudget(GLint neededLevel) const;
+};
@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+// ThreadPool.cpp
+// ==============
+// Run ranges of independent work on a fixed set of worker threads
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  ThreadPool()
+ *
+ *  The constructor for the class.  By default one worker is
+ *  started per hardware thread beyond the calling thread.
+ ***********************************************************/
+ThreadPool::ThreadPool(unsigned int workerCount)
+{
+    m_pTask = NULL;
+    m_count = 0;
+    m_rangeCount = 0;
+    m_nextRange = 0;
+    m_pendingRanges = 0;
+    m_bStopping = false;
+
+    if (workerCount == 0)
+    {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+    }
+
+    for (unsigned int i = 0; i < workerCount; i++)
+    {
+        m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+}
+
+/***********************************************************
+ *  ~ThreadPool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bStopping = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+/***********************************************************
+ *  GetRangeCount()
+ *
+ *  This method gets the number of ranges a loop of count
+ *  items is split into: at most one per thread and no range
+ *  smaller than minRangeSize, so small loops stay on the
+ *  calling thread.
+ ***********************************************************/
+size_t ThreadPool::GetRangeCount(size_t count, size_t minRangeSize) const
+{
+    if (count == 0)
+        return 0;
+
+    if (minRangeSize == 0)
+        minRangeSize = 1;
+
+    size_t rangeCount = (count + minRangeSize - 1) / minRangeSize;
+    if (rangeCount > GetThreadCount())
+        rangeCount = GetThreadCount();
+    return rangeCount;
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method runs task over [0, count) split into
+ *  GetRangeCount() contiguous ranges and returns when all of
+ *  them are done.  Range r covers the items from
+ *  count * r / ranges up to count * (r + 1) / ranges.
+ ***********************************************************/
+void ThreadPool::ParallelFor(size_t count, size_t minRangeSize, const RANGE_TASK& task)
+{
+    size_t rangeCount = GetRangeCount(count, minRangeSize);
+    if (rangeCount == 0)
+        return;
+
+    if (rangeCount == 1)
+    {
+        task(0, 0, count);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_pTask = &task;
+    m_count = count;
+    m_rangeCount = rangeCount;
+    m_nextRange = 0;
+    m_pendingRanges = rangeCount;
+    m_wakeCondition.notify_all();
+
+    RunRanges(lock);
+    m_doneCondition.wait(lock, [this]() { return m_pendingRanges == 0; });
+
+    m_pTask = NULL;
+    m_count = 0;
+    m_rangeCount = 0;
+    m_nextRange = 0;
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method queues a task for the next idle worker and
+ *  returns without waiting.  Without workers the task runs on
+ *  the calling thread before Submit() returns.
+ ***********************************************************/
+void ThreadPool::Submit(const TASK& task)
+{
+    if (m_workers.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(task);
+    }
+    m_wakeCondition.notify_one();
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is the body of every worker thread.  Ranges of
+ *  a ParallelFor() job go before submitted tasks.
+ ***********************************************************/
+void ThreadPool::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wakeCondition.wait(lock, [this]() { return m_bStopping || m_nextRange < m_rangeCount || !m_tasks.empty(); });
+
+        if (m_nextRange < m_rangeCount)
+        {
+            RunRanges(lock);
+            continue;
+        }
+
+        if (m_tasks.empty())
+            return;
+
+        TASK task = m_tasks.front();
+        m_tasks.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+/***********************************************************
+ *  RunRanges()
+ *
+ *  This method takes ranges of the current job one at a time
+ *  and runs them without holding the lock.
+ ***********************************************************/
+void ThreadPool::RunRanges(std::unique_lock<std::mutex>& lock)
+{
+    while (m_nextRange < m_rangeCount)
+    {
+        size_t range = m_nextRange++;
+        const RANGE_TASK& task = *m_pTask;
+        size_t begin = m_count * range / m_rangeCount;
+        size_t end = m_count * (range + 1) / m_rangeCount;
+
+        lock.unlock();
+        task(range, begin, end);
+        lock.lock();
+
+        if (--m_pendingRanges == 0)
+        {
+            m_doneCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// ThreadPool.h
+// ============
+// Run ranges of independent work on a fixed set of worker threads
+//
+// AUTHOR: Serrina Paasch
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+/***********************************************************
+ *  ThreadPool
+ *
+ *  This class keeps a fixed set of worker threads that split
+ *  a loop into contiguous ranges.  The calling thread works
+ *  on ranges too and ParallelFor() returns once every range
+ *  is done.  The split depends only on the item count and the
+ *  thread count, so results written per range can be merged
+ *  in range order for a deterministic outcome.
+ *
+ *  Single tasks can also be submitted without waiting for
+ *  them.  Workers take them whenever no ParallelFor() job has
+ *  ranges left, so a long task never holds up a loop (the
+ *  calling thread finishes the ranges itself).  Tasks still
+ *  queued when the pool is destroyed run before it returns.
+ *
+ *  Tasks must not touch OpenGL: the context belongs to the
+ *  thread that created the window.  ParallelFor() is not
+ *  reentrant and must only be called from one thread.
+ ***********************************************************/
+class ThreadPool
+{
+public:
+    // Task run for one range: (range index, first item, one past the last item)
+    typedef std::function<void(size_t, size_t, size_t)> RANGE_TASK;
+
+    // Task run on its own without waiting for it
+    typedef std::function<void()> TASK;
+
+    // Constructor: Start the worker threads (0 = one per extra hardware thread)
+    explicit ThreadPool(unsigned int workerCount = 0);
+
+    // Destructor: Stop and join the worker threads
+    ~ThreadPool();
+
+    // Get the number of threads that run ranges, including the caller
+    unsigned int GetThreadCount() const { return (unsigned int)m_workers.size() + 1; }
+
+    // Get the number of ranges count items are split into
+    size_t GetRangeCount(size_t count, size_t minRangeSize) const;
+
+    // Run task over [0, count) split into GetRangeCount() ranges
+    void ParallelFor(size_t count, size_t minRangeSize, const RANGE_TASK& task);
+
+    // Queue task for a worker and return at once (runs it right away without workers)
+    void Submit(const TASK& task);
+
+private:
+    std::vector<std::thread> m_workers;  // Worker threads
+    std::mutex m_mutex;                  // Guards the job state below
+    std::condition_variable m_wakeCondition;  // Signals a new job or shutdown
+    std::condition_variable m_doneCondition;  // Signals the last finished range
+    const RANGE_TASK* m_pTask;           // Task of the current job
+    size_t m_count;                      // Items of the current job
+    size_t m_rangeCount;                 // Ranges of the current job
+    size_t m_nextRange;                  // Next range to hand out
+    size_t m_pendingRanges;              // Ranges not finished yet
+    std::deque<TASK> m_tasks;            // Submitted tasks not started yet
+    bool m_bStopping;                    // Set when the pool shuts down
+
+    // Wait for jobs and run their ranges
+    void WorkerLoop();
+
+    // Run ranges of the current job until none are left (lock held on entry and exit)
+    void RunRanges(std::unique_lock<std::mutex>& lock);
+};
@@ -8,6 +8,8 @@
 
 #include "ViewManager.h"
 
+#include <iostream>
+
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
@@ -42,11 +44,17 @@ ViewManager::ViewManager(ShaderManager* pShaderManager)
 {
     m_pShaderManager = pShaderManager;
     m_pWindow = NULL;
+    m_viewProjection = glm::mat4(1.0f);
     g_pCamera = new Camera();
     g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
     g_pCamera->Front = glm::vec3(0.0f, -0.5f, -2.0f);
     g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
     g_pCamera->Zoom = 80;
+
+    // Resolve the per-frame uniform handles once
+    m_viewUniform = m_pShaderManager->GetUniform<glm::mat4>(g_ViewName);
+    m_projectionUniform = m_pShaderManager->GetUniform<glm::mat4>(g_ProjectionName);
+    m_viewPositionUniform = m_pShaderManager->GetUniform<glm::vec3>("viewPosition");
 }
 
 /***********************************************************
@@ -81,10 +89,10 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
     }
     glfwMakeContextCurrent(window);
 
-    glfwSetCursorPosCallback(window, &ViewManager::Mouse_Position_Callback);
+    glfwSetCursorPosCallback(window, &ViewManager::MousePositionCallback);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    m_pShaderManager->GetStateCache().Enable(GL_BLEND);
+    m_pShaderManager->GetStateCache().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     m_pWindow = window;
 
@@ -92,11 +100,11 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 }
 
 /***********************************************************
- *  Mouse_Position_Callback()
+ *  MousePositionCallback()
  *
  *  Receives mouse movement events.
  ***********************************************************/
-void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
+void ViewManager::MousePositionCallback(GLFWwindow* window, double xMousePos, double yMousePos)
 {
     if (gFirstMouse)
     {
@@ -186,11 +194,26 @@ void ViewManager::PrepareSceneView()
 
     view = g_pCamera->GetViewMatrix();
     projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+    m_viewProjection = projection * view;
 
     if (m_pShaderManager != NULL)
     {
-        m_pShaderManager->setMat4Value(g_ViewName, view);
-        m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-        m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+        m_pShaderManager->setMat4Value(m_viewUniform, view);
+        m_pShaderManager->setMat4Value(m_projectionUniform, projection);
+        m_pShaderManager->setVec3Value(m_viewPositionUniform, g_pCamera->Position);
+    }
+}
+
+/***********************************************************
+ *  GetCameraPosition()
+ *
+ *  Gets the current position of the camera in the scene.
+ ***********************************************************/
+glm::vec3 ViewManager::GetCameraPosition() const
+{
+    if (g_pCamera == NULL)
+    {
+        return glm::vec3(0.0f);
     }
+    return g_pCamera->Position;
 }
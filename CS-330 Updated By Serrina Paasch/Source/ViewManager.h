@@ -32,6 +32,12 @@ public:
     // Prepare the conversion from 3D object display to 2D scene display
     void PrepareSceneView();
 
+    // Get the current position of the camera
+    glm::vec3 GetCameraPosition() const;
+
+    // Get the view-projection matrix of the last prepared view
+    glm::mat4 GetViewProjection() const { return m_viewProjection; }
+
 private:
     // Pointer to ShaderManager object
     ShaderManager* m_pShaderManager;
@@ -39,6 +45,14 @@ private:
     // Active OpenGL display window
     GLFWwindow* m_pWindow;
 
+    // Pre-resolved handles for the per-frame view uniforms
+    UniformHandle<glm::mat4> m_viewUniform;
+    UniformHandle<glm::mat4> m_projectionUniform;
+    UniformHandle<glm::vec3> m_viewPositionUniform;
+
+    // View-projection matrix of the last prepared view
+    glm::mat4 m_viewProjection;
+
     // Process keyboard events for interaction with the 3D scene
     void ProcessKeyboardEvents();
 };